@@ -0,0 +1,44 @@
+#include "client.h"
+
+#include <utility>
+
+void Client::deliver(std::shared_ptr<const std::string> message) { enqueue(std::move(message), false); }
+
+void Client::unblock(std::shared_ptr<const std::string> reply) { enqueue(std::move(reply), true); }
+
+void Client::enqueue(std::shared_ptr<const std::string> message, bool unblocking) {
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        first = mailbox.empty();
+        mailbox.push_back(std::move(message));
+        if (unblocking) { blocked = false; }
+    }
+
+    // Later messages are picked up together with the first, the event loop is only woken once for them.
+    if (first && notifier) { notifier(id); }
+}
+
+std::vector<std::shared_ptr<const std::string>> Client::takeMessages() {
+    std::lock_guard<std::mutex> lock(mailboxMutex);
+    return std::exchange(mailbox, {});
+}
+
+std::shared_ptr<Client> ClientRegistry::create(Client::Notifier notifier) {
+    auto client = std::make_shared<Client>(nextId++, std::move(notifier));
+
+    std::lock_guard<std::mutex> lock(mtx);
+    clients.emplace(client->id, client);
+    return client;
+}
+
+void ClientRegistry::remove(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    clients.erase(id);
+}
+
+std::shared_ptr<Client> ClientRegistry::find(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = clients.find(id);
+    return it != clients.end() ? it->second : nullptr;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct BlockedPop;
+
+/**
+ * State of a connected client that commands read and change, such as the protocol version negotiated with HELLO and
+ * whether the keys it reads are tracked. Other threads may queue messages for the client, which the event loop serving
+ * it writes out between replies.
+ */
+class Client {
+public:
+    // Called when the mailbox of the client with the given id receives its first message.
+    using Notifier = std::function<void(uint64_t id)>;
+
+    explicit Client(uint64_t id, Notifier notifier = {}) : id(id), notifier(std::move(notifier)) {}
+
+    /**
+     * Queues an encoded message for the client, from any thread. Messages are shared, so one encoding can be delivered
+     * to many clients.
+     */
+    void deliver(std::shared_ptr<const std::string> message);
+
+    /**
+     * Queues the reply of the blocking command the client waits in and clears blocked, from any thread. Both happen
+     * under the mailbox lock, so the connection cannot send the reply, and receive the next request, before it sees
+     * the client unblocked.
+     */
+    void unblock(std::shared_ptr<const std::string> reply);
+
+    /**
+     * Takes the queued messages, called by the event loop serving the client.
+     */
+    std::vector<std::shared_ptr<const std::string>> takeMessages();
+
+    const uint64_t id;
+    std::string name;
+
+    // Read by the threads delivering invalidations, written by the thread serving the client.
+    std::atomic<int> protocol{2};
+    std::atomic<bool> tracking{false};
+    std::atomic<bool> trackingNoLoop{false};
+
+    // Commands queued between MULTI and EXEC, owning copies of their arguments.
+    struct Transaction {
+        std::vector<std::vector<std::string>> commands;
+
+        // Set when a command could not be queued, EXEC then discards the transaction.
+        bool aborted = false;
+    };
+
+    // Only used by the thread serving the client.
+    std::optional<Transaction> transaction;
+
+    // Keys watched with WATCH and their versions at the time, EXEC fails if any has changed since.
+    std::vector<std::pair<std::string, uint64_t>> watchedKeys;
+
+    // Channels and patterns the client subscribed to, in order, see PubSub. Only used by the thread serving the client.
+    std::vector<std::string> channels;
+    std::vector<std::string> patterns;
+
+    size_t subscriptions() const { return channels.size() + patterns.size(); }
+
+    // Set while the client waits in a blocking command such as BLPOP, whose reply then arrives in the mailbox, see
+    // unblock(). The connection handles no further requests until then.
+    std::atomic<bool> blocked{false};
+
+    // The pop the client waits for and when it times out, if ever. Only used by the thread serving the client.
+    std::shared_ptr<BlockedPop> blockedPop;
+    std::optional<std::chrono::steady_clock::time_point> blockedUntil;
+
+private:
+    void enqueue(std::shared_ptr<const std::string> message, bool unblocking);
+
+    Notifier notifier;
+    std::mutex mailboxMutex;
+    std::vector<std::shared_ptr<const std::string>> mailbox;
+};
+
+/**
+ * Assigns client ids and finds connected clients by id.
+ */
+class ClientRegistry {
+public:
+    std::shared_ptr<Client> create(Client::Notifier notifier = {});
+    void remove(uint64_t id);
+
+    /**
+     * Returns the connected client with the given id, or nullptr if it has disconnected.
+     */
+    std::shared_ptr<Client> find(uint64_t id) const;
+
+private:
+    std::atomic<uint64_t> nextId{1};
+
+    mutable std::mutex mtx;
+    std::unordered_map<uint64_t, std::shared_ptr<Client>> clients;
+};
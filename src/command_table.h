@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+class Controller;
+struct CommandContext;
+
+// Command flags, reported by COMMAND under the same names as in Redis.
+enum CommandFlag : uint32_t {
+    CMD_WRITE = 1 << 0,
+    CMD_READONLY = 1 << 1,
+    CMD_FAST = 1 << 2,
+    CMD_ADMIN = 1 << 3,
+
+    // Controls a transaction, so it runs right away between MULTI and EXEC instead of being queued. Not reported.
+    CMD_TRANSACTION = 1 << 4,
+
+    CMD_PUBSUB = 1 << 5,
+
+    // Allowed while a RESP2 client is subscribed, its connection then only carries Pub/Sub messages. Not reported.
+    CMD_SUBSCRIBED = 1 << 6,
+};
+
+/**
+ * Static description of a command: how it is called, what it does to the keyspace and where its keys are.
+ */
+struct CommandSpec {
+    using Handler = void (Controller::*)(CommandContext &);
+
+    // Lowercase, as reported by COMMAND.
+    std::string_view name;
+
+    // Number of arguments including the command name, negative for at least that many.
+    int arity;
+    uint32_t flags;
+
+    // Positions of the first and last key among the arguments and the step between keys. A negative last key counts
+    // from the end, 0 means the command takes no keys.
+    int firstKey;
+    int lastKey;
+    int keyStep;
+
+    Handler handler;
+
+    constexpr bool acceptsArgs(size_t numArgs) const {
+        return arity >= 0 ? numArgs == static_cast<size_t>(arity) : numArgs >= static_cast<size_t>(-arity);
+    }
+
+    constexpr bool hasFlag(CommandFlag flag) const { return (flags & flag) != 0; }
+
+    /**
+     * Calls fn with each key among the arguments of a call accepted by acceptsArgs.
+     */
+    template<typename Fn>
+    void forEachKey(std::span<const std::string_view> args, Fn &&fn) const {
+        if (firstKey == 0) { return; }
+
+        int last = lastKey < 0 ? static_cast<int>(args.size()) + lastKey : lastKey;
+        for (int i = firstKey; i <= last && i < static_cast<int>(args.size()); i += keyStep) { fn(args[i]); }
+    }
+};
+
+namespace CommandLookup {
+    constexpr char toLower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+    // FNV-1a over the lowercased name, so any spelling of a command lands in the same slot.
+    constexpr uint32_t hash(std::string_view name) {
+        uint32_t h = 2166136261u;
+        for (char c: name) {
+            h ^= static_cast<uint8_t>(toLower(c));
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    constexpr bool equalsIgnoreCase(std::string_view str, std::string_view lower) {
+        if (str.size() != lower.size()) { return false; }
+        for (size_t i = 0; i < str.size(); ++i) {
+            if (toLower(str[i]) != lower[i]) { return false; }
+        }
+        return true;
+    }
+}// namespace CommandLookup
+
+/**
+ * Case-insensitive lookup of a fixed set of commands. The open-addressing table is built at compile time and kept at
+ * most a quarter full, so a lookup hashes the name once and usually compares a single candidate.
+ */
+template<size_t N>
+class CommandTable {
+public:
+    constexpr explicit CommandTable(const std::array<CommandSpec, N> &commands) : commands(commands) {
+        for (size_t i = 0; i < N; ++i) {
+            size_t slot = CommandLookup::hash(commands[i].name) & (SLOTS - 1);
+            while (slots[slot] != 0) { slot = (slot + 1) & (SLOTS - 1); }
+            slots[slot] = static_cast<uint16_t>(i + 1);
+        }
+    }
+
+    /**
+     * @return The command with the given name in any case, or nullptr if there is none.
+     */
+    constexpr const CommandSpec *find(std::string_view name) const {
+        for (size_t slot = CommandLookup::hash(name) & (SLOTS - 1); slots[slot] != 0; slot = (slot + 1) & (SLOTS - 1)) {
+            const auto &command = commands[slots[slot] - 1];
+            if (CommandLookup::equalsIgnoreCase(name, command.name)) { return &command; }
+        }
+        return nullptr;
+    }
+
+    constexpr std::span<const CommandSpec> all() const { return commands; }
+
+private:
+    static constexpr size_t SLOTS = std::bit_ceil(4 * N);
+
+    std::array<CommandSpec, N> commands;
+
+    // Index into commands plus one, 0 for an empty slot.
+    std::array<uint16_t, SLOTS> slots{};
+};
@@ -1,123 +1,1436 @@
 #include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <numeric>
 
 
 #include "controller.h"
+#include "overloaded.h"
 #include "protocol.h"
 #include "redis_type.h"
 
-Controller::Controller(const std::optional<std::string> &writeAheadLogFileName) : persister{writeAheadLogFileName} {
+namespace {
+    bool equalsIgnoreCase(std::string_view str, std::string_view upper) {
+        return std::equal(str.begin(), str.end(), upper.begin(), upper.end(),
+                          [](char a, char b) { return ::toupper(static_cast<unsigned char>(a)) == b; });
+    }
+
+    std::optional<long long> parseInteger(std::string_view str) {
+        long long value;
+        auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || end != str.data() + str.size()) return std::nullopt;
+        return value;
+    }
+
+    // Parses a score the way Redis does: any floating point number, "inf", "+inf" and "-inf" included, but not NaN.
+    std::optional<double> parseScore(std::string_view str) {
+        // from_chars takes a '-' but no '+', strip it only if no other sign follows, as "+-1" is not a number.
+        if (str.starts_with('+') && !str.substr(1).starts_with('-') && !str.substr(1).starts_with('+')) {
+            str.remove_prefix(1);
+        }
+
+        double value;
+        auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || end != str.data() + str.size() || std::isnan(value)) { return std::nullopt; }
+        return value;
+    }
+
+    // Parses a bound of a score range: a score, exclusive if prefixed with '('.
+    std::optional<std::pair<double, bool>> parseScoreBound(std::string_view str) {
+        bool exclusive = str.starts_with('(');
+        if (exclusive) { str.remove_prefix(1); }
+
+        auto score = parseScore(str);
+        if (!score) { return std::nullopt; }
+        return std::pair{*score, exclusive};
+    }
+
+    // Longest timeout of a blocking command, its deadline must fit the clock.
+    constexpr long double MAX_BLOCK_SECONDS = 1e9;
+
+    // Reported by HELLO, clients check it before relying on newer features.
+    constexpr std::string_view SERVER_VERSION = "7.2.0";
+
+    /**
+     * Appends the description of a command in the layout of Redis 7: name, arity, flags, first key, last key, key
+     * step, ACL categories, tips, key specifications and subcommands. The last four are always empty here.
+     */
+    void writeCommandInfo(ReplyWriter &reply, const CommandSpec &command) {
+        constexpr std::pair<CommandFlag, std::string_view> flagNames[] = {
+                {CMD_WRITE, "write"},
+                {CMD_READONLY, "readonly"},
+                {CMD_FAST, "fast"},
+                {CMD_ADMIN, "admin"},
+                {CMD_PUBSUB, "pubsub"},
+        };
+
+        reply.arrayHeader(10);
+        reply.bulkString(command.name);
+        reply.integer(command.arity);
+
+        size_t numFlags = std::count_if(std::begin(flagNames), std::end(flagNames),
+                                        [&](const auto &flag) { return command.hasFlag(flag.first); });
+        reply.arrayHeader(numFlags);
+        for (const auto &[flag, name]: flagNames) {
+            if (command.hasFlag(flag)) { reply.simpleString(name); }
+        }
+
+        reply.integer(command.firstKey);
+        reply.integer(command.lastKey);
+        reply.integer(command.keyStep);
+
+        for (int i = 0; i < 4; ++i) { reply.raw(Replies::EMPTY_ARRAY); }
+    }
+
+    // Integers are stored as such and only formatted on the way out.
+    void writeValue(ReplyWriter &reply, Value value) {
+        if (const auto *number = std::get_if<long long>(&value)) { return reply.bulkInteger(*number); }
+        reply.bulkString(std::get<std::shared_ptr<const std::string>>(std::move(value)));
+    }
+
+    void writeStoreError(ReplyWriter &reply, StoreError error) {
+        switch (error) {
+            case StoreError::WrongType:
+                return reply.raw(Replies::WRONG_TYPE_ERROR);
+            case StoreError::NotAnInteger:
+                return reply.raw(Replies::NOT_INTEGER_ERROR);
+            case StoreError::NotAFloat:
+                return reply.raw(Replies::NOT_FLOAT_ERROR);
+            case StoreError::Overflow:
+                return reply.error("ERR increment or decrement would overflow");
+            case StoreError::NotFinite:
+                return reply.error("ERR increment would produce NaN or Infinity");
+            case StoreError::TooLarge:
+                return reply.error("ERR string exceeds maximum allowed size (proto-max-bulk-len)");
+            case StoreError::NotANumber:
+                return reply.error("ERR resulting score is not a number (NaN)");
+            case StoreError::NotAHyperLogLog:
+                return reply.error("WRONGTYPE Key is not a valid HyperLogLog string value.");
+        }
+    }
+
+    // Members of a sorted set, each followed by its score if withScores is set: flat in RESP2, as pairs in RESP3.
+    void writeScoredMembers(ReplyWriter &reply, const std::vector<SortedSet::Entry> &entries, bool withScores,
+                            int protocol) {
+        bool pairs = withScores && protocol >= 3;
+        reply.arrayHeader(withScores && !pairs ? 2 * entries.size() : entries.size());
+
+        for (const auto &[member, score]: entries) {
+            if (pairs) { reply.arrayHeader(2); }
+            reply.bulkString(member);
+            if (withScores) { reply.doubleValue(score); }
+        }
+    }
+
+    void writeSetMembers(ReplyWriter &reply, const std::vector<std::string> &members) {
+        reply.setHeader(members.size());
+        for (const auto &member: members) { reply.bulkString(member); }
+    }
+
+    void writeElements(ReplyWriter &reply, const std::vector<std::string> &elements) {
+        reply.arrayHeader(elements.size());
+        for (const auto &element: elements) { reply.bulkString(element); }
+    }
+
+    // The type TYPE reports for a value.
+    std::string_view typeName(const Value &value) {
+        return std::visit(overloaded{
+                                  [](const std::shared_ptr<QuickList> &) { return std::string_view("list"); },
+                                  [](const std::shared_ptr<Hash> &) { return std::string_view("hash"); },
+                                  [](const std::shared_ptr<Set> &) { return std::string_view("set"); },
+                                  [](const std::shared_ptr<SortedSet> &) { return std::string_view("zset"); },
+                                  [](const auto &) { return std::string_view("string"); },
+                          },
+                          value);
+    }
+
+    // The reply of a blocking pop: the key and the element popped from it.
+    std::string encodeKeyElement(int protocol, std::string_view key, std::string_view element) {
+        OutputBuffer out;
+        ReplyWriter reply(out, protocol);
+        reply.arrayHeader(2);
+        reply.bulkString(key);
+        reply.bulkString(element);
+        return out.toString();
+    }
+
+    // The commands that replay a write from the log.
+    std::vector<uint8_t> encodeForLog(const CommandContext &ctx) {
+        if (ctx.loggedAs.empty()) { return fileEncode(ctx.args); }
+
+        std::vector<uint8_t> log;
+        for (const auto &command: ctx.loggedAs) {
+            std::vector<std::string_view> args(command.begin(), command.end());
+            auto encoded = fileEncode(args);
+            log.insert(log.end(), encoded.begin(), encoded.end());
+        }
+        return log;
+    }
+
+    /**
+     * Confirms a change of subscription with the number of subscriptions left, as a push in RESP3. Without a channel,
+     * confirms unsubscribing from nothing.
+     */
+    void writeSubscription(CommandContext &ctx, std::string_view kind, std::optional<std::string_view> channel) {
+        if (ctx.client.protocol >= 3) {
+            ctx.reply.pushHeader(3);
+        } else {
+            ctx.reply.arrayHeader(3);
+        }
+
+        ctx.reply.bulkString(kind);
+        if (channel) {
+            ctx.reply.bulkString(*channel);
+        } else {
+            ctx.reply.null();
+        }
+        ctx.reply.integer(static_cast<long long>(ctx.client.subscriptions()));
+    }
+
+    // Same characters Redis accepts in client names.
+    bool isValidClientName(std::string_view name) {
+        return std::all_of(name.begin(), name.end(), [](char c) { return c > ' ' && c <= '~'; });
+    }
+}// namespace
+
+Controller::Controller(const std::optional<std::string> &writeAheadLogFileName, EncodingLimits encodingLimits,
+                       size_t maxStringLength, size_t numSetWorkers)
+    : dataStore{encodingLimits, maxStringLength, numSetWorkers}, persister{writeAheadLogFileName} {
+    dataStore.setExpiryListener([this](std::string_view key) { invalidateKey(key); });
     dataStore.startExpiryDaemon();
 }
 
-Controller::Controller() { dataStore.startExpiryDaemon(); }
+Controller::Controller() {
+    dataStore.setExpiryListener([this](std::string_view key) { invalidateKey(key); });
+    dataStore.startExpiryDaemon();
+}
 
-RedisType::RedisValue Controller::handleCommand(const std::vector<RedisType::BulkString> &command) {
-    if (command.empty()) { return RedisType::SimpleError("ERR empty command"); }
+Controller::~Controller() { dataStore.stopExpiryDaemon(); }
 
-    auto commandType = extractStringFromBytes(*command[0].data, 0, (*command[0].data).size());
+std::shared_ptr<Client> Controller::connectClient(Client::Notifier notifier) {
+    return clients.create(std::move(notifier));
+}
+
+void Controller::disconnectClient(Client &client) {
+    pubsub.unsubscribeAll(client);
+    unwatchAll(client);
+    if (client.blockedPop) { dataStore.cancelBlockedPop(client.blockedPop); }
+    clients.remove(client.id);
+}
 
-    std::transform(commandType.begin(), commandType.end(), commandType.begin(), ::toupper);
+void Controller::timeoutBlockedClient(Client &client) {
+    if (!client.blockedPop) { return; }
 
-    if (commandType == "ECHO") {
-        return handleEcho(command);
-    } else if (commandType == "PING") {
-        return handlePing(command);
-    } else if (commandType == "SET") {
-        return handleSet(command, true);
-    } else if (commandType == "GET") {
-        return handleGet(command);
-    } else if (commandType == "EXISTS") {
-        return handleExists(command);
-    } else if (commandType == "CONFIG") {
-        return handleConfig(command);
+    if (dataStore.cancelBlockedPop(client.blockedPop)) {
+        OutputBuffer out;
+        ReplyWriter reply(out, client.protocol);
+        reply.nullArray();
+        client.unblock(std::make_shared<const std::string>(out.toString()));
     }
 
-    return RedisType::SimpleError("ERR unsupported command");
+    client.blockedPop.reset();
 }
 
-RedisType::RedisValue Controller::handleEcho(const std::vector<RedisType::BulkString> &command) {
-    if (command.size() != 2) { return RedisType::SimpleError("ERR wrong number of arguments for 'echo' command"); }
+struct Commands {
+    static constexpr CommandTable table{std::array{
+            CommandSpec{"echo", 2, CMD_FAST, 0, 0, 0, &Controller::handleEcho},
+            CommandSpec{"ping", -1, CMD_FAST | CMD_SUBSCRIBED, 0, 0, 0, &Controller::handlePing},
+            CommandSpec{"set", -3, CMD_WRITE, 1, 1, 1, &Controller::handleSet},
+            CommandSpec{"get", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleGet},
+            CommandSpec{"exists", -2, CMD_READONLY | CMD_FAST, 1, -1, 1, &Controller::handleExists},
+            CommandSpec{"mget", -2, CMD_READONLY | CMD_FAST, 1, -1, 1, &Controller::handleMGet},
+            CommandSpec{"mset", -3, CMD_WRITE, 1, -1, 2, &Controller::handleMSet},
+            CommandSpec{"msetnx", -3, CMD_WRITE, 1, -1, 2, &Controller::handleMSetNx},
+            CommandSpec{"incr", 2, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleIncr},
+            CommandSpec{"decr", 2, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleDecr},
+            CommandSpec{"incrby", 3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleIncrBy},
+            CommandSpec{"decrby", 3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleDecrBy},
+            CommandSpec{"incrbyfloat", 3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleIncrByFloat},
+            CommandSpec{"append", 3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleAppend},
+            CommandSpec{"setrange", 4, CMD_WRITE, 1, 1, 1, &Controller::handleSetRange},
+            CommandSpec{"getrange", 4, CMD_READONLY, 1, 1, 1, &Controller::handleGetRange},
+            CommandSpec{"strlen", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleStrLen},
+            CommandSpec{"del", -2, CMD_WRITE, 1, -1, 1, &Controller::handleDel},
+            CommandSpec{"unlink", -2, CMD_WRITE | CMD_FAST, 1, -1, 1, &Controller::handleUnlink},
+            CommandSpec{"flushall", -1, CMD_WRITE, 0, 0, 0, &Controller::handleFlushAll},
+            CommandSpec{"multi", 1, CMD_FAST | CMD_TRANSACTION, 0, 0, 0, &Controller::handleMulti},
+            CommandSpec{"exec", 1, CMD_TRANSACTION, 0, 0, 0, &Controller::handleExec},
+            CommandSpec{"discard", 1, CMD_FAST | CMD_TRANSACTION, 0, 0, 0, &Controller::handleDiscard},
+            CommandSpec{"watch", -2, CMD_FAST | CMD_TRANSACTION, 1, -1, 1, &Controller::handleWatch},
+            CommandSpec{"unwatch", 1, CMD_FAST | CMD_TRANSACTION, 0, 0, 0, &Controller::handleUnwatch},
+            CommandSpec{"subscribe", -2, CMD_PUBSUB | CMD_SUBSCRIBED, 0, 0, 0, &Controller::handleSubscribe},
+            CommandSpec{"unsubscribe", -1, CMD_PUBSUB | CMD_SUBSCRIBED, 0, 0, 0, &Controller::handleUnsubscribe},
+            CommandSpec{"psubscribe", -2, CMD_PUBSUB | CMD_SUBSCRIBED, 0, 0, 0, &Controller::handlePSubscribe},
+            CommandSpec{"punsubscribe", -1, CMD_PUBSUB | CMD_SUBSCRIBED, 0, 0, 0, &Controller::handlePUnsubscribe},
+            CommandSpec{"publish", 3, CMD_PUBSUB | CMD_FAST, 0, 0, 0, &Controller::handlePublish},
+            CommandSpec{"lpush", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleLPush},
+            CommandSpec{"rpush", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleRPush},
+            CommandSpec{"lpop", -2, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleLPop},
+            CommandSpec{"rpop", -2, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleRPop},
+            CommandSpec{"lrange", 4, CMD_READONLY, 1, 1, 1, &Controller::handleLRange},
+            CommandSpec{"llen", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleLLen},
+            CommandSpec{"blpop", -3, CMD_WRITE, 1, -2, 1, &Controller::handleBLPop},
+            CommandSpec{"brpop", -3, CMD_WRITE, 1, -2, 1, &Controller::handleBRPop},
+            CommandSpec{"hset", -4, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleHSet},
+            CommandSpec{"hget", 3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleHGet},
+            CommandSpec{"hmget", -3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleHMGet},
+            CommandSpec{"hgetall", 2, CMD_READONLY, 1, 1, 1, &Controller::handleHGetAll},
+            CommandSpec{"hdel", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleHDel},
+            CommandSpec{"hincrby", 4, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleHIncrBy},
+            CommandSpec{"sadd", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleSAdd},
+            CommandSpec{"srem", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleSRem},
+            CommandSpec{"sismember", 3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleSIsMember},
+            CommandSpec{"smembers", 2, CMD_READONLY, 1, 1, 1, &Controller::handleSMembers},
+            CommandSpec{"scard", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleSCard},
+            CommandSpec{"sinter", -2, CMD_READONLY, 1, -1, 1, &Controller::handleSInter},
+            CommandSpec{"sunion", -2, CMD_READONLY, 1, -1, 1, &Controller::handleSUnion},
+            CommandSpec{"sdiff", -2, CMD_READONLY, 1, -1, 1, &Controller::handleSDiff},
+            CommandSpec{"zadd", -4, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleZAdd},
+            CommandSpec{"zincrby", 4, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleZIncrBy},
+            CommandSpec{"zscore", 3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleZScore},
+            CommandSpec{"zrank", -3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleZRank},
+            CommandSpec{"zrevrank", -3, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleZRevRank},
+            CommandSpec{"zrange", -4, CMD_READONLY, 1, 1, 1, &Controller::handleZRange},
+            CommandSpec{"zrangebyscore", -4, CMD_READONLY, 1, 1, 1, &Controller::handleZRangeByScore},
+            CommandSpec{"zrem", -3, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handleZRem},
+            CommandSpec{"zcard", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleZCard},
+            CommandSpec{"pfadd", -2, CMD_WRITE | CMD_FAST, 1, 1, 1, &Controller::handlePFAdd},
+            CommandSpec{"pfcount", -2, CMD_READONLY, 1, -1, 1, &Controller::handlePFCount},
+            CommandSpec{"pfmerge", -2, CMD_WRITE, 1, -1, 1, &Controller::handlePFMerge},
+            CommandSpec{"type", 2, CMD_READONLY | CMD_FAST, 1, 1, 1, &Controller::handleType},
+            CommandSpec{"config", -2, CMD_ADMIN, 0, 0, 0, &Controller::handleConfig},
+            CommandSpec{"hello", -1, CMD_FAST, 0, 0, 0, &Controller::handleHello},
+            CommandSpec{"client", -2, 0, 0, 0, 0, &Controller::handleClient},
+            CommandSpec{"command", -1, 0, 0, 0, 0, &Controller::handleCommandInfo},
+    }};
+};
+
+void Controller::handleCommand(CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers) {
+    Client client(0);
+    handleCommand(client, args, out, buffers);
 
-    return command[1];
+    // Its subscriptions and watched keys end with the command.
+    pubsub.unsubscribeAll(client);
+    unwatchAll(client);
 }
-RedisType::RedisValue Controller::handlePing(const std::vector<RedisType::BulkString> &command) {
-    if (command.size() > 2) { return RedisType::SimpleError("ERR wrong number of arguments for 'ping' command"); }
-    if (command.size() == 2) { return command[1]; }
 
-    return RedisType::SimpleString("PONG");
+void Controller::handleCommand(Client &client, CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers) {
+    execute(client, args, out, buffers, true);
+}
+
+void Controller::replayCommand(CommandArgs args, OutputBuffer &out) {
+    Client client(0);
+    execute(client, args, out, {}, false);
+}
+
+void Controller::execute(Client &client, CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers, bool persist) {
+    ReplyWriter reply(out, client.protocol);
+
+    if (args.empty()) { return reply.raw(Replies::EMPTY_COMMAND_ERROR); }
+
+    const auto *command = Commands::table.find(args[0]);
+
+    // A command that cannot even be queued fails the whole transaction, as its caller cannot tell what EXEC would do.
+    if (!command || !command->acceptsArgs(args.size())) {
+        if (client.transaction) { client.transaction->aborted = true; }
+        if (!command) { return reply.raw(Replies::UNSUPPORTED_COMMAND_ERROR); }
+        return reply.wrongArity(command->name);
+    }
+
+    // A RESP2 connection in subscribed mode carries messages, replies to other commands could not be told apart.
+    if (client.protocol < 3 && client.subscriptions() > 0 && !command->hasFlag(CMD_SUBSCRIBED)) {
+        return reply.error(fmt::format("ERR Can't execute '{}': only (P|S)SUBSCRIBE / (P|S)UNSUBSCRIBE / PING / QUIT / "
+                                       "RESET are allowed in this context",
+                                       command->name));
+    }
+
+    if (client.transaction && !command->hasFlag(CMD_TRANSACTION)) {
+        client.transaction->commands.emplace_back(args.begin(), args.end());
+        return reply.raw(Replies::QUEUED);
+    }
+
+    CommandContext ctx{client, args, reply, buffers, persist};
+
+    // A write is logged before the store is unlocked, as EXEC does, so the log holds writes in the order they were
+    // applied and replays to the same state.
+    std::unique_lock<std::recursive_mutex> lock;
+    if (persist && persister && command->hasFlag(CMD_WRITE)) { lock = dataStore.lock(); }
+
+    if (!invoke(*command, ctx)) { return; }
+
+    // Logged before the reply reaches the client, which therefore never sees a write that could be lost.
+    if (persist && persister) { persister->writeAndFlush(encodeForLog(ctx)); }
+    if (lock) { lock.unlock(); }
+
+    command->forEachKey(args, [&](std::string_view key) { invalidateKey(key, &client); });
 }
 
-RedisType::RedisValue Controller::handleSet(const std::vector<RedisType::BulkString> &command, bool persist) {
-    if (command.size() < 3 || command.size() > 5) {
-        return RedisType::SimpleError("ERR wrong number of arguments for 'set' command");
+bool Controller::invoke(const CommandSpec &command, CommandContext &ctx) {
+    // Keys are tracked before they are read, so a concurrent write either is seen by the read or invalidates them.
+    if (ctx.client.tracking && command.hasFlag(CMD_READONLY)) {
+        command.forEachKey(ctx.args, [&](std::string_view key) { tracking.remember(key, ctx.client.id); });
     }
 
-    auto key = extractStringFromBytes(*command[1].data, 0, (*command[1].data).size());
-    auto val = extractStringFromBytes(*command[2].data, 0, (*command[2].data).size());
+    (this->*command.handler)(ctx);
+    return ctx.dirty;
+}
+
+RedisType::RedisValue Controller::handleCommand(CommandArgs args) {
+    OutputBuffer out;
+    handleCommand(args, out);
 
-    int expireTimeMillis = -1;
+    auto encoded = out.toString();
+    return parseMessage(std::span(reinterpret_cast<const uint8_t *>(encoded.data()), encoded.size()))->first;
+}
 
-    for (int i = 3; i < command.size(); ++i) {
-        std::string option = extractStringFromBytes(*command[i].data, 0, (*command[i].data).size());
-        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+RedisType::RedisValue Controller::handleCommand(const std::vector<RedisType::BulkString> &command) {
+    std::vector<std::string_view> args;
+    args.reserve(command.size());
 
-        if (option == "EX" && i + 1 < command.size()) {
-            try {
-                expireTimeMillis =
-                        std::stoi(extractStringFromBytes(*command[i + 1].data, 0, (*command[i + 1].data).size())) *
-                        1000;
-                ++i;
-            } catch (...) { return RedisType::SimpleError("ERR syntax error"); }
-        } else if (option == "PX" && i + 1 < command.size()) {
-            try {
-                expireTimeMillis =
-                        std::stoi(extractStringFromBytes(*command[i + 1].data, 0, (*command[i + 1].data).size()));
-                ++i;
-            } catch (...) { return RedisType::SimpleError("ERR syntax error"); }
+    for (const auto &arg: command) {
+        if (arg.data) {
+            args.emplace_back(reinterpret_cast<const char *>(arg.data->data()), arg.data->size());
         } else {
-            return RedisType::SimpleError("ERR syntax error");
+            args.emplace_back();
         }
     }
 
+    return handleCommand(args);
+}
+
+void Controller::handleEcho(CommandContext &ctx) { ctx.reply.bulkString(ctx.args[1]); }
+
+void Controller::handlePing(CommandContext &ctx) {
+    if (ctx.args.size() > 2) { return ctx.reply.wrongArity("ping"); }
+
+    // Subscribed RESP2 clients expect every reply in the shape of a message.
+    if (ctx.client.protocol < 3 && ctx.client.subscriptions() > 0) {
+        ctx.reply.arrayHeader(2);
+        ctx.reply.bulkString("pong");
+        return ctx.reply.bulkString(ctx.args.size() == 2 ? ctx.args[1] : "");
+    }
+    if (ctx.args.size() == 2) { return ctx.reply.bulkString(ctx.args[1]); }
+
+    ctx.reply.raw(Replies::PONG);
+}
+
+void Controller::handleSet(CommandContext &ctx) {
+    auto args = ctx.args;
+    auto key = args[1];
+    auto val = args[2];
+
+    long long expireTimeMillis = -1;
+
+    for (size_t i = 3; i < args.size(); ++i) {
+        auto option = args[i];
+
+        if ((equalsIgnoreCase(option, "EX") || equalsIgnoreCase(option, "PX")) && i + 1 < args.size() &&
+            expireTimeMillis == -1) {
+            auto time = parseInteger(args[++i]);
+            if (!time) { return ctx.reply.raw(Replies::SYNTAX_ERROR); }
+            expireTimeMillis = equalsIgnoreCase(option, "EX") ? *time * 1000 : *time;
+        } else {
+            return ctx.reply.raw(Replies::SYNTAX_ERROR);
+        }
+    }
 
-    if (persist && persister) { persister->writeAndFlush(fileEncode(command)); }
+    // A large value already sits in a buffer of its own, which becomes the stored value.
+    Value value;
+    if (ctx.buffers.size() > 2 && ctx.buffers[2]) {
+        value = encodeValue(std::move(ctx.buffers[2]));
+    } else {
+        value = encodeValue(val);
+    }
 
     if (expireTimeMillis > 0) {
-        dataStore.setWithExpiry(key, val,
+        dataStore.setWithExpiry(key, std::move(value),
                                 std::chrono::system_clock::now() + std::chrono::milliseconds(expireTimeMillis));
     } else {
-        dataStore.set(key, val);
+        dataStore.set(key, std::move(value));
+    }
+
+    ctx.dirty = true;
+    ctx.reply.raw(Replies::OK);
+}
+
+void Controller::handleGet(CommandContext &ctx) {
+    // Large values are appended by reference, so they reach the socket without being copied.
+    auto value = dataStore.getValue(ctx.args[1]);
+
+    if (!value) { return ctx.reply.null(); }
+    if (!isString(*value)) { return ctx.reply.raw(Replies::WRONG_TYPE_ERROR); }
+
+    writeValue(ctx.reply, std::move(*value));
+}
+
+void Controller::handleExists(CommandContext &ctx) {
+    int count = std::accumulate(ctx.args.begin() + 1, ctx.args.end(), 0, [this](int acc, std::string_view key) {
+        return acc + (dataStore.exists(key) ? 1 : 0);
+    });
+
+    ctx.reply.integer(count);
+}
+
+void Controller::handleMGet(CommandContext &ctx) {
+    auto values = dataStore.getValues(ctx.args.subspan(1));
+
+    ctx.reply.arrayHeader(values.size());
+    // Keys holding other types read as missing, like in Redis.
+    for (auto &value: values) {
+        if (value && isString(*value)) {
+            writeValue(ctx.reply, std::move(*value));
+        } else {
+            ctx.reply.null();
+        }
     }
+}
+
+void Controller::handleMSet(CommandContext &ctx) {
+    auto entries = collectKeyValues(ctx, "mset");
+    if (entries.empty()) { return; }
+
+    dataStore.setMany(entries);
+
+    ctx.dirty = true;
+    ctx.reply.raw(Replies::OK);
+}
 
+void Controller::handleMSetNx(CommandContext &ctx) {
+    auto entries = collectKeyValues(ctx, "msetnx");
+    if (entries.empty()) { return; }
 
-    return RedisType::SimpleString("OK");
+    ctx.dirty = dataStore.setManyIfAbsent(entries);
+    ctx.reply.integer(ctx.dirty ? 1 : 0);
 }
 
-RedisType::RedisValue Controller::handleGet(const std::vector<RedisType::BulkString> &command) {
-    if (command.size() != 2) { return RedisType::SimpleError("ERR wrong number of arguments for 'get' command"); }
+std::vector<DataStore::KeyValue> Controller::collectKeyValues(CommandContext &ctx,
+                                                              std::string_view command) {
+    auto args = ctx.args;
 
-    auto key = extractStringFromBytes(*command[1].data, 0, (*command[1].data).size());
+    if (args.size() % 2 == 0) {
+        ctx.reply.wrongArity(command);
+        return {};
+    }
 
-    auto valueOpt = dataStore.get(key);
+    // Values are copied before the store is locked, large ones already sit in buffers of their own.
+    std::vector<DataStore::KeyValue> entries;
+    entries.reserve(args.size() / 2);
 
-    if (valueOpt) { return RedisType::BulkString(*valueOpt); }
+    for (size_t i = 1; i < args.size(); i += 2) {
+        if (ctx.buffers.size() > i + 1 && ctx.buffers[i + 1]) {
+            entries.emplace_back(args[i], encodeValue(std::move(ctx.buffers[i + 1])));
+        } else {
+            entries.emplace_back(args[i], encodeValue(args[i + 1]));
+        }
+    }
 
-    return RedisType::BulkString();
+    return entries;
 }
-RedisType::RedisValue Controller::handleExists(const std::vector<RedisType::BulkString> &command) {
-    if (command.size() < 2) { return RedisType::SimpleError("ERR wrong number of arguments for 'exists' command"); }
 
-    int count =
-            std::accumulate(command.begin() + 1, command.end(), 0, [this](int acc, const RedisType::BulkString &cmd) {
-                auto key = extractStringFromBytes(*cmd.data, 0, cmd.data->size());
-                return acc + (dataStore.exists(key) ? 1 : 0);
-            });
+void Controller::handleIncr(CommandContext &ctx) { incrementBy(ctx, 1); }
+
+void Controller::handleDecr(CommandContext &ctx) { incrementBy(ctx, -1); }
+
+void Controller::handleIncrBy(CommandContext &ctx) {
+    auto delta = parseInteger(ctx.args[2]);
+    if (!delta) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+    incrementBy(ctx, *delta);
+}
+
+void Controller::handleDecrBy(CommandContext &ctx) {
+    auto delta = parseInteger(ctx.args[2]);
+    if (!delta) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+    // The smallest value has no positive counterpart to add.
+    if (*delta == std::numeric_limits<long long>::min()) {
+        return ctx.reply.error("ERR decrement would overflow");
+    }
+
+    incrementBy(ctx, -*delta);
+}
+
+void Controller::incrementBy(CommandContext &ctx, long long delta) {
+    auto result = dataStore.incrementBy(ctx.args[1], delta);
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    ctx.dirty = true;
+    ctx.reply.integer(*result);
+}
+
+void Controller::handleIncrByFloat(CommandContext &ctx) {
+    auto delta = parseLongDouble(ctx.args[2]);
+    if (!delta) { return ctx.reply.raw(Replies::NOT_FLOAT_ERROR); }
+
+    auto result = dataStore.incrementByFloat(ctx.args[1], *delta);
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    ctx.dirty = true;
+    ctx.reply.bulkString(*result);
+}
+
+void Controller::handleAppend(CommandContext &ctx) {
+    auto length = dataStore.append(ctx.args[1], ctx.args[2]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    ctx.dirty = true;
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handleSetRange(CommandContext &ctx) {
+    auto offset = parseInteger(ctx.args[2]);
+    if (!offset) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+    if (*offset < 0) { return ctx.reply.error("ERR offset is out of range"); }
+
+    auto length = dataStore.setRange(ctx.args[1], static_cast<size_t>(*offset), ctx.args[3]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    // An empty value changes nothing, there is nothing to log.
+    ctx.dirty = !ctx.args[3].empty();
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handleGetRange(CommandContext &ctx) {
+    auto start = parseInteger(ctx.args[2]);
+    auto end = parseInteger(ctx.args[3]);
+    if (!start || !end) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+    auto range = dataStore.getRange(ctx.args[1], *start, *end);
+    if (!range) { return writeStoreError(ctx.reply, range.error()); }
+
+    ctx.reply.bulkString(*range);
+}
+
+void Controller::handleStrLen(CommandContext &ctx) {
+    auto length = dataStore.length(ctx.args[1]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handleDel(CommandContext &ctx) {
+    auto count = dataStore.remove(ctx.args.subspan(1), false);
+
+    ctx.dirty = count > 0;
+    ctx.reply.integer(static_cast<long long>(count));
+}
+
+void Controller::handleUnlink(CommandContext &ctx) {
+    // Large values are freed on the lazy-free thread instead of this one.
+    auto count = dataStore.remove(ctx.args.subspan(1), true);
+
+    ctx.dirty = count > 0;
+    ctx.reply.integer(static_cast<long long>(count));
+}
+
+void Controller::handleFlushAll(CommandContext &ctx) {
+    bool lazy = false;
+
+    if (ctx.args.size() > 2) { return ctx.reply.raw(Replies::SYNTAX_ERROR); }
+    if (ctx.args.size() == 2) {
+        if (equalsIgnoreCase(ctx.args[1], "ASYNC")) {
+            lazy = true;
+        } else if (!equalsIgnoreCase(ctx.args[1], "SYNC")) {
+            return ctx.reply.raw(Replies::SYNTAX_ERROR);
+        }
+    }
+
+    dataStore.clear(lazy);
 
-    return RedisType::Integer(count);
+    // FLUSHALL names no keys, every tracking client drops its whole cache instead.
+    ctx.dirty = true;
+    invalidateAll(&ctx.client);
+    ctx.reply.raw(Replies::OK);
 }
 
-RedisType::RedisValue Controller::handleConfig(const std::vector<RedisType::BulkString> &command) {
-    return RedisType::Array();
+void Controller::handleMulti(CommandContext &ctx) {
+    if (ctx.client.transaction) { return ctx.reply.error("ERR MULTI calls can not be nested"); }
+
+    ctx.client.transaction.emplace();
+    ctx.reply.raw(Replies::OK);
+}
+
+void Controller::handleExec(CommandContext &ctx) {
+    auto &client = ctx.client;
+    if (!client.transaction) { return ctx.reply.error("ERR EXEC without MULTI"); }
+
+    auto transaction = std::move(*client.transaction);
+    client.transaction.reset();
+
+    if (transaction.aborted) {
+        unwatchAll(client);
+        return ctx.reply.error("EXECABORT Transaction discarded because of previous errors.");
+    }
+
+    // The whole transaction runs in one critical section: no other client sees part of it or writes in between, and
+    // the queued commands take the lock without waiting for it.
+    auto lock = dataStore.lock();
+
+    if (unwatchAll(client)) { return ctx.reply.nullArray(); }
+
+    std::vector<std::pair<const CommandSpec *, std::vector<std::string_view>>> written;
+    std::vector<uint8_t> log;
+
+    ctx.reply.arrayHeader(transaction.commands.size());
+    for (const auto &command: transaction.commands) {
+        std::vector<std::string_view> args(command.begin(), command.end());
+        const auto *spec = Commands::table.find(args[0]);
+
+        CommandContext queued{client, args, ctx.reply, {}, ctx.persist};
+        queued.mayBlock = false;
+        if (!invoke(*spec, queued)) { continue; }
+
+        if (ctx.persist && persister) {
+            auto encoded = encodeForLog(queued);
+            log.insert(log.end(), encoded.begin(), encoded.end());
+        }
+        written.emplace_back(spec, std::move(args));
+    }
+
+    // One write for all commands, so the log holds either the whole transaction or none of it.
+    if (!log.empty()) { persister->writeAndFlush(log); }
+    lock.unlock();
+
+    for (const auto &[spec, args]: written) {
+        spec->forEachKey(args, [&](std::string_view key) { invalidateKey(key, &client); });
+    }
+}
+
+void Controller::handleDiscard(CommandContext &ctx) {
+    if (!ctx.client.transaction) { return ctx.reply.error("ERR DISCARD without MULTI"); }
+
+    ctx.client.transaction.reset();
+    unwatchAll(ctx.client);
+    ctx.reply.raw(Replies::OK);
+}
+
+void Controller::handleWatch(CommandContext &ctx) {
+    if (ctx.client.transaction) { return ctx.reply.error("ERR WATCH inside MULTI is not allowed"); }
+
+    for (auto key: ctx.args.subspan(1)) { ctx.client.watchedKeys.emplace_back(key, dataStore.watch(key)); }
+    ctx.reply.raw(Replies::OK);
+}
+
+void Controller::handleUnwatch(CommandContext &ctx) {
+    unwatchAll(ctx.client);
+    ctx.reply.raw(Replies::OK);
+}
+
+bool Controller::unwatchAll(Client &client) {
+    if (client.watchedKeys.empty()) { return false; }
+
+    auto lock = dataStore.lock();
+    bool changed = false;
+    for (const auto &[key, version]: client.watchedKeys) {
+        changed = changed || dataStore.version(key) != version;
+        dataStore.unwatch(key);
+    }
+
+    client.watchedKeys.clear();
+    return changed;
+}
+
+void Controller::handleSubscribe(CommandContext &ctx) {
+    for (auto channel: ctx.args.subspan(1)) {
+        pubsub.subscribe(ctx.client, channel);
+        writeSubscription(ctx, "subscribe", channel);
+    }
+}
+
+void Controller::handleUnsubscribe(CommandContext &ctx) {
+    unsubscribe(ctx, "unsubscribe", ctx.client.channels, &PubSub::unsubscribe);
+}
+
+void Controller::handlePSubscribe(CommandContext &ctx) {
+    for (auto pattern: ctx.args.subspan(1)) {
+        pubsub.psubscribe(ctx.client, pattern);
+        writeSubscription(ctx, "psubscribe", pattern);
+    }
+}
+
+void Controller::handlePUnsubscribe(CommandContext &ctx) {
+    unsubscribe(ctx, "punsubscribe", ctx.client.patterns, &PubSub::punsubscribe);
+}
+
+void Controller::unsubscribe(CommandContext &ctx, std::string_view kind, const std::vector<std::string> &subscribed,
+                             bool (PubSub::*remove)(Client &, std::string_view)) {
+    if (ctx.args.size() > 1) {
+        for (auto name: ctx.args.subspan(1)) {
+            (pubsub.*remove)(ctx.client, name);
+            writeSubscription(ctx, kind, name);
+        }
+        return;
+    }
+
+    if (subscribed.empty()) { return writeSubscription(ctx, kind, std::nullopt); }
+
+    // Copied, as unsubscribing removes the names from the client's list.
+    auto names = subscribed;
+    for (const auto &name: names) {
+        (pubsub.*remove)(ctx.client, name);
+        writeSubscription(ctx, kind, name);
+    }
+}
+
+void Controller::handlePublish(CommandContext &ctx) {
+    ctx.reply.integer(static_cast<long long>(pubsub.publish(ctx.args[1], ctx.args[2])));
+}
+
+void Controller::handleLPush(CommandContext &ctx) { push(ctx, true); }
+
+void Controller::handleRPush(CommandContext &ctx) { push(ctx, false); }
+
+void Controller::push(CommandContext &ctx, bool front) {
+    auto key = ctx.args[1];
+    auto result = dataStore.push(key, ctx.args.subspan(2), front);
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    ctx.dirty = true;
+
+    // The blocked clients got their elements already, replaying the push alone would leave them in the list.
+    if (result->servedFront > 0 || result->servedBack > 0) {
+        ctx.loggedAs.emplace_back(ctx.args.begin(), ctx.args.end());
+        if (result->servedFront > 0) {
+            ctx.loggedAs.push_back({"LPOP", std::string(key), std::to_string(result->servedFront)});
+        }
+        if (result->servedBack > 0) {
+            ctx.loggedAs.push_back({"RPOP", std::string(key), std::to_string(result->servedBack)});
+        }
+    }
+
+    ctx.reply.integer(static_cast<long long>(result->length));
+}
+
+void Controller::handleLPop(CommandContext &ctx) { pop(ctx, true); }
+
+void Controller::handleRPop(CommandContext &ctx) { pop(ctx, false); }
+
+void Controller::pop(CommandContext &ctx, bool front) {
+    if (ctx.args.size() > 3) { return ctx.reply.wrongArity(front ? "lpop" : "rpop"); }
+
+    // Without a count, a single element is popped and replied as such rather than as an array.
+    std::optional<long long> count;
+    if (ctx.args.size() == 3) {
+        count = parseInteger(ctx.args[2]);
+        if (!count || *count < 0) { return ctx.reply.error("ERR value is out of range, must be positive"); }
+    }
+
+    // Nothing is popped, only whether the key holds a list is told.
+    if (count == 0) {
+        auto length = dataStore.listLength(ctx.args[1]);
+        if (!length) { return writeStoreError(ctx.reply, length.error()); }
+        if (*length == 0) { return ctx.reply.nullArray(); }
+        return ctx.reply.raw(Replies::EMPTY_ARRAY);
+    }
+
+    auto elements = dataStore.pop(ctx.args[1], count.value_or(1), front);
+    if (!elements) { return writeStoreError(ctx.reply, elements.error()); }
+
+    if (elements->empty()) { return count ? ctx.reply.nullArray() : ctx.reply.null(); }
+
+    ctx.dirty = true;
+    if (!count) { return ctx.reply.bulkString(elements->front()); }
+    writeElements(ctx.reply, *elements);
+}
+
+void Controller::handleLRange(CommandContext &ctx) {
+    auto start = parseInteger(ctx.args[2]);
+    auto end = parseInteger(ctx.args[3]);
+    if (!start || !end) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+    auto elements = dataStore.listRange(ctx.args[1], *start, *end);
+    if (!elements) { return writeStoreError(ctx.reply, elements.error()); }
+
+    writeElements(ctx.reply, *elements);
+}
+
+void Controller::handleLLen(CommandContext &ctx) {
+    auto length = dataStore.listLength(ctx.args[1]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handleBLPop(CommandContext &ctx) { blockingPop(ctx, true); }
+
+void Controller::handleBRPop(CommandContext &ctx) { blockingPop(ctx, false); }
+
+void Controller::blockingPop(CommandContext &ctx, bool front) {
+    auto timeout = parseLongDouble(ctx.args.back());
+    if (!timeout) { return ctx.reply.error("ERR timeout is not a float or out of range"); }
+    if (*timeout < 0) { return ctx.reply.error("ERR timeout is negative"); }
+    if (*timeout > MAX_BLOCK_SECONDS) { return ctx.reply.error("ERR timeout is out of range"); }
+
+    auto blocked = std::make_shared<BlockedPop>();
+    blocked->keys.assign(ctx.args.begin() + 1, ctx.args.end() - 1);
+    blocked->front = front;
+
+    // Only a connected client has a mailbox for the reply to arrive in.
+    auto client = ctx.mayBlock ? clients.find(ctx.client.id) : nullptr;
+    if (client) {
+        blocked->serve = [weak = std::weak_ptr<Client>(client)](std::string_view key, std::string_view element) {
+            auto client = weak.lock();
+            if (!client) { return; }
+
+            client->unblock(std::make_shared<const std::string>(encodeKeyElement(client->protocol, key, element)));
+        };
+
+        // Set before registering, a push on another thread may serve the client right away.
+        ctx.client.blocked = true;
+    }
+
+    auto result = dataStore.popOrBlock(blocked, client != nullptr);
+    if (!result || *result) { ctx.client.blocked = false; }
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    if (*result) {
+        const auto &[key, element] = **result;
+        ctx.dirty = true;
+        ctx.loggedAs.push_back({front ? "LPOP" : "RPOP", key});
+        return ctx.reply.raw(encodeKeyElement(ctx.client.protocol, key, element));
+    }
+
+    if (!client) { return ctx.reply.nullArray(); }
+
+    // The reply is delivered to the mailbox later, by the push that serves the client or once the timeout passes.
+    ctx.client.blockedPop = std::move(blocked);
+    ctx.client.blockedUntil.reset();
+    if (*timeout > 0) {
+        ctx.client.blockedUntil = std::chrono::steady_clock::now() +
+                                  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<long double>(*timeout));
+    }
+}
+
+void Controller::handleHSet(CommandContext &ctx) {
+    if (ctx.args.size() % 2 != 0) { return ctx.reply.wrongArity("hset"); }
+
+    std::vector<DataStore::FieldValue> fields;
+    fields.reserve(ctx.args.size() / 2 - 1);
+    for (size_t i = 2; i < ctx.args.size(); i += 2) { fields.emplace_back(ctx.args[i], ctx.args[i + 1]); }
+
+    auto added = dataStore.hashSet(ctx.args[1], fields);
+    if (!added) { return writeStoreError(ctx.reply, added.error()); }
+
+    ctx.dirty = true;
+    ctx.reply.integer(static_cast<long long>(*added));
+}
+
+void Controller::handleHGet(CommandContext &ctx) {
+    auto values = dataStore.hashGet(ctx.args[1], ctx.args.subspan(2));
+    if (!values) { return writeStoreError(ctx.reply, values.error()); }
+
+    const auto &value = values->front();
+    if (!value) { return ctx.reply.null(); }
+    ctx.reply.bulkString(*value);
+}
+
+void Controller::handleHMGet(CommandContext &ctx) {
+    auto values = dataStore.hashGet(ctx.args[1], ctx.args.subspan(2));
+    if (!values) { return writeStoreError(ctx.reply, values.error()); }
+
+    ctx.reply.arrayHeader(values->size());
+    for (const auto &value: *values) {
+        if (value) {
+            ctx.reply.bulkString(*value);
+        } else {
+            ctx.reply.null();
+        }
+    }
+}
+
+void Controller::handleHGetAll(CommandContext &ctx) {
+    auto fields = dataStore.hashGetAll(ctx.args[1]);
+    if (!fields) { return writeStoreError(ctx.reply, fields.error()); }
+
+    ctx.reply.mapHeader(fields->size());
+    for (const auto &[field, value]: *fields) {
+        ctx.reply.bulkString(field);
+        ctx.reply.bulkString(value);
+    }
+}
+
+void Controller::handleHDel(CommandContext &ctx) {
+    auto removed = dataStore.hashRemove(ctx.args[1], ctx.args.subspan(2));
+    if (!removed) { return writeStoreError(ctx.reply, removed.error()); }
+
+    ctx.dirty = *removed > 0;
+    ctx.reply.integer(static_cast<long long>(*removed));
+}
+
+void Controller::handleHIncrBy(CommandContext &ctx) {
+    auto delta = parseInteger(ctx.args[3]);
+    if (!delta) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+    auto result = dataStore.hashIncrementBy(ctx.args[1], ctx.args[2], *delta);
+    if (!result) {
+        if (result.error() == StoreError::NotAnInteger) { return ctx.reply.error("ERR hash value is not an integer"); }
+        return writeStoreError(ctx.reply, result.error());
+    }
+
+    ctx.dirty = true;
+    ctx.reply.integer(*result);
+}
+
+void Controller::handleSAdd(CommandContext &ctx) {
+    auto added = dataStore.setAdd(ctx.args[1], ctx.args.subspan(2));
+    if (!added) { return writeStoreError(ctx.reply, added.error()); }
+
+    ctx.dirty = *added > 0;
+    ctx.reply.integer(static_cast<long long>(*added));
+}
+
+void Controller::handleSRem(CommandContext &ctx) {
+    auto removed = dataStore.setRemove(ctx.args[1], ctx.args.subspan(2));
+    if (!removed) { return writeStoreError(ctx.reply, removed.error()); }
+
+    ctx.dirty = *removed > 0;
+    ctx.reply.integer(static_cast<long long>(*removed));
+}
+
+void Controller::handleSIsMember(CommandContext &ctx) {
+    auto contains = dataStore.setContains(ctx.args[1], ctx.args[2]);
+    if (!contains) { return writeStoreError(ctx.reply, contains.error()); }
+
+    ctx.reply.integer(*contains ? 1 : 0);
+}
+
+void Controller::handleSMembers(CommandContext &ctx) {
+    auto members = dataStore.setMembers(ctx.args[1]);
+    if (!members) { return writeStoreError(ctx.reply, members.error()); }
+
+    writeSetMembers(ctx.reply, *members);
+}
+
+void Controller::handleSCard(CommandContext &ctx) {
+    auto length = dataStore.setLength(ctx.args[1]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handleSInter(CommandContext &ctx) {
+    auto members = dataStore.setIntersection(ctx.args.subspan(1));
+    if (!members) { return writeStoreError(ctx.reply, members.error()); }
+
+    writeSetMembers(ctx.reply, *members);
+}
+
+void Controller::handleSUnion(CommandContext &ctx) {
+    auto members = dataStore.setUnion(ctx.args.subspan(1));
+    if (!members) { return writeStoreError(ctx.reply, members.error()); }
+
+    writeSetMembers(ctx.reply, *members);
+}
+
+void Controller::handleSDiff(CommandContext &ctx) {
+    auto members = dataStore.setDifference(ctx.args.subspan(1));
+    if (!members) { return writeStoreError(ctx.reply, members.error()); }
+
+    writeSetMembers(ctx.reply, *members);
+}
+
+void Controller::handleZAdd(CommandContext &ctx) {
+    DataStore::SortedSetAddOptions options;
+    // CH: count the members whose score changed along with the added ones.
+    bool countChanged = false;
+
+    size_t i = 2;
+    for (; i < ctx.args.size(); ++i) {
+        auto option = ctx.args[i];
+        if (equalsIgnoreCase(option, "NX")) {
+            options.onlyNew = true;
+        } else if (equalsIgnoreCase(option, "XX")) {
+            options.onlyExisting = true;
+        } else if (equalsIgnoreCase(option, "GT")) {
+            options.onlyGreater = true;
+        } else if (equalsIgnoreCase(option, "LT")) {
+            options.onlyLess = true;
+        } else if (equalsIgnoreCase(option, "CH")) {
+            countChanged = true;
+        } else if (equalsIgnoreCase(option, "INCR")) {
+            options.increment = true;
+        } else {
+            break;
+        }
+    }
+
+    auto pairs = ctx.args.subspan(i);
+    if (pairs.empty() || pairs.size() % 2 != 0) { return ctx.reply.raw(Replies::SYNTAX_ERROR); }
+    if (options.onlyNew && options.onlyExisting) {
+        return ctx.reply.error("ERR XX and NX options at the same time are not compatible");
+    }
+    if ((options.onlyGreater && options.onlyLess) || (options.onlyNew && (options.onlyGreater || options.onlyLess))) {
+        return ctx.reply.error("ERR GT, LT, and/or NX options at the same time are not compatible");
+    }
+    if (options.increment && pairs.size() != 2) {
+        return ctx.reply.error("ERR INCR option supports a single increment-element pair");
+    }
+
+    std::vector<DataStore::ScoreMember> members;
+    members.reserve(pairs.size() / 2);
+    for (size_t j = 0; j < pairs.size(); j += 2) {
+        auto score = parseScore(pairs[j]);
+        if (!score) { return ctx.reply.raw(Replies::NOT_FLOAT_ERROR); }
+        members.push_back({*score, pairs[j + 1]});
+    }
+
+    auto result = dataStore.sortedSetAdd(ctx.args[1], members, options);
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    ctx.dirty = result->added > 0 || result->updated > 0;
+
+    if (options.increment) {
+        if (!result->score) { return ctx.reply.null(); }
+        return ctx.reply.doubleValue(*result->score);
+    }
+    ctx.reply.integer(static_cast<long long>(result->added + (countChanged ? result->updated : 0)));
+}
+
+void Controller::handleZIncrBy(CommandContext &ctx) {
+    auto increment = parseScore(ctx.args[2]);
+    if (!increment) { return ctx.reply.raw(Replies::NOT_FLOAT_ERROR); }
+
+    DataStore::ScoreMember member{*increment, ctx.args[3]};
+    auto result = dataStore.sortedSetAdd(ctx.args[1], std::span(&member, 1), {.increment = true});
+    if (!result) { return writeStoreError(ctx.reply, result.error()); }
+
+    ctx.dirty = result->added > 0 || result->updated > 0;
+    ctx.reply.doubleValue(*result->score);
+}
+
+void Controller::handleZScore(CommandContext &ctx) {
+    auto score = dataStore.sortedSetScore(ctx.args[1], ctx.args[2]);
+    if (!score) { return writeStoreError(ctx.reply, score.error()); }
+
+    if (!*score) { return ctx.reply.null(); }
+    ctx.reply.doubleValue(**score);
+}
+
+void Controller::handleZRank(CommandContext &ctx) { rank(ctx, false); }
+
+void Controller::handleZRevRank(CommandContext &ctx) { rank(ctx, true); }
+
+void Controller::rank(CommandContext &ctx, bool reverse) {
+    if (ctx.args.size() > 4 || (ctx.args.size() == 4 && !equalsIgnoreCase(ctx.args[3], "WITHSCORE"))) {
+        return ctx.reply.raw(Replies::SYNTAX_ERROR);
+    }
+    bool withScore = ctx.args.size() == 4;
+
+    auto rank = dataStore.sortedSetRank(ctx.args[1], ctx.args[2], reverse);
+    if (!rank) { return writeStoreError(ctx.reply, rank.error()); }
+
+    if (!*rank) { return withScore ? ctx.reply.nullArray() : ctx.reply.null(); }
+    if (!withScore) { return ctx.reply.integer(static_cast<long long>((*rank)->first)); }
+
+    ctx.reply.arrayHeader(2);
+    ctx.reply.integer(static_cast<long long>((*rank)->first));
+    ctx.reply.doubleValue((*rank)->second);
+}
+
+void Controller::handleZRange(CommandContext &ctx) { range(ctx, false); }
+
+void Controller::handleZRangeByScore(CommandContext &ctx) { range(ctx, true); }
+
+void Controller::range(CommandContext &ctx, bool byScore) {
+    // Only ZRANGE takes BYSCORE and REV.
+    bool isZRange = !byScore;
+    bool reverse = false;
+    bool withScores = false;
+    std::optional<std::pair<long long, long long>> limit;
+
+    for (size_t i = 4; i < ctx.args.size(); ++i) {
+        auto option = ctx.args[i];
+        if (equalsIgnoreCase(option, "WITHSCORES")) {
+            withScores = true;
+        } else if (equalsIgnoreCase(option, "LIMIT") && i + 2 < ctx.args.size()) {
+            auto offset = parseInteger(ctx.args[i + 1]);
+            auto count = parseInteger(ctx.args[i + 2]);
+            if (!offset || !count) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+            limit.emplace(*offset, *count);
+            i += 2;
+        } else if (isZRange && equalsIgnoreCase(option, "BYSCORE")) {
+            byScore = true;
+        } else if (isZRange && equalsIgnoreCase(option, "REV")) {
+            reverse = true;
+        } else {
+            return ctx.reply.raw(Replies::SYNTAX_ERROR);
+        }
+    }
+
+    if (limit && !byScore) {
+        return ctx.reply.error("ERR syntax error, LIMIT is only supported in combination with either BYSCORE or BYLEX");
+    }
+
+    if (!byScore) {
+        auto start = parseInteger(ctx.args[2]);
+        auto end = parseInteger(ctx.args[3]);
+        if (!start || !end) { return ctx.reply.raw(Replies::NOT_INTEGER_ERROR); }
+
+        auto entries = dataStore.sortedSetRange(ctx.args[1], *start, *end, reverse);
+        if (!entries) { return writeStoreError(ctx.reply, entries.error()); }
+        return writeScoredMembers(ctx.reply, *entries, withScores, ctx.client.protocol);
+    }
+
+    // Reversed, the range is given from its upper bound to its lower one.
+    auto min = parseScoreBound(ctx.args[reverse ? 3 : 2]);
+    auto max = parseScoreBound(ctx.args[reverse ? 2 : 3]);
+    if (!min || !max) { return ctx.reply.error("ERR min or max is not a float"); }
+
+    // A negative offset selects nothing, a negative count everything after the offset.
+    auto [offset, count] = limit.value_or(std::pair{0LL, -1LL});
+    if (offset < 0) { return writeScoredMembers(ctx.reply, {}, withScores, ctx.client.protocol); }
+
+    ScoreRange range{min->first, max->first, min->second, max->second};
+    auto entries = dataStore.sortedSetRangeByScore(ctx.args[1], range, reverse, offset,
+                                                   count < 0 ? std::numeric_limits<size_t>::max() : count);
+    if (!entries) { return writeStoreError(ctx.reply, entries.error()); }
+    writeScoredMembers(ctx.reply, *entries, withScores, ctx.client.protocol);
+}
+
+void Controller::handleZRem(CommandContext &ctx) {
+    auto removed = dataStore.sortedSetRemove(ctx.args[1], ctx.args.subspan(2));
+    if (!removed) { return writeStoreError(ctx.reply, removed.error()); }
+
+    ctx.dirty = *removed > 0;
+    ctx.reply.integer(static_cast<long long>(*removed));
+}
+
+void Controller::handleZCard(CommandContext &ctx) {
+    auto length = dataStore.sortedSetLength(ctx.args[1]);
+    if (!length) { return writeStoreError(ctx.reply, length.error()); }
+
+    ctx.reply.integer(static_cast<long long>(*length));
+}
+
+void Controller::handlePFAdd(CommandContext &ctx) {
+    auto changed = dataStore.hyperLogLogAdd(ctx.args[1], ctx.args.subspan(2));
+    if (!changed) { return writeStoreError(ctx.reply, changed.error()); }
+
+    ctx.dirty = *changed;
+    ctx.reply.integer(*changed ? 1 : 0);
+}
+
+void Controller::handlePFCount(CommandContext &ctx) {
+    auto count = dataStore.hyperLogLogCount(ctx.args.subspan(1));
+    if (!count) { return writeStoreError(ctx.reply, count.error()); }
+
+    ctx.reply.integer(static_cast<long long>(*count));
+}
+
+void Controller::handlePFMerge(CommandContext &ctx) {
+    auto merged = dataStore.hyperLogLogMerge(ctx.args[1], ctx.args.subspan(2));
+    if (!merged) { return writeStoreError(ctx.reply, merged.error()); }
+
+    ctx.dirty = true;
+    ctx.reply.raw(Replies::OK);
+}
+
+void Controller::handleType(CommandContext &ctx) {
+    auto value = dataStore.getValue(ctx.args[1]);
+
+    if (!value) { return ctx.reply.simpleString("none"); }
+    ctx.reply.simpleString(typeName(*value));
+}
+
+void Controller::handleConfig(CommandContext &ctx) { ctx.reply.nullArray(); }
+
+void Controller::handleHello(CommandContext &ctx) {
+    auto &client = ctx.client;
+    auto args = ctx.args;
+    auto &reply = ctx.reply;
+    int protocol = client.protocol;
+
+    if (args.size() > 1) {
+        auto version = parseInteger(args[1]);
+        if (!version) { return reply.error("ERR Protocol version is not an integer or out of range"); }
+        if (*version != 2 && *version != 3) { return reply.error("NOPROTO unsupported protocol version"); }
+        protocol = static_cast<int>(*version);
+    }
+
+    std::optional<std::string_view> name;
+
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (equalsIgnoreCase(args[i], "AUTH") && i + 2 < args.size()) {
+            // There are no passwords to check, only the default user exists.
+            if (args[i + 1] != "default") {
+                return reply.error("WRONGPASS invalid username-password pair or user is disabled.");
+            }
+            i += 2;
+        } else if (equalsIgnoreCase(args[i], "SETNAME") && i + 1 < args.size()) {
+            name = args[++i];
+            if (!isValidClientName(*name)) {
+                return reply.error("ERR Client names cannot contain spaces, newlines or special characters.");
+            }
+        } else {
+            return reply.raw(Replies::SYNTAX_ERROR);
+        }
+    }
+
+    // HELLO's own reply is already encoded in the negotiated protocol.
+    client.protocol = protocol;
+    if (name) { client.name = *name; }
+
+    reply.setProtocol(protocol);
+    reply.mapHeader(7);
+    reply.bulkString("server");
+    reply.bulkString("redis");
+    reply.bulkString("version");
+    reply.bulkString(SERVER_VERSION);
+    reply.bulkString("proto");
+    reply.integer(protocol);
+    reply.bulkString("id");
+    reply.integer(static_cast<long long>(client.id));
+    reply.bulkString("mode");
+    reply.bulkString("standalone");
+    reply.bulkString("role");
+    reply.bulkString("master");
+    reply.bulkString("modules");
+    reply.raw(Replies::EMPTY_ARRAY);
+}
+
+void Controller::handleClient(CommandContext &ctx) {
+    auto &client = ctx.client;
+    auto args = ctx.args;
+    auto &reply = ctx.reply;
+    auto subcommand = args[1];
+
+    if (equalsIgnoreCase(subcommand, "ID")) {
+        if (args.size() != 2) { return reply.wrongArity("client|id"); }
+        reply.integer(static_cast<long long>(client.id));
+    } else if (equalsIgnoreCase(subcommand, "SETNAME")) {
+        if (args.size() != 3) { return reply.wrongArity("client|setname"); }
+        if (!isValidClientName(args[2])) {
+            return reply.error("ERR Client names cannot contain spaces, newlines or special characters.");
+        }
+        client.name = args[2];
+        reply.raw(Replies::OK);
+    } else if (equalsIgnoreCase(subcommand, "GETNAME")) {
+        if (args.size() != 2) { return reply.wrongArity("client|getname"); }
+        if (client.name.empty()) { return reply.null(); }
+        reply.bulkString(client.name);
+    } else if (equalsIgnoreCase(subcommand, "TRACKING")) {
+        handleClientTracking(ctx);
+    } else {
+        reply.error("ERR unknown subcommand '" + std::string(subcommand) + "'. Try CLIENT HELP.");
+    }
+}
+
+void Controller::handleClientTracking(CommandContext &ctx) {
+    auto &client = ctx.client;
+    auto args = ctx.args;
+    auto &reply = ctx.reply;
+
+    if (args.size() < 3) { return reply.wrongArity("client|tracking"); }
+
+    bool noLoop = false;
+
+    for (size_t i = 3; i < args.size(); ++i) {
+        if (equalsIgnoreCase(args[i], "NOLOOP")) {
+            noLoop = true;
+        } else if (equalsIgnoreCase(args[i], "REDIRECT") || equalsIgnoreCase(args[i], "BCAST") ||
+                   equalsIgnoreCase(args[i], "PREFIX") || equalsIgnoreCase(args[i], "OPTIN") ||
+                   equalsIgnoreCase(args[i], "OPTOUT")) {
+            return reply.error("ERR tracking option '" + std::string(args[i]) + "' is not supported");
+        } else {
+            return reply.raw(Replies::SYNTAX_ERROR);
+        }
+    }
+
+    if (equalsIgnoreCase(args[2], "ON")) {
+        client.tracking = true;
+        client.trackingNoLoop = noLoop;
+    } else if (equalsIgnoreCase(args[2], "OFF")) {
+        // Keys the client read stay in the table until written, it just no longer receives their invalidations.
+        client.tracking = false;
+        client.trackingNoLoop = false;
+    } else {
+        return reply.raw(Replies::SYNTAX_ERROR);
+    }
+
+    reply.raw(Replies::OK);
+}
+
+void Controller::handleCommandInfo(CommandContext &ctx) {
+    auto args = ctx.args;
+    auto &reply = ctx.reply;
+    auto commands = Commands::table.all();
+
+    if (args.size() == 1) {
+        reply.arrayHeader(commands.size());
+        for (const auto &command: commands) { writeCommandInfo(reply, command); }
+        return;
+    }
+
+    auto subcommand = args[1];
+
+    if (equalsIgnoreCase(subcommand, "COUNT")) {
+        if (args.size() != 2) { return reply.wrongArity("command|count"); }
+        reply.integer(static_cast<long long>(commands.size()));
+    } else if (equalsIgnoreCase(subcommand, "LIST")) {
+        if (args.size() != 2) { return reply.wrongArity("command|list"); }
+        reply.arrayHeader(commands.size());
+        for (const auto &command: commands) { reply.bulkString(command.name); }
+    } else if (equalsIgnoreCase(subcommand, "INFO")) {
+        // Without names, every command is described.
+        if (args.size() == 2) {
+            reply.arrayHeader(commands.size());
+            for (const auto &command: commands) { writeCommandInfo(reply, command); }
+            return;
+        }
+
+        reply.arrayHeader(args.size() - 2);
+        for (auto name: args.subspan(2)) {
+            const auto *command = Commands::table.find(name);
+            if (command) {
+                writeCommandInfo(reply, *command);
+            } else {
+                reply.nullArray();
+            }
+        }
+    } else {
+        reply.error("ERR unknown subcommand '" + std::string(subcommand) + "'. Try COMMAND HELP.");
+    }
+}
+
+void Controller::invalidateKey(std::string_view key, const Client *writer) {
+    sendInvalidation(tracking.invalidate(key), key, writer);
+}
+
+void Controller::invalidateAll(const Client *writer) {
+    sendInvalidation(tracking.invalidateAll(), std::nullopt, writer);
+}
+
+void Controller::sendInvalidation(const std::vector<uint64_t> &clientIds, std::optional<std::string_view> key,
+                                  const Client *writer) {
+    if (clientIds.empty()) { return; }
+
+    // Encoded once and shared by every client that cached the key.
+    std::shared_ptr<const std::string> message;
+
+    for (auto id: clientIds) {
+        auto client = clients.find(id);
+
+        // RESP2 clients could only receive invalidations through a redirect to a Pub/Sub connection.
+        if (!client || !client->tracking || client->protocol < 3) { continue; }
+        if (writer && writer->id == id && client->trackingNoLoop) { continue; }
+
+        if (!message) {
+            OutputBuffer out;
+            ReplyWriter push(out, 3);
+            push.pushHeader(2);
+            push.bulkString("invalidate");
+            if (key) {
+                push.arrayHeader(1);
+                push.bulkString(*key);
+            } else {
+                push.null();
+            }
+            message = std::make_shared<const std::string>(out.toString());
+        }
+
+        client->deliver(message);
+    }
 }
@@ -1,25 +1,257 @@
 #pragma once
 
+#include "client.h"
+#include "command_table.h"
 #include "datastore.h"
+#include "output_buffer.h"
 #include "persister.h"
+#include "pubsub.h"
 #include "redis_type.h"
+#include "reply_writer.h"
+#include "tracking_table.h"
+#include <memory>
 #include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Arguments of a command, viewing the bytes of the request they were parsed from.
+using CommandArgs = std::span<const std::string_view>;
+
+// Buffers holding large arguments on their own, indexed like the arguments and null for the others. Commands that
+// store such an argument take its buffer over instead of copying it. Empty if no argument has its own buffer.
+using ArgumentBuffers = std::span<std::shared_ptr<std::string>>;
+
+/**
+ * A command being executed: the client that sent it, its arguments and where its reply goes.
+ */
+struct CommandContext {
+    Client &client;
+    CommandArgs args;
+    ReplyWriter &reply;
+    ArgumentBuffers buffers;
+
+    // Whether writes go to the write-ahead log, unset while it is replayed.
+    bool persist = true;
+
+    // Set by write commands that changed their keys, which are then logged and invalidated.
+    bool dirty = false;
+
+    // Unset where the client cannot wait for a blocking command, such as inside a transaction. The command then only
+    // tries once, like in Redis.
+    bool mayBlock = true;
+
+    // Commands logged in place of the arguments, if any, for writes that would not replay the same from them: a
+    // blocking pop is logged as the pop it made, a push also logs the pops it made for blocked clients.
+    std::vector<std::vector<std::string>> loggedAs{};
+};
 
 class Controller {
 public:
     Controller();
-    explicit Controller(const std::optional<std::string> &writeAheadLogFileName);
+    explicit Controller(const std::optional<std::string> &writeAheadLogFileName, EncodingLimits encodingLimits = {},
+                        size_t maxStringLength = DataStore::DEFAULT_MAX_STRING_LENGTH, size_t numSetWorkers = 0);
 
+    // Stops the expiry daemon before the members its listener uses are destroyed.
+    ~Controller();
+
+    /**
+     * Registers a connected client. The notifier is called when messages for the client are queued from other
+     * clients' commands, e.g. invalidations of keys it tracks.
+     */
+    std::shared_ptr<Client> connectClient(Client::Notifier notifier = {});
+    void disconnectClient(Client &client);
+
+    /**
+     * Ends the blocking command the client waits in with a null reply, delivered to its mailbox, unless a write has
+     * served it meanwhile. Called by the thread serving the client once the command's timeout passed.
+     */
+    void timeoutBlockedClient(Client &client);
+
+    /**
+     * Handles a command sent by client and appends the encoded reply to out.
+     */
+    void handleCommand(Client &client, CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers = {});
+
+    /**
+     * Handles the command as a RESP2 client without any connection state, and appends the encoded reply to out.
+     */
+    void handleCommand(CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers = {});
+
+    /**
+     * Handles the command and returns the decoded reply, for callers that inspect it.
+     */
+    RedisType::RedisValue handleCommand(CommandArgs args);
     RedisType::RedisValue handleCommand(const std::vector<RedisType::BulkString> &command);
-    RedisType::RedisValue handleSet(const std::vector<RedisType::BulkString> &command, bool persist = false);
+
+    /**
+     * Executes a command restored from the write-ahead log, without logging it again.
+     */
+    void replayCommand(CommandArgs args, OutputBuffer &out);
 
 private:
-    RedisType::RedisValue handleEcho(const std::vector<RedisType::BulkString> &command);
-    RedisType::RedisValue handlePing(const std::vector<RedisType::BulkString> &command);
-    RedisType::RedisValue handleGet(const std::vector<RedisType::BulkString> &command);
-    RedisType::RedisValue handleExists(const std::vector<RedisType::BulkString> &command);
-    RedisType::RedisValue handleConfig(const std::vector<RedisType::BulkString> &command);
+    // Holds the command table, which refers to the private handlers.
+    friend struct Commands;
+
+    /**
+     * Looks the command up, checks its arity and runs it. Write commands that changed their keys are appended to the
+     * write-ahead log if persist is set, and their keys are invalidated for tracking clients.
+     */
+    void execute(Client &client, CommandArgs args, OutputBuffer &out, ArgumentBuffers buffers, bool persist);
+
+    /**
+     * Runs a command whose arity was checked, tracking the keys of read-only commands for the client.
+     *
+     * @return Whether the command changed its keys.
+     */
+    bool invoke(const CommandSpec &command, CommandContext &ctx);
+
+    /**
+     * Stops watching the keys the client watches.
+     *
+     * @return Whether any of them changed since the client started watching it.
+     */
+    bool unwatchAll(Client &client);
+
+    void handleEcho(CommandContext &ctx);
+    void handlePing(CommandContext &ctx);
+    void handleSet(CommandContext &ctx);
+    void handleGet(CommandContext &ctx);
+    void handleExists(CommandContext &ctx);
+    void handleMGet(CommandContext &ctx);
+    void handleMSet(CommandContext &ctx);
+    void handleMSetNx(CommandContext &ctx);
+    void handleIncr(CommandContext &ctx);
+    void handleDecr(CommandContext &ctx);
+    void handleIncrBy(CommandContext &ctx);
+    void handleDecrBy(CommandContext &ctx);
+    void handleIncrByFloat(CommandContext &ctx);
+    void handleAppend(CommandContext &ctx);
+    void handleSetRange(CommandContext &ctx);
+    void handleGetRange(CommandContext &ctx);
+    void handleStrLen(CommandContext &ctx);
+    void handleDel(CommandContext &ctx);
+    void handleUnlink(CommandContext &ctx);
+    void handleFlushAll(CommandContext &ctx);
+    void handleMulti(CommandContext &ctx);
+    void handleExec(CommandContext &ctx);
+    void handleDiscard(CommandContext &ctx);
+    void handleWatch(CommandContext &ctx);
+    void handleUnwatch(CommandContext &ctx);
+    void handleSubscribe(CommandContext &ctx);
+    void handleUnsubscribe(CommandContext &ctx);
+    void handlePSubscribe(CommandContext &ctx);
+    void handlePUnsubscribe(CommandContext &ctx);
+    void handlePublish(CommandContext &ctx);
+    void handleLPush(CommandContext &ctx);
+    void handleRPush(CommandContext &ctx);
+    void handleLPop(CommandContext &ctx);
+    void handleRPop(CommandContext &ctx);
+    void handleLRange(CommandContext &ctx);
+    void handleLLen(CommandContext &ctx);
+    void handleBLPop(CommandContext &ctx);
+    void handleBRPop(CommandContext &ctx);
+    void handleHSet(CommandContext &ctx);
+    void handleHGet(CommandContext &ctx);
+    void handleHMGet(CommandContext &ctx);
+    void handleHGetAll(CommandContext &ctx);
+    void handleHDel(CommandContext &ctx);
+    void handleHIncrBy(CommandContext &ctx);
+    void handleSAdd(CommandContext &ctx);
+    void handleSRem(CommandContext &ctx);
+    void handleSIsMember(CommandContext &ctx);
+    void handleSMembers(CommandContext &ctx);
+    void handleSCard(CommandContext &ctx);
+    void handleSInter(CommandContext &ctx);
+    void handleSUnion(CommandContext &ctx);
+    void handleSDiff(CommandContext &ctx);
+    void handleZAdd(CommandContext &ctx);
+    void handleZIncrBy(CommandContext &ctx);
+    void handleZScore(CommandContext &ctx);
+    void handleZRank(CommandContext &ctx);
+    void handleZRevRank(CommandContext &ctx);
+    void handleZRange(CommandContext &ctx);
+    void handleZRangeByScore(CommandContext &ctx);
+    void handleZRem(CommandContext &ctx);
+    void handleZCard(CommandContext &ctx);
+    void handlePFAdd(CommandContext &ctx);
+    void handlePFCount(CommandContext &ctx);
+    void handlePFMerge(CommandContext &ctx);
+    void handleType(CommandContext &ctx);
+
+    /**
+     * Pushes the arguments after the key onto the head or tail of its list. Pops made for clients blocked on the key
+     * are logged after the push.
+     */
+    void push(CommandContext &ctx, bool front);
+
+    /**
+     * Pops one element, or as many as the optional count argument asks for, from the head or tail of the key's list.
+     */
+    void pop(CommandContext &ctx, bool front);
+
+    /**
+     * Pops from the first of the keys that holds a list, or blocks the client until a push onto any of them or the
+     * timeout in the last argument.
+     */
+    void blockingPop(CommandContext &ctx, bool front);
+
+    /**
+     * Replies with the rank of a member of the key's sorted set, counted from the lowest score or, if reverse is set,
+     * from the highest, and with its score if WITHSCORE follows.
+     */
+    void rank(CommandContext &ctx, bool reverse);
+
+    /**
+     * Replies with the members of the key's sorted set in a range of ranks or, for ZRANGEBYSCORE and ZRANGE BYSCORE, of
+     * scores, parsing the options that follow the range.
+     */
+    void range(CommandContext &ctx, bool byScore);
+
+    /**
+     * Unsubscribes the client from the channels or patterns in the arguments, or from all in its list if there are
+     * none, and confirms each.
+     */
+    void unsubscribe(CommandContext &ctx, std::string_view kind, const std::vector<std::string> &subscribed,
+                     bool (PubSub::*remove)(Client &, std::string_view));
+
+    /**
+     * Adds delta to the integer stored at the first argument's key and replies with the result.
+     */
+    void incrementBy(CommandContext &ctx, long long delta);
+
+    /**
+     * Collects the key-value pairs of MSET and MSETNX, taking over the buffers of large values and encoding integers.
+     * Replies with an error and returns an empty list if a key has no value.
+     */
+    std::vector<DataStore::KeyValue> collectKeyValues(CommandContext &ctx, std::string_view command);
+    void handleConfig(CommandContext &ctx);
+    void handleHello(CommandContext &ctx);
+    void handleClient(CommandContext &ctx);
+    void handleClientTracking(CommandContext &ctx);
+    void handleCommandInfo(CommandContext &ctx);
+
+    /**
+     * Sends an invalidation message to every client that read the key since it was last invalidated. The writer, if
+     * any, is skipped when it enabled tracking with NOLOOP.
+     */
+    void invalidateKey(std::string_view key, const Client *writer = nullptr);
+
+    /**
+     * Sends every tracking client an invalidation message with a null key list, which tells it to drop its whole cache.
+     */
+    void invalidateAll(const Client *writer = nullptr);
+
+    /**
+     * Delivers an invalidation message for the key, or for all keys if there is none, to the given RESP3 clients that
+     * still enable tracking.
+     */
+    void sendInvalidation(const std::vector<uint64_t> &clientIds, std::optional<std::string_view> key,
+                          const Client *writer);
 
     DataStore dataStore;
     std::optional<WriteAheadLogPersister> persister;
+    ClientRegistry clients;
+    TrackingTable tracking;
+    PubSub pubsub;
 };
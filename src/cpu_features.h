@@ -0,0 +1,27 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86 1
+#endif
+
+/**
+ * CPU features the vector kernels need, checked at runtime so one binary runs on any x86 CPU. Modules pick their kernel
+ * once, while the static objects are initialized. Other architectures report no features and use the scalar kernels.
+ */
+namespace CpuFeatures {
+#ifdef CPU_FEATURES_X86
+    // The checks may run during static initialization, before the CPU feature data has been set up.
+    inline bool hasSse2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    }
+
+    inline bool hasAvx2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    inline bool hasSse2() { return false; }
+    inline bool hasAvx2() { return false; }
+#endif
+}// namespace CpuFeatures
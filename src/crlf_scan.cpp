@@ -0,0 +1,80 @@
+#include "crlf_scan.h"
+
+#include <cstring>
+
+#include "cpu_features.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+namespace CrlfScan {
+    size_t scalar(const uint8_t *data, size_t size) {
+        const uint8_t *end = data + size;
+
+        for (const uint8_t *p = data; p < end;) {
+            p = static_cast<const uint8_t *>(std::memchr(p, '\r', end - p));
+            if (p == nullptr || p + 1 == end) { break; }
+            if (p[1] == '\n') { return p - data; }
+            ++p;
+        }
+
+        return std::string::npos;
+    }
+
+#ifdef CPU_FEATURES_X86
+    // Both kernels compare a block with '\r' and the same block shifted by one byte with '\n', so a match marks
+    // the position of a complete "\r\n". The tail that does not fill a block goes to the scalar kernel.
+
+    __attribute__((target("sse2"))) size_t sse2(const uint8_t *data, size_t size) {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        size_t i = 0;
+
+        for (; i + 17 <= size; i += 16) {
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+            auto mask = static_cast<unsigned>(
+                    _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(current, cr), _mm_cmpeq_epi8(next, lf))));
+            if (mask != 0) { return i + __builtin_ctz(mask); }
+        }
+
+        size_t rest = scalar(data + i, size - i);
+        return rest == std::string::npos ? rest : i + rest;
+    }
+
+    __attribute__((target("avx2"))) size_t avx2(const uint8_t *data, size_t size) {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        size_t i = 0;
+
+        for (; i + 33 <= size; i += 32) {
+            __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 1));
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                    _mm256_and_si256(_mm256_cmpeq_epi8(current, cr), _mm256_cmpeq_epi8(next, lf))));
+            if (mask != 0) { return i + __builtin_ctz(mask); }
+        }
+
+        size_t rest = sse2(data + i, size - i);
+        return rest == std::string::npos ? rest : i + rest;
+    }
+#else
+    size_t sse2(const uint8_t *data, size_t size) { return scalar(data, size); }
+    size_t avx2(const uint8_t *data, size_t size) { return scalar(data, size); }
+#endif
+}// namespace CrlfScan
+
+namespace {
+    using Kernel = size_t (*)(const uint8_t *, size_t);
+
+    Kernel selectKernel() {
+        if (CpuFeatures::hasAvx2()) return CrlfScan::avx2;
+        if (CpuFeatures::hasSse2()) return CrlfScan::sse2;
+        return CrlfScan::scalar;
+    }
+
+    const Kernel kernel = selectKernel();
+}// namespace
+
+size_t findCrlf(std::span<const uint8_t> buffer) { return kernel(buffer.data(), buffer.size()); }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+/**
+ * Returns the offset of the first "\r\n" in buffer, or std::string::npos if there is none.
+ *
+ * Scans 32 or 16 bytes per step with AVX2 or SSE2 when available, the kernel is picked once based on the CPU the
+ * server runs on. Only parseMessage's decoder scans with it: the request parser decodes its short length headers in
+ * one scalar pass, where the vector kernels would not get past their first block.
+ */
+size_t findCrlf(std::span<const uint8_t> buffer);
+
+// The individual kernels, exposed for testing. Only call a vector kernel if CpuFeatures has its feature.
+namespace CrlfScan {
+    size_t scalar(const uint8_t *data, size_t size);
+    size_t sse2(const uint8_t *data, size_t size);
+    size_t avx2(const uint8_t *data, size_t size);
+}// namespace CrlfScan
@@ -1,70 +1,1246 @@
 #include "datastore.h"
 
-std::optional<std::string> DataStore::get(const std::string &key) {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (store.find(key) == store.end()) return {};
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
 
-    auto now = std::chrono::system_clock::now();
-    auto entry = store[key];
+namespace {
+    // Longest canonical 64-bit integer: "-9223372036854775808".
+    constexpr size_t MAX_INTEGER_LENGTH = 20;
+
+    // Fits every long double printed with %.17Lf, same as Redis' MAX_LONG_DOUBLE_CHARS.
+    constexpr size_t MAX_LONG_DOUBLE_CHARS = 5 * 1024;
+
+    // Formats an integer value into digits, which must hold MAX_INTEGER_LENGTH characters.
+    std::string_view formatInteger(long long value, char *digits) {
+        return {digits, static_cast<size_t>(std::to_chars(digits, digits + MAX_INTEGER_LENGTH, value).ptr - digits)};
+    }
+
+    // The bytes of a value, formatted into digits if it is an integer.
+    std::string_view valueBytes(const Value &value, char *digits) {
+        if (const auto *number = std::get_if<long long>(&value)) { return formatInteger(*number, digits); }
+        return *std::get<std::shared_ptr<const std::string>>(value);
+    }
+
+    /**
+     * Returns the string of a value for modifying it in place, converting an integer to a string and copying a string
+     * that a reader still holds. A copy reserves length bytes, the length the caller is about to grow it to.
+     */
+    std::string &mutableString(Value &value, size_t length) {
+        if (const auto *number = std::get_if<long long>(&value)) {
+            char digits[MAX_INTEGER_LENGTH];
+            auto formatted = std::make_shared<std::string>();
+            formatted->reserve(length);
+            formatted->append(formatInteger(*number, digits));
+            value = std::move(formatted);
+        }
+
+        auto &stored = std::get<std::shared_ptr<const std::string>>(value);
+
+        // Only the store hands out references, and it holds mtx, so a count of 1 cannot go up under us.
+        if (stored.use_count() > 1) {
+            auto copy = std::make_shared<std::string>();
+            copy->reserve(length);
+            copy->append(*stored);
+            stored = std::move(copy);
+        } else {
+            // use_count() is a relaxed load. A reader on another thread, e.g. a network loop sending the bytes, drops
+            // its reference with a release decrement after its last read. The fence pairs with that decrement, so
+            // those reads happen before the writes below instead of racing with them.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+
+        // Stored strings are never created const, see Value.
+        return const_cast<std::string &>(*stored);
+    }
+
+    // The HyperLogLog a value holds, NotAHyperLogLog if it is a string that is not one.
+    std::expected<std::string_view, StoreError> hyperLogLogBytes(const Value &value) {
+        if (!isString(value)) { return std::unexpected(StoreError::WrongType); }
+
+        const auto *stored = std::get_if<std::shared_ptr<const std::string>>(&value);
+        if (!stored || !HyperLogLog::isValid(**stored)) { return std::unexpected(StoreError::NotAHyperLogLog); }
+        return **stored;
+    }
+
+    // Whether destroying the value frees a large allocation, rather than dropping a reference a reader still holds.
+    bool isLargeValue(const Value &value) {
+        if (const auto *set = std::get_if<std::shared_ptr<Set>>(&value)) {
+            return (*set)->bytes() >= DataStore::LAZY_FREE_THRESHOLD && set->use_count() == 1;
+        }
+
+        if (const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&value)) {
+            return (*set)->bytes() >= DataStore::LAZY_FREE_THRESHOLD && set->use_count() == 1;
+        }
+
+        if (const auto *hash = std::get_if<std::shared_ptr<Hash>>(&value)) {
+            return (*hash)->bytes() >= DataStore::LAZY_FREE_THRESHOLD && hash->use_count() == 1;
+        }
+
+        if (const auto *list = std::get_if<std::shared_ptr<QuickList>>(&value)) {
+            return (*list)->bytes() >= DataStore::LAZY_FREE_THRESHOLD && list->use_count() == 1;
+        }
+
+        const auto *str = std::get_if<std::shared_ptr<const std::string>>(&value);
+        return str && (*str)->size() >= DataStore::LAZY_FREE_THRESHOLD && str->use_count() == 1;
+    }
+
+    std::optional<long long> asInteger(const Value &value) {
+        if (const auto *number = std::get_if<long long>(&value)) { return *number; }
+        return parseCanonicalInteger(*std::get<std::shared_ptr<const std::string>>(value));
+    }
+
+    // Formats like Redis' INCRBYFLOAT: fixed point with trailing zeros removed, e.g. "10.5" or "3".
+    std::string formatLongDouble(long double value) {
+        char buffer[MAX_LONG_DOUBLE_CHARS];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.17Lf", value);
+        std::string_view formatted(buffer, std::clamp(length, 0, static_cast<int>(sizeof(buffer)) - 1));
+
+        if (formatted.find('.') != std::string_view::npos) {
+            formatted.remove_suffix(formatted.size() - formatted.find_last_not_of('0') - 1);
+            if (formatted.ends_with('.')) { formatted.remove_suffix(1); }
+        }
+
+        if (formatted == "-0") { return "0"; }
+        return std::string(formatted);
+    }
+}// namespace
+
+std::optional<long long> parseCanonicalInteger(std::string_view str) {
+    if (str.empty() || str.size() > MAX_INTEGER_LENGTH) { return std::nullopt; }
+
+    // Leading zeros and "-0" would not survive a round trip through the integer.
+    bool negative = str[0] == '-';
+    if (str.size() > static_cast<size_t>(negative) + 1 && str[negative] == '0') { return std::nullopt; }
+    if (str == "-0") { return std::nullopt; }
+
+    long long value;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end != str.data() + str.size()) { return std::nullopt; }
+    return value;
+}
+
+std::optional<long double> parseLongDouble(std::string_view str) {
+    long double value;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end != str.data() + str.size() || !std::isfinite(value)) { return std::nullopt; }
+    return value;
+}
+
+Value encodeValue(std::string_view bytes) {
+    if (auto number = parseCanonicalInteger(bytes)) { return *number; }
+    return std::make_shared<std::string>(bytes);
+}
+
+Value encodeValue(std::shared_ptr<std::string> bytes) {
+    if (auto number = parseCanonicalInteger(*bytes)) { return *number; }
+    return bytes;
+}
+
+std::optional<std::string> DataStore::get(std::string_view key) {
+    auto value = getRef(key);
+    if (!value) return {};
+
+    return *value;
+}
+
+std::shared_ptr<const std::string> DataStore::getRef(std::string_view key) {
+    auto value = getValue(key);
+    if (!value || !isString(*value)) { return nullptr; }
+
+    if (const auto *number = std::get_if<long long>(&*value)) {
+        return std::make_shared<const std::string>(std::to_string(*number));
+    }
+    return std::get<std::shared_ptr<const std::string>>(*value);
+}
+
+std::optional<Value> DataStore::getValue(std::string_view key) {
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        auto it = store.find(key);
+        if (it == store.end()) return std::nullopt;
 
-    if (entry.expiry && entry.expiry < now) {
-        store.erase(key);
-        return {};
+        auto now = std::chrono::system_clock::now();
+
+        if (!isExpired(it->second, now)) { return it->second.value; }
+
+        erase(it);
     }
 
-    return entry.value;
+    if (expiryListener) { expiryListener(key); }
+    return std::nullopt;
 }
 
-void DataStore::set(const std::string &key, const std::string &val) {
-    std::lock_guard<std::mutex> lock(mtx);
-    store[key] = {val};
+void DataStore::set(std::string_view key, std::string_view val) { set(key, encodeValue(val)); }
+
+void DataStore::setWithExpiry(std::string_view key, std::string_view val,
+                              std::chrono::time_point<std::chrono::system_clock> expiry) {
+    setWithExpiry(key, encodeValue(val), expiry);
 }
 
-void DataStore::setWithExpiry(const std::string &key, const std::string &val,
+void DataStore::set(std::string_view key, Value value) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    assign(prehashed, {std::move(value), std::nullopt});
+}
+
+void DataStore::setWithExpiry(std::string_view key, Value value,
                               std::chrono::time_point<std::chrono::system_clock> expiry) {
-    std::lock_guard<std::mutex> lock(mtx);
-    store[key] = {val, expiry};
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    assign(prehashed, {std::move(value), expiry});
 }
 
-bool DataStore::exists(const std::string &key) {
-    std::lock_guard<std::mutex> lock(mtx);
+bool DataStore::exists(std::string_view key) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
     return store.contains(key);
 }
 
 int DataStore::count() {
-    std::lock_guard<std::mutex> lock(mtx);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
     return store.size();
 }
 
-int DataStore::removeExpiredKeys() {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto keys = getRandomKeys(20);
-    auto numKeys = keys.size();
+std::vector<std::optional<Value>> DataStore::getValues(std::span<const std::string_view> keys) {
+    // Hash every key before taking the lock, the critical section only walks the buckets.
+    std::vector<PrehashedKey> prehashed(keys.begin(), keys.end());
+    std::vector<std::optional<Value>> values(keys.size());
+    std::vector<std::string_view> expired;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        auto now = std::chrono::system_clock::now();
+
+        for (size_t i = 0; i < prehashed.size(); ++i) {
+            auto it = store.find(prehashed[i]);
+            if (it == store.end()) { continue; }
+
+            if (isExpired(it->second, now)) {
+                erase(it);
+                expired.push_back(keys[i]);
+                continue;
+            }
+
+            values[i] = it->second.value;
+        }
+    }
+
+    if (expiryListener) {
+        for (auto key: expired) { expiryListener(key); }
+    }
+
+    return values;
+}
+
+void DataStore::setMany(std::span<KeyValue> entries) {
+    std::vector<PrehashedKey> prehashed;
+    prehashed.reserve(entries.size());
+    for (const auto &[key, value]: entries) { prehashed.emplace_back(key); }
+
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    for (size_t i = 0; i < entries.size(); ++i) { assign(prehashed[i], {std::move(entries[i].second), std::nullopt}); }
+}
+
+bool DataStore::setManyIfAbsent(std::span<KeyValue> entries) {
+    std::vector<PrehashedKey> prehashed;
+    prehashed.reserve(entries.size());
+    for (const auto &[key, value]: entries) { prehashed.emplace_back(key); }
+
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    // Expired keys count as absent, they are overwritten below.
+    bool anyExists = std::any_of(prehashed.begin(), prehashed.end(), [&](const PrehashedKey &key) {
+        auto it = store.find(key);
+        return it != store.end() && !isExpired(it->second, now);
+    });
+    if (anyExists) { return false; }
+
+    for (size_t i = 0; i < entries.size(); ++i) { assign(prehashed[i], {std::move(entries[i].second), std::nullopt}); }
+    return true;
+}
+
+std::expected<long long, StoreError> DataStore::incrementBy(std::string_view key, long long delta) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+
+    if (entry && !isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    long long current = 0;
+    if (entry) {
+        auto number = asInteger(entry->value);
+        if (!number) { return std::unexpected(StoreError::NotAnInteger); }
+        current = *number;
+    }
+
+    long long result;
+    if (__builtin_add_overflow(current, delta, &result)) { return std::unexpected(StoreError::Overflow); }
+
+    // An existing counter is updated in place, without allocating.
+    if (entry) {
+        entry->value = result;
+        touch(*entry);
+    } else {
+        assign(prehashed, {result, std::nullopt});
+    }
+
+    return result;
+}
+
+std::expected<std::string, StoreError> DataStore::incrementByFloat(std::string_view key, long double delta) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+
+    if (entry && !isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    long double current = 0;
+    if (entry) {
+        if (const auto *number = std::get_if<long long>(&entry->value)) {
+            current = static_cast<long double>(*number);
+        } else {
+            auto parsed = parseLongDouble(*std::get<std::shared_ptr<const std::string>>(entry->value));
+            if (!parsed) { return std::unexpected(StoreError::NotAFloat); }
+            current = *parsed;
+        }
+    }
+
+    long double result = current + delta;
+    if (!std::isfinite(result)) { return std::unexpected(StoreError::NotFinite); }
+
+    auto formatted = formatLongDouble(result);
+
+    if (entry) {
+        entry->value = encodeValue(formatted);
+        touch(*entry);
+    } else {
+        assign(prehashed, {encodeValue(formatted), std::nullopt});
+    }
+
+    return formatted;
+}
+
+std::expected<size_t, StoreError> DataStore::append(std::string_view key, std::string_view suffix) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (entry && !isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    char digits[MAX_INTEGER_LENGTH];
+    size_t length = entry ? valueBytes(entry->value, digits).size() : 0;
+
+    if (suffix.size() > maxStringLength - length) { return std::unexpected(StoreError::TooLarge); }
+
+    if (!entry) {
+        assign(prehashed, {std::make_shared<std::string>(suffix), std::nullopt});
+        return suffix.size();
+    }
+
+    // std::string grows geometrically, so a value built by repeated appends is reallocated only O(log n) times.
+    auto &str = mutableString(entry->value, length + suffix.size());
+    str.append(suffix);
+    touch(*entry);
+    return str.size();
+}
+
+std::expected<size_t, StoreError> DataStore::setRange(std::string_view key, size_t offset, std::string_view bytes) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (entry && !isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    char digits[MAX_INTEGER_LENGTH];
+    size_t length = entry ? valueBytes(entry->value, digits).size() : 0;
+
+    if (bytes.empty()) { return length; }
+    if (offset > maxStringLength || bytes.size() > maxStringLength - offset) {
+        return std::unexpected(StoreError::TooLarge);
+    }
+
+    if (!entry) {
+        auto str = std::make_shared<std::string>(offset + bytes.size(), '\0');
+        std::copy(bytes.begin(), bytes.end(), str->begin() + static_cast<std::ptrdiff_t>(offset));
+        assign(prehashed, {std::move(str), std::nullopt});
+        return offset + bytes.size();
+    }
+
+    auto &str = mutableString(entry->value, std::max(length, offset + bytes.size()));
+    if (str.size() < offset + bytes.size()) { str.resize(offset + bytes.size()); }
+    std::copy(bytes.begin(), bytes.end(), str.begin() + static_cast<std::ptrdiff_t>(offset));
+    touch(*entry);
+    return str.size();
+}
+
+std::expected<std::string, StoreError> DataStore::getRange(std::string_view key, long long start, long long end) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+    if (!isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    char digits[MAX_INTEGER_LENGTH];
+    auto bytes = valueBytes(entry->value, digits);
+    auto length = static_cast<long long>(bytes.size());
+
+    if (start < 0 && end < 0 && start > end) { return {}; }
+    if (start < 0) { start = std::max(length + start, 0LL); }
+    if (end < 0) { end = std::max(length + end, 0LL); }
+    end = std::min(end, length - 1);
+    if (start > end) { return {}; }
+
+    // Only the requested slice is copied out.
+    return std::string(bytes.substr(start, end - start + 1));
+}
+
+std::expected<size_t, StoreError> DataStore::length(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+    if (!isString(entry->value)) { return std::unexpected(StoreError::WrongType); }
+
+    char digits[MAX_INTEGER_LENGTH];
+    return valueBytes(entry->value, digits).size();
+}
+
+std::expected<DataStore::PushResult, StoreError> DataStore::push(std::string_view key,
+                                                                 std::span<const std::string_view> elements,
+                                                                 bool front) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    auto *entry = findLive(prehashed, now);
+    if (entry && !std::holds_alternative<std::shared_ptr<QuickList>>(entry->value)) {
+        return std::unexpected(StoreError::WrongType);
+    }
+
+    if (!entry) {
+        assign(prehashed, {std::make_shared<QuickList>(), std::nullopt});
+        entry = findLive(prehashed, now);
+    }
+
+    auto &list = *std::get<std::shared_ptr<QuickList>>(entry->value);
+    for (auto element: elements) {
+        if (front) {
+            list.pushFront(element);
+        } else {
+            list.pushBack(element);
+        }
+    }
+    touch(*entry);
+
+    PushResult result{list.size()};
+    serveBlockedPops(prehashed, result);
+    return result;
+}
+
+std::expected<std::vector<std::string>, StoreError> DataStore::pop(std::string_view key, size_t count, bool front) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *list = std::get_if<std::shared_ptr<QuickList>>(&entry->value);
+    if (!list) { return std::unexpected(StoreError::WrongType); }
+
+    std::vector<std::string> elements;
+    elements.reserve(std::min(count, (*list)->size()));
+    while (elements.size() < count && !(*list)->empty()) {
+        elements.push_back(front ? (*list)->popFront() : (*list)->popBack());
+    }
+
+    // Like in Redis, a list exists only as long as it has elements.
+    if ((*list)->empty()) {
+        erase(store.find(prehashed));
+    } else {
+        touch(*entry);
+    }
+
+    return elements;
+}
+
+std::expected<std::vector<std::string>, StoreError> DataStore::listRange(std::string_view key, long long start,
+                                                                          long long end) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *list = std::get_if<std::shared_ptr<QuickList>>(&entry->value);
+    if (!list) { return std::unexpected(StoreError::WrongType); }
+
+    auto length = static_cast<long long>((*list)->size());
+    if (start < 0) { start = std::max(length + start, 0LL); }
+    if (end < 0) { end = length + end; }
+    end = std::min(end, length - 1);
+    if (start > end) { return {}; }
+
+    return (*list)->range(start, end);
+}
+
+std::expected<size_t, StoreError> DataStore::listLength(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *list = std::get_if<std::shared_ptr<QuickList>>(&entry->value);
+    if (!list) { return std::unexpected(StoreError::WrongType); }
+    return (*list)->size();
+}
+
+std::expected<std::optional<DataStore::KeyElement>, StoreError>
+DataStore::popOrBlock(const std::shared_ptr<BlockedPop> &blocked, bool wait) {
+    std::vector<PrehashedKey> prehashed(blocked->keys.begin(), blocked->keys.end());
+
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    for (const auto &key: prehashed) {
+        auto *entry = findLive(key, now);
+        if (!entry) { continue; }
+
+        const auto *list = std::get_if<std::shared_ptr<QuickList>>(&entry->value);
+        if (!list) { return std::unexpected(StoreError::WrongType); }
+
+        // Lists are never stored empty, see pop().
+        auto element = blocked->front ? (*list)->popFront() : (*list)->popBack();
+        if ((*list)->empty()) {
+            erase(store.find(key));
+        } else {
+            touch(*entry);
+        }
+
+        return KeyElement{std::string(key.key), std::move(element)};
+    }
+
+    if (wait) {
+        for (const auto &key: blocked->keys) { blockedPops[key].push_back(blocked); }
+    }
+
+    return std::nullopt;
+}
+
+bool DataStore::cancelBlockedPop(const std::shared_ptr<BlockedPop> &blocked) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (blocked->done) { return false; }
+
+    blocked->done = true;
+    unregisterBlockedPop(blocked);
+    return true;
+}
+
+std::expected<size_t, StoreError> DataStore::hashSet(std::string_view key, std::span<const FieldValue> fields) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    auto *entry = findLive(prehashed, now);
+    if (entry && !std::holds_alternative<std::shared_ptr<Hash>>(entry->value)) {
+        return std::unexpected(StoreError::WrongType);
+    }
+
+    if (!entry) {
+        assign(prehashed, {std::make_shared<Hash>(), std::nullopt});
+        entry = findLive(prehashed, now);
+    }
+
+    auto &hash = *std::get<std::shared_ptr<Hash>>(entry->value);
+    size_t added = 0;
+    for (auto [field, value]: fields) { added += hash.set(field, value, limits.hash); }
+    touch(*entry);
+
+    return added;
+}
+
+std::expected<std::vector<std::optional<std::string>>, StoreError>
+DataStore::hashGet(std::string_view key, std::span<const std::string_view> fields) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    std::vector<std::optional<std::string>> values(fields.size());
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return values; }
+
+    const auto *hash = std::get_if<std::shared_ptr<Hash>>(&entry->value);
+    if (!hash) { return std::unexpected(StoreError::WrongType); }
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (auto value = (*hash)->get(fields[i])) { values[i].emplace(*value); }
+    }
+
+    return values;
+}
+
+std::expected<std::vector<std::pair<std::string, std::string>>, StoreError>
+DataStore::hashGetAll(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *hash = std::get_if<std::shared_ptr<Hash>>(&entry->value);
+    if (!hash) { return std::unexpected(StoreError::WrongType); }
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    fields.reserve((*hash)->size());
+    (*hash)->forEach([&](std::string_view field, std::string_view value) { fields.emplace_back(field, value); });
+
+    return fields;
+}
+
+std::expected<size_t, StoreError> DataStore::hashRemove(std::string_view key,
+                                                        std::span<const std::string_view> fields) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *hash = std::get_if<std::shared_ptr<Hash>>(&entry->value);
+    if (!hash) { return std::unexpected(StoreError::WrongType); }
+
+    size_t removed = 0;
+    for (auto field: fields) { removed += (*hash)->remove(field); }
+
+    // Like lists, a hash exists only as long as it has fields.
+    if ((*hash)->empty()) {
+        erase(store.find(prehashed));
+    } else if (removed > 0) {
+        touch(*entry);
+    }
+
+    return removed;
+}
+
+std::expected<long long, StoreError> DataStore::hashIncrementBy(std::string_view key, std::string_view field,
+                                                                long long delta) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    auto *entry = findLive(prehashed, now);
+    if (entry && !std::holds_alternative<std::shared_ptr<Hash>>(entry->value)) {
+        return std::unexpected(StoreError::WrongType);
+    }
+
+    long long current = 0;
+    if (entry) {
+        if (auto value = std::get<std::shared_ptr<Hash>>(entry->value)->get(field)) {
+            auto number = parseCanonicalInteger(*value);
+            if (!number) { return std::unexpected(StoreError::NotAnInteger); }
+            current = *number;
+        }
+    }
+
+    long long result;
+    if (__builtin_add_overflow(current, delta, &result)) { return std::unexpected(StoreError::Overflow); }
+
+    if (!entry) {
+        assign(prehashed, {std::make_shared<Hash>(), std::nullopt});
+        entry = findLive(prehashed, now);
+    }
+
+    std::get<std::shared_ptr<Hash>>(entry->value)->set(field, std::to_string(result), limits.hash);
+    touch(*entry);
+
+    return result;
+}
+
+std::expected<size_t, StoreError> DataStore::setAdd(std::string_view key, std::span<const std::string_view> members) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
     auto now = std::chrono::system_clock::now();
 
-    int deleted = 0;
+    auto *entry = findLive(prehashed, now);
+    if (entry && !std::holds_alternative<std::shared_ptr<Set>>(entry->value)) {
+        return std::unexpected(StoreError::WrongType);
+    }
+
+    if (!entry) {
+        assign(prehashed, {std::make_shared<Set>(), std::nullopt});
+        entry = findLive(prehashed, now);
+    }
+
+    auto &set = *std::get<std::shared_ptr<Set>>(entry->value);
+    size_t added = 0;
+    for (auto member: members) { added += set.add(member, limits.maxIntsetEntries); }
+    if (added > 0) { touch(*entry); }
+
+    return added;
+}
+
+std::expected<size_t, StoreError> DataStore::setRemove(std::string_view key,
+                                                       std::span<const std::string_view> members) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *set = std::get_if<std::shared_ptr<Set>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+
+    size_t removed = 0;
+    for (auto member: members) { removed += (*set)->remove(member); }
+
+    if ((*set)->empty()) {
+        erase(store.find(prehashed));
+    } else if (removed > 0) {
+        touch(*entry);
+    }
+
+    return removed;
+}
+
+std::expected<bool, StoreError> DataStore::setContains(std::string_view key, std::string_view member) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return false; }
+
+    const auto *set = std::get_if<std::shared_ptr<Set>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->contains(member);
+}
+
+std::expected<std::vector<std::string>, StoreError> DataStore::setMembers(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *set = std::get_if<std::shared_ptr<Set>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->members();
+}
+
+std::expected<size_t, StoreError> DataStore::setLength(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *set = std::get_if<std::shared_ptr<Set>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->size();
+}
+
+std::expected<std::vector<std::string>, StoreError>
+DataStore::setIntersection(std::span<const std::string_view> keys) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto sets = findSets(keys);
+    if (!sets) { return std::unexpected(sets.error()); }
+
+    // A missing key is an empty set, which empties the intersection.
+    if (std::find(sets->begin(), sets->end(), nullptr) != sets->end()) { return {}; }
+    return Set::intersection(std::move(*sets), setWorkers);
+}
+
+std::expected<std::vector<std::string>, StoreError> DataStore::setUnion(std::span<const std::string_view> keys) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto sets = findSets(keys);
+    if (!sets) { return std::unexpected(sets.error()); }
+
+    std::erase(*sets, nullptr);
+    return Set::unionOf(*sets);
+}
+
+std::expected<std::vector<std::string>, StoreError>
+DataStore::setDifference(std::span<const std::string_view> keys) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto sets = findSets(keys);
+    if (!sets) { return std::unexpected(sets.error()); }
+
+    const auto *first = sets->front();
+    if (!first) { return {}; }
 
-    for (const auto &key: keys) {
-        auto entry = store[key];
-        if (entry.expiry && entry.expiry < now) {
-            store.erase(key);
-            ++deleted;
+    std::vector<const Set *> others(sets->begin() + 1, sets->end());
+    std::erase(others, nullptr);
+    return Set::difference(*first, others);
+}
+
+std::expected<DataStore::SortedSetAddResult, StoreError>
+DataStore::sortedSetAdd(std::string_view key, std::span<const ScoreMember> members,
+                        const SortedSetAddOptions &options) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (entry && !std::holds_alternative<std::shared_ptr<SortedSet>>(entry->value)) {
+        return std::unexpected(StoreError::WrongType);
+    }
+
+    // A new set is only stored once a member is added to it.
+    auto set = entry ? std::get<std::shared_ptr<SortedSet>>(entry->value) : std::make_shared<SortedSet>();
+
+    SortedSetAddResult result;
+    for (auto [score, member]: members) {
+        result.score.reset();
+        auto current = set->score(member);
+
+        if (!current) {
+            if (options.onlyExisting) { continue; }
+
+            set->set(member, score, limits.sortedSet);
+            ++result.added;
+            result.score = score;
+            continue;
+        }
+
+        if (options.onlyNew) { continue; }
+
+        double updated = options.increment ? *current + score : score;
+        if (std::isnan(updated)) { return std::unexpected(StoreError::NotANumber); }
+        if ((options.onlyGreater && updated <= *current) || (options.onlyLess && updated >= *current)) { continue; }
+
+        if (updated != *current) {
+            set->set(member, updated, limits.sortedSet);
+            ++result.updated;
         }
-        if (static_cast<float>(deleted) >= 0.25f * static_cast<float>(numKeys)) break;
+        result.score = updated;
+    }
+
+    if (result.added == 0 && result.updated == 0) { return result; }
+
+    if (entry) {
+        touch(*entry);
+    } else {
+        assign(prehashed, {std::move(set), std::nullopt});
     }
 
-    return deleted;
+    return result;
+}
+
+std::expected<std::optional<double>, StoreError> DataStore::sortedSetScore(std::string_view key,
+                                                                            std::string_view member) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return std::nullopt; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->score(member);
+}
+
+std::expected<std::optional<std::pair<size_t, double>>, StoreError>
+DataStore::sortedSetRank(std::string_view key, std::string_view member, bool reverse) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return std::nullopt; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+
+    auto rank = (*set)->rank(member, reverse);
+    if (!rank) { return std::nullopt; }
+    return std::pair{*rank, *(*set)->score(member)};
+}
+
+std::expected<std::vector<SortedSet::Entry>, StoreError>
+DataStore::sortedSetRange(std::string_view key, long long start, long long end, bool reverse) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+
+    auto length = static_cast<long long>((*set)->size());
+    if (start < 0) { start = std::max(length + start, 0LL); }
+    if (end < 0) { end = length + end; }
+    end = std::min(end, length - 1);
+    if (start > end) { return {}; }
+
+    return (*set)->range(start, end, reverse);
+}
+
+std::expected<std::vector<SortedSet::Entry>, StoreError>
+DataStore::sortedSetRangeByScore(std::string_view key, const ScoreRange &range, bool reverse, size_t offset,
+                                 size_t count) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return {}; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->rangeByScore(range, reverse, offset, count);
+}
+
+std::expected<size_t, StoreError> DataStore::sortedSetRemove(std::string_view key,
+                                                             std::span<const std::string_view> members) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+
+    size_t removed = 0;
+    for (auto member: members) { removed += (*set)->remove(member); }
+
+    if ((*set)->empty()) {
+        erase(store.find(prehashed));
+    } else if (removed > 0) {
+        touch(*entry);
+    }
+
+    return removed;
+}
+
+std::expected<size_t, StoreError> DataStore::sortedSetLength(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    const auto *entry = findUnexpired(prehashed, std::chrono::system_clock::now());
+    if (!entry) { return 0; }
+
+    const auto *set = std::get_if<std::shared_ptr<SortedSet>>(&entry->value);
+    if (!set) { return std::unexpected(StoreError::WrongType); }
+    return (*set)->size();
+}
+
+std::expected<bool, StoreError> DataStore::hyperLogLogAdd(std::string_view key,
+                                                          std::span<const std::string_view> elements) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto *entry = findLive(prehashed, std::chrono::system_clock::now());
+    if (!entry) {
+        auto hll = std::make_shared<std::string>(HyperLogLog::create());
+        for (auto element: elements) { HyperLogLog::add(*hll, element, limits.hyperLogLogSparseMaxBytes); }
+
+        assign(prehashed, {std::move(hll), std::nullopt});
+        return true;
+    }
+
+    auto bytes = hyperLogLogBytes(entry->value);
+    if (!bytes) { return std::unexpected(bytes.error()); }
+
+    auto &hll = mutableString(entry->value, bytes->size());
+    bool changed = false;
+    for (auto element: elements) { changed |= HyperLogLog::add(hll, element, limits.hyperLogLogSparseMaxBytes); }
+    if (changed) { touch(*entry); }
+
+    return changed;
+}
+
+std::expected<uint64_t, StoreError> DataStore::hyperLogLogCount(std::span<const std::string_view> keys) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    HyperLogLog::Registers registers{};
+    if (keys.size() == 1) {
+        // Found like findUnexpired() does, but writable for caching the count.
+        auto it = store.find(PrehashedKey(keys.front()));
+        if (it == store.end() || isExpired(it->second, now)) { return 0; }
+
+        auto &entry = it->second;
+        auto bytes = hyperLogLogBytes(entry.value);
+        if (!bytes) { return std::unexpected(bytes.error()); }
+        if (auto cached = HyperLogLog::cachedCount(*bytes)) { return *cached; }
+
+        HyperLogLog::mergeInto(registers, *bytes);
+        auto count = HyperLogLog::estimate(registers);
+
+        // Not touched: the elements did not change, so neither WATCH nor the log need to see it.
+        HyperLogLog::cacheCount(mutableString(entry.value, bytes->size()), count);
+        return count;
+    }
+
+    // The registers of all keys are merged into one set, which is then counted, same as counting their union.
+    for (auto key: keys) {
+        const auto *entry = findUnexpired(PrehashedKey(key), now);
+        if (!entry) { continue; }
+
+        auto bytes = hyperLogLogBytes(entry->value);
+        if (!bytes) { return std::unexpected(bytes.error()); }
+        HyperLogLog::mergeInto(registers, *bytes);
+    }
+
+    return HyperLogLog::estimate(registers);
+}
+
+std::expected<void, StoreError> DataStore::hyperLogLogMerge(std::string_view destination,
+                                                            std::span<const std::string_view> sources) {
+    PrehashedKey prehashed(destination);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+
+    HyperLogLog::Registers registers{};
+    auto *entry = findLive(prehashed, now);
+    if (entry) {
+        auto bytes = hyperLogLogBytes(entry->value);
+        if (!bytes) { return std::unexpected(bytes.error()); }
+        HyperLogLog::mergeInto(registers, *bytes);
+    }
+
+    for (auto source: sources) {
+        const auto *sourceEntry = findUnexpired(PrehashedKey(source), now);
+        if (!sourceEntry) { continue; }
+
+        auto bytes = hyperLogLogBytes(sourceEntry->value);
+        if (!bytes) { return std::unexpected(bytes.error()); }
+        HyperLogLog::mergeInto(registers, *bytes);
+    }
+
+    auto merged = std::make_shared<std::string>(
+            HyperLogLog::fromRegisters(registers, limits.hyperLogLogSparseMaxBytes));
+
+    // Replaced in place, so destination keeps its expiry.
+    if (entry) {
+        entry->value = std::move(merged);
+        touch(*entry);
+    } else {
+        assign(prehashed, {std::move(merged), std::nullopt});
+    }
+    return {};
+}
+
+size_t DataStore::remove(std::span<const std::string_view> keys, bool lazy) {
+    std::vector<PrehashedKey> prehashed(keys.begin(), keys.end());
+
+    // Extracted under the lock, destroyed after it is released.
+    std::vector<Store::node_type> removed;
+    std::vector<std::string_view> expired;
+    bool large = false;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        auto now = std::chrono::system_clock::now();
+
+        for (size_t i = 0; i < prehashed.size(); ++i) {
+            auto it = store.find(prehashed[i]);
+            if (it == store.end()) { continue; }
+
+            if (isExpired(it->second, now)) { expired.push_back(keys[i]); }
+            large = large || isLargeValue(it->second.value);
+            markRemoved(it->first);
+            removed.push_back(store.extract(it));
+        }
+    }
+
+    if (expiryListener) {
+        for (auto key: expired) { expiryListener(key); }
+    }
+
+    size_t count = removed.size() - expired.size();
+    if (lazy && large) { lazyFreer.free(std::move(removed)); }
+    return count;
+}
+
+void DataStore::clear(bool lazy) {
+    Store detached;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        for (auto &[key, watched]: watchedKeys) {
+            if (store.contains(key)) { watched.removedVersion = ++lastVersion; }
+        }
+        detached.swap(store);
+    }
+
+    if (lazy) { lazyFreer.free(std::move(detached)); }
+}
+
+uint64_t DataStore::version(std::string_view key) {
+    PrehashedKey prehashed(key);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto it = store.find(prehashed);
+    if (it != store.end()) {
+        const auto &entry = it->second;
+        return isExpired(entry, std::chrono::system_clock::now()) ? entry.version | EXPIRED_VERSION : entry.version;
+    }
+
+    auto watched = watchedKeys.find(prehashed);
+    return watched != watchedKeys.end() ? watched->second.removedVersion : 0;
+}
+
+uint64_t DataStore::watch(std::string_view key) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto it = watchedKeys.find(key);
+    if (it == watchedKeys.end()) { it = watchedKeys.emplace(std::string(key), WatchedKey{}).first; }
+    ++it->second.watchers;
+    return version(key);
+}
+
+void DataStore::unwatch(std::string_view key) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+
+    auto it = watchedKeys.find(key);
+    if (it != watchedKeys.end() && --it->second.watchers == 0) { watchedKeys.erase(it); }
+}
+
+void DataStore::markRemoved(std::string_view key) {
+    if (watchedKeys.empty()) { return; }
+
+    auto it = watchedKeys.find(key);
+    if (it != watchedKeys.end()) { it->second.removedVersion = ++lastVersion; }
+}
+
+int DataStore::removeExpiredKeys() {
+    std::vector<std::string> expired;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        auto keys = getRandomKeys(20);
+        auto numKeys = keys.size();
+        auto now = std::chrono::system_clock::now();
+
+        for (auto &key: keys) {
+            auto entry = store[key];
+            if (entry.expiry && entry.expiry < now) {
+                markRemoved(key);
+                store.erase(key);
+                expired.push_back(std::move(key));
+            }
+            if (static_cast<float>(expired.size()) >= 0.25f * static_cast<float>(numKeys)) break;
+        }
+    }
+
+    if (expiryListener) {
+        for (const auto &key: expired) { expiryListener(key); }
+    }
+
+    return static_cast<int>(expired.size());
 }
 
 void DataStore::startExpiryDaemon() {
-    auto backgroundThread = [this]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            removeExpiredKeys();
+    expiryDaemon = std::jthread([this](std::stop_token stop) {
+        std::unique_lock lock(expiryDaemonMtx);
+        auto stopped = [&stop] { return stop.stop_requested(); };
+        while (!expiryDaemonWake.wait_for(lock, stop, std::chrono::milliseconds(100), stopped)) { removeExpiredKeys(); }
+    });
+}
+
+void DataStore::stopExpiryDaemon() {
+    if (!expiryDaemon.joinable()) { return; }
+
+    expiryDaemon.request_stop();
+    expiryDaemon.join();
+}
+
+void DataStore::setExpiryListener(std::function<void(std::string_view key)> listener) {
+    expiryListener = std::move(listener);
+}
+
+void DataStore::assign(const PrehashedKey &key, Entry entry) {
+    touch(entry);
+
+    // Overwriting an existing key reuses its node, only new keys are copied into a std::string.
+    auto it = store.find(key);
+    if (it != store.end()) {
+        it->second = std::move(entry);
+    } else {
+        store.emplace(std::string(key.key), std::move(entry));
+    }
+}
+
+Entry *DataStore::findLive(const PrehashedKey &key, std::chrono::time_point<std::chrono::system_clock> now) {
+    auto it = store.find(key);
+    if (it == store.end()) { return nullptr; }
+
+    if (isExpired(it->second, now)) {
+        erase(it);
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+const Entry *DataStore::findUnexpired(const PrehashedKey &key,
+                                      std::chrono::time_point<std::chrono::system_clock> now) const {
+    auto it = store.find(key);
+    if (it == store.end() || isExpired(it->second, now)) { return nullptr; }
+    return &it->second;
+}
+
+void DataStore::serveBlockedPops(const PrehashedKey &key, PushResult &result) {
+    auto it = store.find(key);
+    auto &list = *std::get<std::shared_ptr<QuickList>>(it->second.value);
+
+    for (auto waiting = blockedPops.find(key); waiting != blockedPops.end(); waiting = blockedPops.find(key)) {
+        // Copied, as unregistering drops the reference held by the waiters.
+        auto blocked = waiting->second.front();
+        unregisterBlockedPop(blocked);
+        blocked->done = true;
+
+        if (blocked->front) {
+            blocked->serve(key.key, list.popFront());
+            ++result.servedFront;
+        } else {
+            blocked->serve(key.key, list.popBack());
+            ++result.servedBack;
         }
-    };
 
-    std::thread(backgroundThread).detach();
+        if (list.empty()) {
+            erase(it);
+            return;
+        }
+    }
+}
+
+std::expected<std::vector<const Set *>, StoreError>
+DataStore::findSets(std::span<const std::string_view> keys) {
+    auto now = std::chrono::system_clock::now();
+
+    std::vector<const Set *> sets;
+    sets.reserve(keys.size());
+    for (auto key: keys) {
+        const auto *entry = findUnexpired(PrehashedKey(key), now);
+        if (!entry) {
+            sets.push_back(nullptr);
+            continue;
+        }
+
+        const auto *set = std::get_if<std::shared_ptr<Set>>(&entry->value);
+        if (!set) { return std::unexpected(StoreError::WrongType); }
+        sets.push_back(set->get());
+    }
+
+    return sets;
+}
+
+void DataStore::unregisterBlockedPop(const std::shared_ptr<BlockedPop> &blocked) {
+    for (const auto &key: blocked->keys) {
+        auto it = blockedPops.find(key);
+        if (it == blockedPops.end()) { continue; }
+
+        std::erase(it->second, blocked);
+        if (it->second.empty()) { blockedPops.erase(it); }
+    }
 }
 
 std::vector<std::string> DataStore::getRandomKeys(int n) {
@@ -2,28 +2,484 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <expected>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <random>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
+#include "hash.h"
+#include "hyperloglog.h"
+#include "lazy_freer.h"
+#include "quicklist.h"
+#include "set.h"
+#include "sorted_set.h"
+#include "string_view_hash.h"
+#include "worker_pool.h"
+
+/**
+ * A stored value: a string, a list, a hash, a set or a sorted set.
+ *
+ * Strings that are the canonical form of a 64-bit integer are kept as that integer, so counters take no heap memory of
+ * their own and are updated without parsing and formatting. Other strings are shared, so readers can hand the stored
+ * bytes to the network layer without copying them. They are only ever created non-const by encodeValue(), which lets
+ * the store modify one in place once no reader holds it anymore.
+ *
+ * Lists, hashes, sets and sorted sets are only read and written by the store, under its lock.
+ */
+using Value = std::variant<std::shared_ptr<const std::string>, long long, std::shared_ptr<QuickList>,
+                           std::shared_ptr<Hash>, std::shared_ptr<Set>, std::shared_ptr<SortedSet>>;
+
+/**
+ * @return Whether the value is a string, in either encoding.
+ */
+inline bool isString(const Value &value) {
+    return std::holds_alternative<std::shared_ptr<const std::string>>(value) ||
+           std::holds_alternative<long long>(value);
+}
+
+/**
+ * Encodes bytes as a Value, as an integer if possible.
+ */
+Value encodeValue(std::string_view bytes);
+
+/**
+ * Encodes bytes already held in a buffer of their own, which becomes the stored value unless it holds an integer.
+ */
+Value encodeValue(std::shared_ptr<std::string> bytes);
+
+/**
+ * Parses the canonical form of a 64-bit integer: no sign other than a leading '-', no leading zeros, no "-0".
+ */
+std::optional<long long> parseCanonicalInteger(std::string_view str);
+
+/**
+ * Parses a finite floating point number, without surrounding spaces.
+ */
+std::optional<long double> parseLongDouble(std::string_view str);
+
+// Limits of the packed encodings, per type.
+struct EncodingLimits {
+    ListpackLimits hash;
+    ListpackLimits sortedSet;
+
+    // Most members a set of integers keeps in its intset encoding.
+    size_t maxIntsetEntries = Set::DEFAULT_MAX_INTSET_ENTRIES;
+
+    // Largest a sparse HyperLogLog grows, header included, before it is converted to dense.
+    size_t hyperLogLogSparseMaxBytes = HyperLogLog::DEFAULT_SPARSE_MAX_BYTES;
+};
+
 struct Entry {
-    std::string value;
+    Value value;
     std::optional<std::chrono::time_point<std::chrono::system_clock>> expiry;
+
+    // Changes with every write to the entry, for WATCH. Assigned by the store, unique across keys.
+    uint64_t version = 0;
+};
+
+// Why an operation on a stored value failed, WrongType if the key holds a value of another type. NotAHyperLogLog if it
+// holds a string that is not a HyperLogLog.
+enum class StoreError {
+    WrongType,
+    NotAnInteger,
+    NotAFloat,
+    Overflow,
+    NotFinite,
+    TooLarge,
+    NotANumber,
+    NotAHyperLogLog,
+};
+
+/**
+ * A client waiting in BLPOP or BRPOP for an element to be pushed onto one of its keys, see DataStore::popOrBlock().
+ */
+struct BlockedPop {
+    std::vector<std::string> keys;
+
+    // Whether the client pops from the head of the list rather than its tail.
+    bool front = true;
+
+    // Called by the push that serves the client, with the store locked, with the key and the element popped for it.
+    std::function<void(std::string_view key, std::string_view element)> serve;
+
+    // Set once the client was served or stopped waiting. Guarded by the store's lock.
+    bool done = false;
 };
 
 class DataStore {
 public:
-    std::optional<std::string> get(const std::string &key);
-    void set(const std::string &key, const std::string &val);
-    void setWithExpiry(const std::string &key, const std::string &val,
+    explicit DataStore(EncodingLimits limits = {}, size_t maxStringLength = DEFAULT_MAX_STRING_LENGTH,
+                       size_t numSetWorkers = 0)
+        : limits(limits), maxStringLength(maxStringLength), setWorkers(numSetWorkers) {}
+
+    std::optional<std::string> get(std::string_view key);
+
+    /**
+     * Returns a reference to the stored value instead of a copy, or nullptr if the key does not exist or does not hold
+     * a string. Integers are formatted into a new string.
+     */
+    std::shared_ptr<const std::string> getRef(std::string_view key);
+
+    /**
+     * Returns the stored value in its encoding, or std::nullopt if the key does not exist.
+     */
+    std::optional<Value> getValue(std::string_view key);
+    void set(std::string_view key, std::string_view val);
+    void setWithExpiry(std::string_view key, std::string_view val,
                        std::chrono::time_point<std::chrono::system_clock> expiry);
-    bool exists(const std::string &key);
+    void set(std::string_view key, Value value);
+    void setWithExpiry(std::string_view key, Value value, std::chrono::time_point<std::chrono::system_clock> expiry);
+    bool exists(std::string_view key);
     int count();
 
+    // A key and the value to store for it, see setMany().
+    using KeyValue = std::pair<std::string_view, Value>;
+
+    /**
+     * Looks up all keys in a single critical section.
+     *
+     * @return The values in the order of keys, std::nullopt for keys that do not exist.
+     */
+    std::vector<std::optional<Value>> getValues(std::span<const std::string_view> keys);
+
+    /**
+     * Stores all values in a single critical section, removing any expiry of the keys. A key listed twice ends up
+     * with its last value.
+     */
+    void setMany(std::span<KeyValue> entries);
+
+    /**
+     * Stores all values if none of the keys exists, atomically.
+     *
+     * @return Whether the values were stored.
+     */
+    bool setManyIfAbsent(std::span<KeyValue> entries);
+
+    /**
+     * Adds delta to the integer stored at key, atomically. A missing key counts as 0, the expiry of an existing key is
+     * kept.
+     *
+     * @return The new value.
+     */
+    std::expected<long long, StoreError> incrementBy(std::string_view key, long long delta);
+
+    /**
+     * Adds delta to the number stored at key, atomically, like incrementBy().
+     *
+     * @return The new value, formatted the way it is stored.
+     */
+    std::expected<std::string, StoreError> incrementByFloat(std::string_view key, long double delta);
+
+    // Default of the longest string append() and setRange() build, same as Redis' default proto-max-bulk-len.
+    static constexpr size_t DEFAULT_MAX_STRING_LENGTH = 512 * 1024 * 1024;
+
+    /**
+     * Appends suffix to the string stored at key, in place unless a reader still holds it. A missing key is created.
+     *
+     * @return The new length of the string, or TooLarge if it would exceed the maximum string length.
+     */
+    std::expected<size_t, StoreError> append(std::string_view key, std::string_view suffix);
+
+    /**
+     * Overwrites the string stored at key from offset on with bytes, padding it with zero bytes up to offset. A missing
+     * key is created unless bytes is empty.
+     *
+     * @return The new length of the string, or TooLarge if it would exceed the maximum string length.
+     */
+    std::expected<size_t, StoreError> setRange(std::string_view key, size_t offset, std::string_view bytes);
+
+    /**
+     * Copies the bytes from start to end inclusive out of the string stored at key. Negative offsets count from the
+     * end, offsets past either end are clamped.
+     *
+     * @return The bytes in range, empty if there are none or the key does not exist.
+     */
+    std::expected<std::string, StoreError> getRange(std::string_view key, long long start, long long end);
+
+    /**
+     * @return The length of the string stored at key, 0 if the key does not exist.
+     */
+    std::expected<size_t, StoreError> length(std::string_view key);
+
+    // Outcome of push(): the length of the list after the push, and how many elements were then popped from its head
+    // and tail for blocked clients.
+    struct PushResult {
+        size_t length;
+        size_t servedFront = 0;
+        size_t servedBack = 0;
+    };
+
+    /**
+     * Pushes the elements one after the other onto the head of the list stored at key, or onto its tail, creating the
+     * list if the key does not exist. Clients blocked on the key are then served from the list in the order they
+     * blocked, in the same critical section.
+     */
+    std::expected<PushResult, StoreError> push(std::string_view key, std::span<const std::string_view> elements,
+                                               bool front);
+
+    /**
+     * Pops up to count elements from the head of the list stored at key, or from its tail. A list left empty is
+     * removed.
+     *
+     * @return The popped elements in the order they were popped, none if the key does not exist.
+     */
+    std::expected<std::vector<std::string>, StoreError> pop(std::string_view key, size_t count, bool front);
+
+    /**
+     * Copies the elements from start to end inclusive out of the list stored at key. Negative indices count from the
+     * end, indices past either end are clamped.
+     */
+    std::expected<std::vector<std::string>, StoreError> listRange(std::string_view key, long long start,
+                                                                   long long end);
+
+    /**
+     * @return The length of the list stored at key, 0 if the key does not exist.
+     */
+    std::expected<size_t, StoreError> listLength(std::string_view key);
+
+    // A key and the element popped from it.
+    using KeyElement = std::pair<std::string, std::string>;
+
+    /**
+     * Pops an element from the first of the blocked pop's keys that holds a list. If none does and wait is set, the
+     * blocked pop is registered on all its keys and served by the next push onto any of them. The check and the
+     * registration run in one critical section, so no push can slip in between.
+     *
+     * @return The key and its popped element, or std::nullopt if none of the keys holds a list.
+     */
+    std::expected<std::optional<KeyElement>, StoreError> popOrBlock(const std::shared_ptr<BlockedPop> &blocked,
+                                                                    bool wait);
+
+    /**
+     * Unregisters a blocked pop that stops waiting.
+     *
+     * @return Whether it was still waiting, false if a push has served it already.
+     */
+    bool cancelBlockedPop(const std::shared_ptr<BlockedPop> &blocked);
+
+    // A field and its value.
+    using FieldValue = std::pair<std::string_view, std::string_view>;
+
+    /**
+     * Sets the fields of the hash stored at key, creating the hash if the key does not exist. A field listed twice
+     * ends up with its last value.
+     *
+     * @return The number of fields that were added rather than updated.
+     */
+    std::expected<size_t, StoreError> hashSet(std::string_view key, std::span<const FieldValue> fields);
+
+    /**
+     * Looks up fields of the hash stored at key in a single critical section.
+     *
+     * @return The values in the order of fields, std::nullopt for fields that do not exist.
+     */
+    std::expected<std::vector<std::optional<std::string>>, StoreError>
+    hashGet(std::string_view key, std::span<const std::string_view> fields);
+
+    /**
+     * @return The fields of the hash stored at key and their values, in no particular order.
+     */
+    std::expected<std::vector<std::pair<std::string, std::string>>, StoreError> hashGetAll(std::string_view key);
+
+    /**
+     * Removes fields from the hash stored at key. A hash left empty is removed.
+     *
+     * @return The number of fields that existed.
+     */
+    std::expected<size_t, StoreError> hashRemove(std::string_view key, std::span<const std::string_view> fields);
+
+    /**
+     * Adds delta to the integer stored in a field of the hash stored at key, atomically. A missing field or key counts
+     * as 0.
+     *
+     * @return The new value.
+     */
+    std::expected<long long, StoreError> hashIncrementBy(std::string_view key, std::string_view field,
+                                                         long long delta);
+
+    /**
+     * Adds members to the set stored at key, creating the set if the key does not exist.
+     *
+     * @return The number of members that were new.
+     */
+    std::expected<size_t, StoreError> setAdd(std::string_view key, std::span<const std::string_view> members);
+
+    /**
+     * Removes members from the set stored at key. A set left empty is removed.
+     *
+     * @return The number of members that existed.
+     */
+    std::expected<size_t, StoreError> setRemove(std::string_view key, std::span<const std::string_view> members);
+
+    std::expected<bool, StoreError> setContains(std::string_view key, std::string_view member);
+
+    /**
+     * @return The members of the set stored at key, in no particular order, none if the key does not exist.
+     */
+    std::expected<std::vector<std::string>, StoreError> setMembers(std::string_view key);
+
+    /**
+     * @return The number of members of the set stored at key, 0 if the key does not exist.
+     */
+    std::expected<size_t, StoreError> setLength(std::string_view key);
+
+    /**
+     * Computes the intersection, union or difference of the sets stored at keys, in a single critical section. Missing
+     * keys count as empty sets, the difference is that of the first set and all others. A large intersection is split
+     * across the set workers, and the store stays locked until they are all done.
+     *
+     * @return The resulting members, in no particular order.
+     */
+    std::expected<std::vector<std::string>, StoreError> setIntersection(std::span<const std::string_view> keys);
+    std::expected<std::vector<std::string>, StoreError> setUnion(std::span<const std::string_view> keys);
+    std::expected<std::vector<std::string>, StoreError> setDifference(std::span<const std::string_view> keys);
+
+    // A score and the member to set it for, see sortedSetAdd().
+    struct ScoreMember {
+        double score;
+        std::string_view member;
+    };
+
+    // Conditions and mode of sortedSetAdd(), ZADD's NX, XX, GT, LT and INCR.
+    struct SortedSetAddOptions {
+        bool onlyNew = false;
+        bool onlyExisting = false;
+        bool onlyGreater = false;
+        bool onlyLess = false;
+
+        // Add the scores to those of the members rather than replacing them.
+        bool increment = false;
+    };
+
+    struct SortedSetAddResult {
+        size_t added = 0;
+        // Existing members whose score changed.
+        size_t updated = 0;
+        // The score of the last member after the update, unset if a condition skipped it.
+        std::optional<double> score;
+    };
+
+    /**
+     * Sets the scores of members of the sorted set stored at key, creating the set if the key does not exist and any
+     * member is added. Members that fail the conditions of the options are skipped.
+     *
+     * @return What changed, or NotANumber if an increment would make a score NaN.
+     */
+    std::expected<SortedSetAddResult, StoreError> sortedSetAdd(std::string_view key,
+                                                               std::span<const ScoreMember> members,
+                                                               const SortedSetAddOptions &options);
+
+    /**
+     * @return The score of the member of the sorted set stored at key, std::nullopt if it or the key does not exist.
+     */
+    std::expected<std::optional<double>, StoreError> sortedSetScore(std::string_view key, std::string_view member);
+
+    /**
+     * @return The zero-based rank of the member of the sorted set stored at key and its score, counted from the lowest
+     * score or, if reverse is set, from the highest. std::nullopt if the member or the key does not exist.
+     */
+    std::expected<std::optional<std::pair<size_t, double>>, StoreError>
+    sortedSetRank(std::string_view key, std::string_view member, bool reverse);
+
+    /**
+     * Copies the members ranked from start to end inclusive, and their scores, out of the sorted set stored at key.
+     * Negative ranks count from the end, ranks past either end are clamped.
+     */
+    std::expected<std::vector<SortedSet::Entry>, StoreError>
+    sortedSetRange(std::string_view key, long long start, long long end, bool reverse);
+
+    /**
+     * Copies up to count members with a score in range, and their scores, out of the sorted set stored at key, after
+     * skipping offset of them.
+     */
+    std::expected<std::vector<SortedSet::Entry>, StoreError>
+    sortedSetRangeByScore(std::string_view key, const ScoreRange &range, bool reverse, size_t offset, size_t count);
+
+    /**
+     * Removes members from the sorted set stored at key. A set left empty is removed.
+     *
+     * @return The number of members that existed.
+     */
+    std::expected<size_t, StoreError> sortedSetRemove(std::string_view key, std::span<const std::string_view> members);
+
+    /**
+     * @return The number of members of the sorted set stored at key, 0 if the key does not exist.
+     */
+    std::expected<size_t, StoreError> sortedSetLength(std::string_view key);
+
+    /**
+     * Adds elements to the HyperLogLog stored at key, a string, see HyperLogLog. A missing key is created, even
+     * without elements.
+     *
+     * @return Whether the key was created or any register changed.
+     */
+    std::expected<bool, StoreError> hyperLogLogAdd(std::string_view key, std::span<const std::string_view> elements);
+
+    /**
+     * Estimates the distinct elements added to the HyperLogLogs stored at keys, as if they were merged. Missing keys
+     * count as empty. The count of a single key is cached in it until a register changes, which does not count as a
+     * write.
+     *
+     * @return The estimated count.
+     */
+    std::expected<uint64_t, StoreError> hyperLogLogCount(std::span<const std::string_view> keys);
+
+    /**
+     * Merges the HyperLogLogs stored at destination, if it exists, and at sources into destination.
+     */
+    std::expected<void, StoreError> hyperLogLogMerge(std::string_view destination,
+                                                     std::span<const std::string_view> sources);
+
+    // Values at least this large are freed on the lazy-free thread, smaller ones cost less to free than to hand over.
+    static constexpr size_t LAZY_FREE_THRESHOLD = 64 * 1024;
+
+    /**
+     * Removes keys in a single critical section. Their entries are destroyed once the lock is released, on the
+     * lazy-free thread if lazy is set and any value is large.
+     *
+     * @return The number of keys that existed.
+     */
+    size_t remove(std::span<const std::string_view> keys, bool lazy);
+
+    /**
+     * Removes all keys. The keyspace is swapped for an empty one under the lock and destroyed after it is released, on
+     * the lazy-free thread if lazy is set.
+     */
+    void clear(bool lazy);
+
+    /**
+     * @return The version of key, which changes with every write to it. A missing key has version 0, unless it is
+     * watched: then it has the version of its latest removal, so removing a key after a WATCH changes its version too.
+     * An expired key that was not removed yet has a version of its own as well.
+     */
+    uint64_t version(std::string_view key);
+
+    /**
+     * Watches key until unwatch() is called for it as many times, see version().
+     *
+     * @return The current version of key.
+     */
+    uint64_t watch(std::string_view key);
+
+    void unwatch(std::string_view key);
+
+    /**
+     * Locks the store for a batch of operations, such as a transaction. No other thread reads or writes the store until
+     * the returned lock is released, and the operations run without handing the lock over in between.
+     */
+    std::unique_lock<std::recursive_mutex> lock() { return std::unique_lock<std::recursive_mutex>(mtx); }
+
     /**
      * Removes expired keys from the data store.
      *
@@ -37,14 +493,124 @@ public:
     int removeExpiredKeys();
 
     /**
-     * Starts a background thread to invoke DataStore::removeExpiredKeys() every 100 milliseconds.
+     * Starts a background thread to invoke DataStore::removeExpiredKeys() every 100 milliseconds, until it is stopped
+     * or the store is destroyed.
      */
     void startExpiryDaemon();
 
+    /**
+     * Stops the expiry daemon and waits for it to exit, so the expiry listener is no longer called.
+     */
+    void stopExpiryDaemon();
+
+    /**
+     * Sets a function called with each key removed because it expired, outside the lock. Must be set before the
+     * expiry daemon starts.
+     */
+    void setExpiryListener(std::function<void(std::string_view key)> listener);
 
 private:
-    std::unordered_map<std::string, Entry> store;
-    std::mutex mtx;
+    // A key hashed ahead of the lookup, so batches spend none of their critical section on hashing.
+    struct PrehashedKey {
+        std::string_view key;
+        size_t hash;
+
+        explicit PrehashedKey(std::string_view key) : key(key), hash(StringViewHash{}(key)) {}
+
+        friend bool operator==(const PrehashedKey &a, std::string_view b) { return a.key == b; }
+    };
+
+    // Also takes a PrehashedKey, so a key hashed once is looked up in several containers.
+    struct KeyHash : StringViewHash {
+        using StringViewHash::operator();
+        size_t operator()(const PrehashedKey &key) const { return key.hash; }
+    };
+
+    using Store = std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>>;
+
+    Store store;
+    EncodingLimits limits;
+
+    // Longest string append() and setRange() build, the server's proto-max-bulk-len.
+    size_t maxStringLength;
+
+    // Threads that help setIntersection() with large sets, on top of the calling thread.
+    WorkerPool setWorkers;
+
+    // Recursive, so a batch holding it through lock() can call the methods that take it themselves.
+    std::recursive_mutex mtx;
+    std::function<void(std::string_view key)> expiryListener;
+
+    // Version of the most recent write, see Entry::version.
+    uint64_t lastVersion = 0;
+
+    // Set on the version of an entry that expired but was not removed yet. Versions never reach it otherwise.
+    static constexpr uint64_t EXPIRED_VERSION = uint64_t{1} << 63;
+
+    // A key that clients watch, with the number of WATCH calls for it and the version its latest removal got.
+    struct WatchedKey {
+        size_t watchers = 0;
+        uint64_t removedVersion = 0;
+    };
+
+    std::unordered_map<std::string, WatchedKey, KeyHash, std::equal_to<>> watchedKeys;
+    LazyFreer lazyFreer;
+
+    // Blocked pops waiting on each key, in the order they blocked.
+    std::unordered_map<std::string, std::deque<std::shared_ptr<BlockedPop>>, KeyHash, std::equal_to<>> blockedPops;
+
+    // Only waited on by the expiry daemon, which stop requests wake up.
+    std::mutex expiryDaemonMtx;
+    std::condition_variable_any expiryDaemonWake;
+
+    // Declared last, so the daemon is stopped and joined before the members it uses are destroyed.
+    std::jthread expiryDaemon;
 
     std::vector<std::string> getRandomKeys(int n);
+
+    static bool isExpired(const Entry &entry, std::chrono::time_point<std::chrono::system_clock> now) {
+        return entry.expiry && entry.expiry < now;
+    }
+
+    // Must be called with mtx held.
+    void assign(const PrehashedKey &key, Entry entry);
+
+    // Marks an entry updated in place as written. Must be called with mtx held.
+    void touch(Entry &entry) { entry.version = ++lastVersion; }
+
+    // Gives a watched key that is about to be removed a new version, see version(). Must be called with mtx held.
+    void markRemoved(std::string_view key);
+
+    // Removes an entry. Every removal goes through here or markRemoved(). Must be called with mtx held.
+    void erase(Store::iterator it) {
+        markRemoved(it->first);
+        store.erase(it);
+    }
+
+    /**
+     * Finds the entry of a key for updating it in place, or nullptr if the key does not exist. An expired entry is
+     * removed. Must be called with mtx held.
+     */
+    Entry *findLive(const PrehashedKey &key, std::chrono::time_point<std::chrono::system_clock> now);
+
+    /**
+     * Finds the entry of a key for reading it, or nullptr if the key does not exist or expired. An expired entry is
+     * left for removeExpiredKeys(), which reports it. Must be called with mtx held.
+     */
+    const Entry *findUnexpired(const PrehashedKey &key, std::chrono::time_point<std::chrono::system_clock> now) const;
+
+    /**
+     * Pops an element for each client blocked on the key, in the order they blocked, while the list stored at it has
+     * any left. An emptied list is removed. Must be called with mtx held.
+     */
+    void serveBlockedPops(const PrehashedKey &key, PushResult &result);
+
+    /**
+     * Finds the sets stored at keys, nullptr for keys that do not exist, or WrongType if any key holds another type.
+     * Must be called with mtx held, the sets are only valid while it is.
+     */
+    std::expected<std::vector<const Set *>, StoreError> findSets(std::span<const std::string_view> keys);
+
+    // Removes a blocked pop from the waiters of all its keys. Must be called with mtx held.
+    void unregisterBlockedPop(const std::shared_ptr<BlockedPop> &blocked);
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "hash.h"
+
+bool Hash::set(std::string_view field, std::string_view value, const ListpackLimits &limits) {
+    if (!table && (field.size() > limits.maxValue || value.size() > limits.maxValue)) {
+        convertToTable();
+    }
+
+    if (!table) {
+        if (auto frame = findPacked(field)) {
+            // Only the value's frame is rewritten, the rest of the buffer shifts if its length changed.
+            auto old = Listpack::frameAt(packed, frame->end());
+            std::string framed;
+            Listpack::append(framed, value);
+            packed.replace(old.offset, old.size, framed);
+            return false;
+        }
+
+        if (packedFields < limits.maxEntries) {
+            Listpack::append(packed, field);
+            Listpack::append(packed, value);
+            ++packedFields;
+            return true;
+        }
+
+        convertToTable();
+    }
+
+    auto it = table->find(field);
+    if (it != table->end()) {
+        tableBytes = tableBytes - it->second.size() + value.size();
+        it->second.assign(value);
+        return false;
+    }
+
+    table->emplace(field, value);
+    tableBytes += field.size() + value.size();
+    return true;
+}
+
+std::optional<std::string_view> Hash::get(std::string_view field) const {
+    if (table) {
+        auto it = table->find(field);
+        if (it == table->end()) { return std::nullopt; }
+        return it->second;
+    }
+
+    auto frame = findPacked(field);
+    if (!frame) { return std::nullopt; }
+    return Listpack::frameAt(packed, frame->end()).element;
+}
+
+bool Hash::remove(std::string_view field) {
+    if (table) {
+        auto it = table->find(field);
+        if (it == table->end()) { return false; }
+
+        tableBytes -= it->first.size() + it->second.size();
+        table->erase(it);
+        return true;
+    }
+
+    auto frame = findPacked(field);
+    if (!frame) { return false; }
+
+    auto value = Listpack::frameAt(packed, frame->end());
+    packed.erase(frame->offset, value.end() - frame->offset);
+    --packedFields;
+    return true;
+}
+
+std::optional<Listpack::Frame> Hash::findPacked(std::string_view field) const {
+    for (size_t offset = 0; offset < packed.size();) {
+        auto frame = Listpack::frameAt(packed, offset);
+        if (frame.element == field) { return frame; }
+
+        // Skip the value.
+        offset = Listpack::frameAt(packed, frame.end()).end();
+    }
+
+    return std::nullopt;
+}
+
+void Hash::convertToTable() {
+    auto converted = std::make_unique<Table>();
+    converted->reserve(packedFields);
+
+    forEach([&](std::string_view field, std::string_view value) {
+        converted->emplace(field, value);
+        tableBytes += field.size() + value.size();
+    });
+
+    table = std::move(converted);
+    packed = std::string();
+    packedFields = 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "listpack.h"
+#include "string_view_hash.h"
+
+/**
+ * A hash of fields to values. A small hash packs its fields and values, alternating, into one contiguous buffer
+ * framed like a listpack, and is searched linearly: a few short fields then cost a single allocation and a few bytes
+ * of framing each. Once it outgrows its ListpackLimits it is converted to a hash table, and stays one.
+ */
+class Hash {
+public:
+    /**
+     * Sets the field to value, converting the hash to a table first if the field would not fit the packed encoding.
+     *
+     * @return Whether the field is new.
+     */
+    bool set(std::string_view field, std::string_view value, const ListpackLimits &limits);
+
+    /**
+     * @return The value of the field, viewing the hash's storage until its next change, or std::nullopt if the field
+     * does not exist.
+     */
+    std::optional<std::string_view> get(std::string_view field) const;
+
+    /**
+     * @return Whether the field existed.
+     */
+    bool remove(std::string_view field);
+
+    /**
+     * Calls fn with each field and its value, in no particular order.
+     */
+    template<typename Fn>
+    void forEach(Fn &&fn) const {
+        if (table) {
+            for (const auto &[field, value]: *table) { fn(std::string_view(field), std::string_view(value)); }
+            return;
+        }
+
+        for (size_t offset = 0; offset < packed.size();) {
+            auto field = Listpack::frameAt(packed, offset);
+            auto value = Listpack::frameAt(packed, field.end());
+            fn(field.element, value.element);
+            offset = value.end();
+        }
+    }
+
+    size_t size() const { return table ? table->size() : packedFields; }
+    bool empty() const { return size() == 0; }
+    bool isPacked() const { return !table; }
+
+    // Bytes of the fields and values, plus framing while packed.
+    size_t bytes() const { return table ? tableBytes : packed.size(); }
+
+private:
+    using Table = std::unordered_map<std::string, std::string, StringViewHash, std::equal_to<>>;
+
+    // Fields and values as alternating frames, while the hash is packed.
+    std::string packed;
+    size_t packedFields = 0;
+
+    std::unique_ptr<Table> table;
+    size_t tableBytes = 0;
+
+    /**
+     * @return The frame of the field in the packed encoding, or std::nullopt if it does not exist. Its value's frame
+     * follows it.
+     */
+    std::optional<Listpack::Frame> findPacked(std::string_view field) const;
+
+    void convertToTable();
+};
@@ -0,0 +1,476 @@
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "cpu_features.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    using namespace HyperLogLog;
+
+    // Header: "HYLL", the encoding, three unused bytes and the cached count, little endian. The top bit of the count's
+    // last byte is set while the cache is stale.
+    constexpr std::string_view MAGIC = "HYLL";
+    constexpr size_t ENCODING_OFFSET = 4;
+    constexpr size_t CACHE_OFFSET = 8;
+    constexpr uint8_t STALE_CACHE = 0x80;
+
+    constexpr uint8_t DENSE = 0;
+    constexpr uint8_t SPARSE = 1;
+
+    constexpr uint8_t REGISTER_MAX = (1 << REGISTER_BITS) - 1;
+
+    // Sparse opcodes: ZERO is 00xxxxxx, a run of 1-64 zero registers. XZERO is 01xxxxxx yyyyyyyy, a run of 1-16384
+    // zero registers. VAL is 1vvvvvxx, a run of 1-4 registers set to 1-32.
+    constexpr size_t ZERO_MAX_RUN = 64;
+    constexpr size_t XZERO_MAX_RUN = 16384;
+    constexpr size_t VAL_MAX_RUN = 4;
+    constexpr uint8_t VAL_MAX_VALUE = 32;
+
+    // Seed of Redis' hash, so elements map to the same registers as there.
+    constexpr uint64_t HASH_SEED = 0xadc83b19ULL;
+
+    // Redis' bias-free alpha for an unbounded number of registers, 1 / (2 ln 2).
+    constexpr double ALPHA_INF = 0.721347520444481703680;
+
+    // MurmurHash64A, the hash Redis uses for HyperLogLogs.
+    uint64_t murmurHash64A(std::string_view key, uint64_t seed) {
+        constexpr uint64_t m = 0xc6a4a7935bd1e995ULL;
+        constexpr int r = 47;
+
+        uint64_t h = seed ^ (key.size() * m);
+        const char *data = key.data();
+        const char *end = data + (key.size() & ~size_t{7});
+
+        for (; data != end; data += 8) {
+            uint64_t k;
+            std::memcpy(&k, data, sizeof(k));
+            if constexpr (std::endian::native == std::endian::big) { k = std::byteswap(k); }
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+
+        switch (key.size() & 7) {
+            case 7: h ^= uint64_t{static_cast<uint8_t>(data[6])} << 48; [[fallthrough]];
+            case 6: h ^= uint64_t{static_cast<uint8_t>(data[5])} << 40; [[fallthrough]];
+            case 5: h ^= uint64_t{static_cast<uint8_t>(data[4])} << 32; [[fallthrough]];
+            case 4: h ^= uint64_t{static_cast<uint8_t>(data[3])} << 24; [[fallthrough]];
+            case 3: h ^= uint64_t{static_cast<uint8_t>(data[2])} << 16; [[fallthrough]];
+            case 2: h ^= uint64_t{static_cast<uint8_t>(data[1])} << 8; [[fallthrough]];
+            case 1:
+                h ^= uint64_t{static_cast<uint8_t>(data[0])};
+                h *= m;
+        }
+
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    // The register an element maps to, and the value it raises it to: one more than the trailing zero bits of the rest
+    // of its hash.
+    std::pair<size_t, uint8_t> registerFor(std::string_view element) {
+        uint64_t hash = murmurHash64A(element, HASH_SEED);
+        size_t index = hash & (NUM_REGISTERS - 1);
+
+        // A sentinel bit bounds the count to the bits left after the index.
+        hash >>= PRECISION;
+        hash |= uint64_t{1} << (64 - PRECISION);
+        return {index, static_cast<uint8_t>(std::countr_zero(hash) + 1)};
+    }
+
+    uint8_t denseRegister(const uint8_t *dense, size_t index) {
+        size_t byte = index * REGISTER_BITS / 8;
+        unsigned shift = index * REGISTER_BITS % 8;
+
+        unsigned value = dense[byte] >> shift;
+        if (shift > 8 - REGISTER_BITS) { value |= dense[byte + 1] << (8 - shift); }
+        return value & REGISTER_MAX;
+    }
+
+    void setDenseRegister(uint8_t *dense, size_t index, uint8_t value) {
+        size_t byte = index * REGISTER_BITS / 8;
+        unsigned shift = index * REGISTER_BITS % 8;
+
+        dense[byte] = (dense[byte] & ~(REGISTER_MAX << shift)) | (value << shift);
+        if (shift > 8 - REGISTER_BITS) {
+            dense[byte + 1] = (dense[byte + 1] & ~(REGISTER_MAX >> (8 - shift))) | (value >> (8 - shift));
+        }
+    }
+
+    void mergeDenseFrom(uint8_t *registers, const uint8_t *dense, size_t first) {
+        for (size_t i = first; i < NUM_REGISTERS; ++i) {
+            registers[i] = std::max(registers[i], denseRegister(dense, i));
+        }
+    }
+
+    // 2^-value, exactly.
+    double inversePowerOfTwo(uint8_t value) { return 1.0 / static_cast<double>(uint64_t{1} << value); }
+
+#ifdef CPU_FEATURES_X86
+    // Unpacks the 16 dense registers in 12 bytes to 16-bit lanes. Each 128-bit lane takes 8 registers from 6 bytes:
+    // every register gets the 16 bits it starts in, which a multiply shifts left so the register ends at bit 16, and a
+    // shift right moves it down to bit 0.
+    __attribute__((target("avx2"))) __m256i unpackDense16(const uint8_t *bytes) {
+        const __m256i gather = _mm256_setr_epi8(0, 1, 0, 1, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5, 5, 6, //
+                                                0, 1, 0, 1, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5, 5, 6);
+        const __m256i align = _mm256_setr_epi16(1024, 16, 64, 256, 1024, 16, 64, 256, //
+                                                1024, 16, 64, 256, 1024, 16, 64, 256);
+
+        __m128i low = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(bytes));
+        __m128i high = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(bytes + 6));
+        __m256i words = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), gather);
+        return _mm256_srli_epi16(_mm256_mullo_epi16(words, align), 16 - REGISTER_BITS);
+    }
+#endif
+}// namespace
+
+namespace HyperLogLogKernels {
+    void mergeDenseScalar(uint8_t *registers, const uint8_t *dense) { mergeDenseFrom(registers, dense, 0); }
+
+    RegisterSums sumScalar(const uint8_t *registers) {
+        RegisterSums sums{0, 0};
+        for (size_t i = 0; i < NUM_REGISTERS; ++i) {
+            sums.harmonic += inversePowerOfTwo(registers[i]);
+            sums.zeros += registers[i] == 0;
+        }
+        return sums;
+    }
+
+#ifdef CPU_FEATURES_X86
+    __attribute__((target("avx2"))) void mergeDenseAvx2(uint8_t *registers, const uint8_t *dense) {
+        // 32 registers from 24 bytes per step. The 8-byte loads read up to 2 bytes past the step, so the last step
+        // is left to the scalar loop.
+        constexpr size_t STEP = 32;
+        constexpr size_t VECTOR_REGISTERS = NUM_REGISTERS - STEP;
+        for (size_t i = 0; i < VECTOR_REGISTERS; i += STEP) {
+            const uint8_t *bytes = dense + i * REGISTER_BITS / 8;
+
+            // Packing interleaves the lanes of both halves, the permute puts the registers back in order.
+            __m256i unpacked = _mm256_packus_epi16(unpackDense16(bytes), unpackDense16(bytes + 12));
+            unpacked = _mm256_permute4x64_epi64(unpacked, 0xD8);
+
+            auto *target = reinterpret_cast<__m256i *>(registers + i);
+            _mm256_storeu_si256(target, _mm256_max_epu8(_mm256_loadu_si256(target), unpacked));
+        }
+
+        mergeDenseFrom(registers, dense, VECTOR_REGISTERS);
+    }
+
+    __attribute__((target("avx2"))) RegisterSums sumAvx2(const uint8_t *registers) {
+        // 2^-value is built as a double directly: exponent 1023 - value, mantissa zero.
+        const __m256i bias = _mm256_set1_epi64x(1023);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m256d sums[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+        size_t zeros = 0;
+
+        for (size_t i = 0; i < NUM_REGISTERS; i += 16) {
+            __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(registers + i));
+            zeros += std::popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(values, zero))));
+
+            for (int j = 0; j < 4; ++j) {
+                __m256i exponents = _mm256_sub_epi64(bias, _mm256_cvtepu8_epi64(values));
+                sums[j] = _mm256_add_pd(sums[j], _mm256_castsi256_pd(_mm256_slli_epi64(exponents, 52)));
+                values = _mm_srli_si128(values, 4);
+            }
+        }
+
+        __m256d total = _mm256_add_pd(_mm256_add_pd(sums[0], sums[1]), _mm256_add_pd(sums[2], sums[3]));
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, total);
+        return {lanes[0] + lanes[1] + lanes[2] + lanes[3], zeros};
+    }
+#else
+    void mergeDenseAvx2(uint8_t *registers, const uint8_t *dense) { mergeDenseScalar(registers, dense); }
+
+    RegisterSums sumAvx2(const uint8_t *registers) { return sumScalar(registers); }
+#endif
+}// namespace HyperLogLogKernels
+
+namespace {
+    struct Kernels {
+        void (*mergeDense)(uint8_t *, const uint8_t *);
+        HyperLogLogKernels::RegisterSums (*sum)(const uint8_t *);
+    };
+
+    Kernels selectKernels() {
+        if (CpuFeatures::hasAvx2()) return {HyperLogLogKernels::mergeDenseAvx2, HyperLogLogKernels::sumAvx2};
+        return {HyperLogLogKernels::mergeDenseScalar, HyperLogLogKernels::sumScalar};
+    }
+
+    const Kernels kernels = selectKernels();
+
+    std::string header(uint8_t encoding) {
+        std::string hll(HEADER_SIZE, '\0');
+        std::copy(MAGIC.begin(), MAGIC.end(), hll.begin());
+        hll[ENCODING_OFFSET] = static_cast<char>(encoding);
+        return hll;
+    }
+
+    const uint8_t *registerBytes(std::string_view hll) {
+        return reinterpret_cast<const uint8_t *>(hll.data()) + HEADER_SIZE;
+    }
+
+    /**
+     * Calls fn(value, length) with each run of a sparse HyperLogLog's registers, in order, until it returns false.
+     *
+     * @return Whether every run was walked, false if fn stopped the walk or the last opcode is cut short.
+     */
+    template<typename Fn>
+    bool forEachRun(std::string_view hll, Fn &&fn) {
+        const uint8_t *op = registerBytes(hll);
+        const uint8_t *end = reinterpret_cast<const uint8_t *>(hll.data() + hll.size());
+
+        while (op < end) {
+            bool more;
+            if ((*op & 0xC0) == 0x00) {
+                more = fn(uint8_t{0}, size_t{*op & 0x3Fu} + 1);
+                op += 1;
+            } else if ((*op & 0xC0) == 0x40) {
+                if (op + 1 == end) { return false; }
+                more = fn(uint8_t{0}, ((size_t{*op & 0x3Fu} << 8) | op[1]) + 1);
+                op += 2;
+            } else {
+                more = fn(static_cast<uint8_t>(((*op >> 2) & 0x1F) + 1), size_t{*op & 0x3u} + 1);
+                op += 1;
+            }
+            if (!more) { return false; }
+        }
+        return true;
+    }
+
+    void appendRun(std::string &hll, uint8_t value, size_t length) {
+        while (length > 0) {
+            if (value == 0) {
+                size_t run = std::min(length, XZERO_MAX_RUN);
+                if (run > ZERO_MAX_RUN) {
+                    hll.push_back(static_cast<char>(0x40 | ((run - 1) >> 8)));
+                    hll.push_back(static_cast<char>((run - 1) & 0xFF));
+                } else {
+                    hll.push_back(static_cast<char>(run - 1));
+                }
+                length -= run;
+            } else {
+                size_t run = std::min(length, VAL_MAX_RUN);
+                hll.push_back(static_cast<char>(0x80 | ((value - 1) << 2) | (run - 1)));
+                length -= run;
+            }
+        }
+    }
+
+    // Builds sparse runs, merging each run into the previous one if they hold the same value.
+    class RunWriter {
+    public:
+        explicit RunWriter(std::string &hll) : hll(hll) {}
+
+        void add(uint8_t value, size_t length) {
+            if (length == 0) { return; }
+            if (pendingLength > 0 && value != pendingValue) { flush(); }
+            pendingValue = value;
+            pendingLength += length;
+        }
+
+        void flush() {
+            appendRun(hll, pendingValue, pendingLength);
+            pendingLength = 0;
+        }
+
+    private:
+        std::string &hll;
+        uint8_t pendingValue = 0;
+        size_t pendingLength = 0;
+    };
+
+    /**
+     * Raises a register of a sparse HyperLogLog to value, at most VAL_MAX_VALUE, splitting the run it is in.
+     *
+     * @return Whether the register was lower.
+     */
+    bool setSparseRegister(std::string &hll, size_t index, uint8_t value) {
+        uint8_t current = 0;
+        size_t first = 0;
+        forEachRun(hll, [&](uint8_t runValue, size_t length) {
+            if (index < first + length) {
+                current = runValue;
+                return false;
+            }
+            first += length;
+            return true;
+        });
+        if (current >= value) { return false; }
+
+        // Rebuilt rather than patched in place, the runs are at most a few KB and merging neighbours stays simple.
+        std::string rebuilt = hll.substr(0, HEADER_SIZE);
+        rebuilt.reserve(hll.size() + 3);
+        RunWriter writer(rebuilt);
+
+        first = 0;
+        forEachRun(hll, [&](uint8_t runValue, size_t length) {
+            if (index >= first && index < first + length) {
+                writer.add(runValue, index - first);
+                writer.add(value, 1);
+                writer.add(runValue, first + length - index - 1);
+            } else {
+                writer.add(runValue, length);
+            }
+            first += length;
+            return true;
+        });
+        writer.flush();
+
+        hll = std::move(rebuilt);
+        return true;
+    }
+
+    void convertToDense(std::string &hll) {
+        std::string dense = header(DENSE);
+        dense.resize(DENSE_SIZE);
+        auto *registers = reinterpret_cast<uint8_t *>(dense.data()) + HEADER_SIZE;
+
+        size_t index = 0;
+        forEachRun(hll, [&](uint8_t value, size_t length) {
+            if (value != 0) {
+                for (size_t i = index; i < index + length; ++i) { setDenseRegister(registers, i, value); }
+            }
+            index += length;
+            return true;
+        });
+
+        hll = std::move(dense);
+    }
+
+    void invalidateCache(std::string &hll) {
+        hll[CACHE_OFFSET + 7] = static_cast<char>(static_cast<uint8_t>(hll[CACHE_OFFSET + 7]) | STALE_CACHE);
+    }
+
+    // Ertl's sigma, which weighs the zero registers in the improved raw estimator.
+    double sigma(double x) {
+        if (x == 1.0) { return std::numeric_limits<double>::infinity(); }
+
+        double y = 1.0;
+        double z = x;
+        double previous;
+        do {
+            x *= x;
+            previous = z;
+            z += x * y;
+            y += y;
+        } while (previous != z);
+        return z;
+    }
+}// namespace
+
+std::string HyperLogLog::create() {
+    std::string hll = header(SPARSE);
+    appendRun(hll, 0, NUM_REGISTERS);
+    return hll;
+}
+
+bool HyperLogLog::isValid(std::string_view hll) {
+    if (hll.size() < HEADER_SIZE || !hll.starts_with(MAGIC)) { return false; }
+
+    auto encoding = static_cast<uint8_t>(hll[ENCODING_OFFSET]);
+    if (encoding == DENSE) { return hll.size() == DENSE_SIZE; }
+    if (encoding != SPARSE) { return false; }
+
+    size_t covered = 0;
+    bool complete = forEachRun(hll, [&](uint8_t, size_t length) {
+        covered += length;
+        return covered <= NUM_REGISTERS;
+    });
+    return complete && covered == NUM_REGISTERS;
+}
+
+bool HyperLogLog::isSparse(std::string_view hll) { return static_cast<uint8_t>(hll[ENCODING_OFFSET]) == SPARSE; }
+
+bool HyperLogLog::add(std::string &hll, std::string_view element, size_t sparseMaxBytes) {
+    auto [index, value] = registerFor(element);
+
+    if (isSparse(hll)) {
+        if (value <= VAL_MAX_VALUE) {
+            if (!setSparseRegister(hll, index, value)) { return false; }
+            if (hll.size() > sparseMaxBytes) { convertToDense(hll); }
+
+            invalidateCache(hll);
+            return true;
+        }
+
+        convertToDense(hll);
+    }
+
+    auto *registers = reinterpret_cast<uint8_t *>(hll.data()) + HEADER_SIZE;
+    if (denseRegister(registers, index) >= value) { return false; }
+
+    setDenseRegister(registers, index, value);
+    invalidateCache(hll);
+    return true;
+}
+
+void HyperLogLog::mergeInto(Registers &registers, std::string_view hll) {
+    if (!isSparse(hll)) { return kernels.mergeDense(registers.data(), registerBytes(hll)); }
+
+    size_t index = 0;
+    forEachRun(hll, [&](uint8_t value, size_t length) {
+        for (size_t i = index; i < index + length; ++i) { registers[i] = std::max(registers[i], value); }
+        index += length;
+        return true;
+    });
+}
+
+std::string HyperLogLog::fromRegisters(const Registers &registers, size_t sparseMaxBytes) {
+    if (*std::max_element(registers.begin(), registers.end()) <= VAL_MAX_VALUE) {
+        std::string hll = header(SPARSE);
+        RunWriter writer(hll);
+        for (auto value: registers) { writer.add(value, 1); }
+        writer.flush();
+
+        if (hll.size() <= sparseMaxBytes) {
+            invalidateCache(hll);
+            return hll;
+        }
+    }
+
+    std::string hll = header(DENSE);
+    hll.resize(DENSE_SIZE);
+    auto *dense = reinterpret_cast<uint8_t *>(hll.data()) + HEADER_SIZE;
+    for (size_t i = 0; i < NUM_REGISTERS; ++i) { setDenseRegister(dense, i, registers[i]); }
+
+    invalidateCache(hll);
+    return hll;
+}
+
+uint64_t HyperLogLog::estimate(const Registers &registers) {
+    auto [harmonic, zeros] = kernels.sum(registers.data());
+    double m = NUM_REGISTERS;
+
+    // Ertl's improved raw estimator, which Redis uses too: zero registers are weighed by sigma instead of counting as
+    // 2^0 in the harmonic sum, which keeps it accurate at small counts without switching to linear counting. Its tau
+    // term only matters once a register holds 64 - PRECISION + 1, which takes around 2^64 elements, and is left out.
+    double z = m * sigma(static_cast<double>(zeros) / m) + (harmonic - static_cast<double>(zeros));
+    return static_cast<uint64_t>(std::llround(ALPHA_INF * m * m / z));
+}
+
+std::optional<uint64_t> HyperLogLog::cachedCount(std::string_view hll) {
+    if (static_cast<uint8_t>(hll[CACHE_OFFSET + 7]) & STALE_CACHE) { return std::nullopt; }
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < 8; ++i) { count |= uint64_t{static_cast<uint8_t>(hll[CACHE_OFFSET + i])} << (8 * i); }
+    return count;
+}
+
+void HyperLogLog::cacheCount(std::string &hll, uint64_t count) {
+    for (size_t i = 0; i < 8; ++i) { hll[CACHE_OFFSET + i] = static_cast<char>(count >> (8 * i)); }
+}
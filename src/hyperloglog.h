@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * HyperLogLogs stored as plain strings, in the same layout as Redis, so GET and SET copy them like any other string.
+ *
+ * A 16-byte header ("HYLL", the encoding and a cached count) is followed by 2^14 registers. Each register holds the
+ * longest run of zero bits seen in the hashes of the elements that map to it. The dense encoding packs six bits per
+ * register, 12 KB in all. The sparse encoding run-length encodes them with Redis' ZERO, XZERO and VAL opcodes, and is
+ * converted to dense once it grows past the configured size or a register exceeds 32.
+ */
+namespace HyperLogLog {
+    constexpr size_t PRECISION = 14;
+    constexpr size_t NUM_REGISTERS = size_t{1} << PRECISION;
+    constexpr size_t REGISTER_BITS = 6;
+    constexpr size_t HEADER_SIZE = 16;
+    constexpr size_t DENSE_SIZE = HEADER_SIZE + NUM_REGISTERS * REGISTER_BITS / 8;
+
+    // Default of hll-sparse-max-bytes, same as Redis.
+    constexpr size_t DEFAULT_SPARSE_MAX_BYTES = 3000;
+
+    // Registers unpacked to a byte each, for merging and counting.
+    using Registers = std::array<uint8_t, NUM_REGISTERS>;
+
+    /**
+     * @return An empty HyperLogLog, sparse.
+     */
+    std::string create();
+
+    /**
+     * @return Whether the bytes are a well-formed HyperLogLog, checked before any other function reads them.
+     */
+    bool isValid(std::string_view hll);
+
+    bool isSparse(std::string_view hll);
+
+    /**
+     * Adds an element, converting a sparse HyperLogLog to dense once it would grow past sparseMaxBytes.
+     *
+     * @return Whether a register changed.
+     */
+    bool add(std::string &hll, std::string_view element, size_t sparseMaxBytes);
+
+    /**
+     * Raises each of the registers to the matching register of hll, if higher.
+     */
+    void mergeInto(Registers &registers, std::string_view hll);
+
+    /**
+     * @return A HyperLogLog holding the registers, sparse if that fits in sparseMaxBytes.
+     */
+    std::string fromRegisters(const Registers &registers, size_t sparseMaxBytes);
+
+    /**
+     * @return The estimated number of distinct elements added to the registers.
+     */
+    uint64_t estimate(const Registers &registers);
+
+    /**
+     * @return The count cached in the header, unless a register changed since it was cached.
+     */
+    std::optional<uint64_t> cachedCount(std::string_view hll);
+
+    void cacheCount(std::string &hll, uint64_t count);
+}// namespace HyperLogLog
+
+// The merge and count kernels, exposed for testing. Only call the vector kernels if CpuFeatures::hasAvx2().
+namespace HyperLogLogKernels {
+    // What the estimate is computed from: the sum of 2^-register over all registers, and how many are zero.
+    struct RegisterSums {
+        double harmonic;
+        size_t zeros;
+    };
+
+    // Raises registers to the dense registers packed in dense, NUM_REGISTERS * 6 bits.
+    void mergeDenseScalar(uint8_t *registers, const uint8_t *dense);
+    void mergeDenseAvx2(uint8_t *registers, const uint8_t *dense);
+
+    RegisterSums sumScalar(const uint8_t *registers);
+    RegisterSums sumAvx2(const uint8_t *registers);
+}// namespace HyperLogLogKernels
@@ -0,0 +1,73 @@
+#include "intset.h"
+
+#include <algorithm>
+
+#include "cpu_features.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+namespace IntSetSearch {
+    bool scalar(const long long *data, size_t size, long long value) {
+        return std::binary_search(data, data + size, value);
+    }
+
+#ifdef CPU_FEATURES_X86
+    __attribute__((target("avx2"))) bool avx2(const long long *data, size_t size, long long value) {
+        if (size < BLOCK_SIZE) { return scalar(data, size, value); }
+
+        // Halves the window the value can be in, without branching on the comparison, until it fits a block.
+        const long long *base = data;
+        size_t length = size;
+        while (length > BLOCK_SIZE) {
+            size_t half = length / 2;
+            base = base[half] <= value ? base + half : base;
+            length -= half;
+        }
+
+        // Moved back at the end of the array, so the block is loaded from within it. It still covers the window.
+        base = std::min(base, data + size - BLOCK_SIZE);
+
+        const __m256i needle = _mm256_set1_epi64x(value);
+        __m256i found = _mm256_setzero_si256();
+        for (size_t i = 0; i < BLOCK_SIZE; i += 4) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i));
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi64(block, needle));
+        }
+
+        return !_mm256_testz_si256(found, found);
+    }
+#else
+    bool avx2(const long long *data, size_t size, long long value) { return scalar(data, size, value); }
+#endif
+}// namespace IntSetSearch
+
+namespace {
+    using Kernel = bool (*)(const long long *, size_t, long long);
+
+    Kernel selectKernel() {
+        if (CpuFeatures::hasAvx2()) return IntSetSearch::avx2;
+        return IntSetSearch::scalar;
+    }
+
+    const Kernel kernel = selectKernel();
+}// namespace
+
+bool IntSet::insert(long long value) {
+    auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it != values.end() && *it == value) { return false; }
+
+    values.insert(it, value);
+    return true;
+}
+
+bool IntSet::remove(long long value) {
+    auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it == values.end() || *it != value) { return false; }
+
+    values.erase(it);
+    return true;
+}
+
+bool IntSet::contains(long long value) const { return kernel(values.data(), values.size(), value); }
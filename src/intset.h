@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/**
+ * A set of integers kept as a sorted array, like Redis' intset: eight bytes per member and no allocation of its own
+ * per member. Lookups narrow the array down to a block with a binary search and compare the whole block at once with
+ * AVX2 when the CPU supports it.
+ */
+class IntSet {
+public:
+    /**
+     * @return Whether the value was added, false if it already was a member.
+     */
+    bool insert(long long value);
+
+    /**
+     * @return Whether the value was a member.
+     */
+    bool remove(long long value);
+
+    bool contains(long long value) const;
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    // The members in ascending order.
+    std::span<const long long> members() const { return values; }
+
+private:
+    std::vector<long long> values;
+};
+
+// The search kernels, exposed for testing. Only call the vector kernel if CpuFeatures::hasAvx2().
+namespace IntSetSearch {
+    // Number of members the vector kernel compares at once, smaller arrays are searched by the scalar kernel.
+    constexpr size_t BLOCK_SIZE = 16;
+
+    bool scalar(const long long *data, size_t size, long long value);
+    bool avx2(const long long *data, size_t size, long long value);
+}// namespace IntSetSearch
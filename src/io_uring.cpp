@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "io_uring.h"
+
+namespace {
+    int ioUringSetup(unsigned entries, io_uring_params *params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+    }
+}// namespace
+
+IoUring::IoUring(unsigned entries, unsigned numBuffers, size_t bufferSize)
+    : numBuffers(numBuffers), bufferSize(bufferSize), buffers(numBuffers * bufferSize) {
+    io_uring_params params{};
+    ringFD = ioUringSetup(entries, &params);
+
+    if (ringFD < 0) { throw std::runtime_error("io_uring_setup failed: " + std::string(strerror(errno))); }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        release();
+        throw std::runtime_error("io_uring does not support IORING_FEAT_SINGLE_MMAP");
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringMemorySize = std::max(sqSize, cqSize);
+
+    ringMemory = mmap(nullptr, ringMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD,
+                      IORING_OFF_SQ_RING);
+    if (ringMemory == MAP_FAILED) {
+        ringMemory = nullptr;
+        release();
+        throw std::runtime_error("Failed to map io_uring rings");
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqeMemory =
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQES);
+    if (sqeMemory == MAP_FAILED) {
+        release();
+        throw std::runtime_error("Failed to map io_uring submission entries");
+    }
+    sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+    auto *base = static_cast<uint8_t *>(ringMemory);
+    sqHead = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+    sqLocalTail = *sqTail;
+
+    // Provided-buffer ring, the kernel picks a buffer for each receive completion.
+    bufferRingSize = numBuffers * sizeof(io_uring_buf);
+    void *bufferRingMemory = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (bufferRingMemory == MAP_FAILED) {
+        release();
+        throw std::runtime_error("Failed to allocate io_uring buffer ring");
+    }
+    bufferRing = static_cast<io_uring_buf_ring *>(bufferRingMemory);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    reg.ring_entries = numBuffers;
+    reg.bgid = BUFFER_GROUP;
+
+    if (ioUringRegister(ringFD, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int err = errno;
+        release();
+        throw std::runtime_error("io_uring provided-buffer rings unsupported: " + std::string(strerror(err)));
+    }
+
+    for (unsigned i = 0; i < numBuffers; ++i) {
+        auto &buf = bufferRingEntries()[i];
+        buf.addr = reinterpret_cast<uint64_t>(buffer(i));
+        buf.len = bufferSize;
+        buf.bid = i;
+    }
+    __atomic_store_n(&bufferRing->tail, static_cast<uint16_t>(numBuffers), __ATOMIC_RELEASE);
+}
+
+IoUring::~IoUring() { release(); }
+
+void IoUring::release() {
+    if (bufferRing) munmap(bufferRing, bufferRingSize);
+    if (sqes) munmap(sqes, sqesSize);
+    if (ringMemory) munmap(ringMemory, ringMemorySize);
+    if (ringFD >= 0) close(ringFD);
+
+    bufferRing = nullptr;
+    sqes = nullptr;
+    ringMemory = nullptr;
+    ringFD = -1;
+}
+
+io_uring_sqe *IoUring::getSqe() {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    if (sqLocalTail - head > *sqMask) { submitAndWait(0); }
+
+    unsigned index = sqLocalTail & *sqMask;
+    sqArray[index] = index;
+    ++sqLocalTail;
+
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submitAndWait(unsigned waitNr) {
+    unsigned toSubmit = sqLocalTail - *sqTail;
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+    while (true) {
+        int ret = ioUringEnter(ringFD, toSubmit, waitNr, waitNr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (ret >= 0 || errno != EINTR) return ret;
+    }
+}
+
+void IoUring::recycleBuffer(uint16_t bufferId) {
+    uint16_t tail = bufferRing->tail;
+    auto &buf = bufferRingEntries()[tail & (numBuffers - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffer(bufferId));
+    buf.len = bufferSize;
+    buf.bid = bufferId;
+    __atomic_store_n(&bufferRing->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <vector>
+
+/**
+ * Minimal wrapper around the raw io_uring system calls: submission/completion rings and a single
+ * provided-buffer ring used for buffer-select receives.
+ *
+ * Throws std::runtime_error from the constructor if the kernel does not support io_uring or any
+ * of the features the network backend relies on (single mmap, provided-buffer rings).
+ * numBuffers must be a power of two.
+ */
+class IoUring {
+public:
+    IoUring(unsigned entries, unsigned numBuffers, size_t bufferSize);
+    ~IoUring();
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    /**
+     * Returns a zeroed submission queue entry. Flushes the queue to the kernel if it is full.
+     */
+    io_uring_sqe *getSqe();
+
+    /**
+     * Submits all queued entries with a single io_uring_enter call, optionally waiting for completions.
+     */
+    int submitAndWait(unsigned waitNr);
+
+    /**
+     * Invokes f for every available completion and marks them as consumed.
+     */
+    template<typename F>
+    unsigned forEachCqe(F &&f) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+
+        for (; head != tail; ++head, ++count) { f(cqes[head & *cqMask]); }
+
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    uint8_t *buffer(uint16_t bufferId) { return buffers.data() + static_cast<size_t>(bufferId) * bufferSize; }
+
+    /**
+     * Hands a provided buffer back to the kernel once its contents have been consumed.
+     */
+    void recycleBuffer(uint16_t bufferId);
+
+    static constexpr uint16_t BUFFER_GROUP = 0;
+
+private:
+    int ringFD = -1;
+
+    void *ringMemory = nullptr;
+    size_t ringMemorySize = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqLocalTail = 0;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+
+    io_uring_buf_ring *bufferRing = nullptr;
+    size_t bufferRingSize = 0;
+    unsigned numBuffers;
+    size_t bufferSize;
+    std::vector<uint8_t> buffers;
+
+    void release();
+
+    // The header's flexible array member is laid out after an empty struct when compiled as C++, so index the
+    // ring entries from its base address instead of through io_uring_buf_ring::bufs.
+    io_uring_buf *bufferRingEntries() { return reinterpret_cast<io_uring_buf *>(bufferRing); }
+};
@@ -0,0 +1,36 @@
+#include "lazy_freer.h"
+
+LazyFreer::LazyFreer() : thread([this] { run(); }) {}
+
+LazyFreer::~LazyFreer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    queued.notify_one();
+    thread.join();
+}
+
+void LazyFreer::enqueue(std::shared_ptr<const void> object) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(std::move(object));
+    }
+    queued.notify_one();
+}
+
+void LazyFreer::run() {
+    std::vector<std::shared_ptr<const void>> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            queued.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) { return; }
+            batch.swap(queue);
+        }
+
+        // The objects are destroyed here, without holding the lock that enqueue() takes.
+        batch.clear();
+    }
+}
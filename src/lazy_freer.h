@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Destroys objects on a background thread, so that freeing a large value or a whole keyspace does not hold up the
+ * thread that detached it from the data store.
+ */
+class LazyFreer {
+public:
+    LazyFreer();
+
+    /**
+     * Destroys the objects still queued and stops the thread.
+     */
+    ~LazyFreer();
+
+    LazyFreer(const LazyFreer &) = delete;
+    LazyFreer &operator=(const LazyFreer &) = delete;
+
+    /**
+     * Takes over an object and destroys it on the background thread.
+     */
+    template<typename T>
+    void free(T object) {
+        enqueue(std::make_shared<const T>(std::move(object)));
+    }
+
+    /**
+     * Drops a reference on the background thread, which frees the object if it was the last one.
+     */
+    template<typename T>
+    void free(std::shared_ptr<T> object) {
+        enqueue(std::move(object));
+    }
+
+private:
+    void enqueue(std::shared_ptr<const void> object);
+    void run();
+
+    std::mutex mtx;
+    std::condition_variable queued;
+    std::vector<std::shared_ptr<const void>> queue;
+    bool stopping = false;
+
+    // Started last, once the members it uses exist.
+    std::thread thread;
+};
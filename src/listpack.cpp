@@ -0,0 +1,64 @@
+#include "listpack.h"
+
+#include <cstdint>
+
+namespace {
+    // Longest LEB128 encoding of a 64-bit length.
+    constexpr size_t MAX_VARINT_SIZE = 10;
+
+    size_t putVarint(char *out, size_t value) {
+        size_t size = 0;
+        while (value >= 0x80) {
+            out[size++] = static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out[size++] = static_cast<char>(value);
+        return size;
+    }
+}// namespace
+
+size_t Listpack::varintSize(size_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void Listpack::append(std::string &out, std::string_view element) {
+    char length[MAX_VARINT_SIZE];
+    size_t size = putVarint(length, element.size());
+
+    out.append(length, size);
+    out.append(element);
+    // Reversed, so walking backward from the end of the frame reads the same varint.
+    for (size_t i = size; i > 0; --i) { out.push_back(length[i - 1]); }
+}
+
+Listpack::Frame Listpack::frameAt(std::string_view data, size_t offset) {
+    size_t length = 0;
+    size_t size = 0;
+    uint8_t byte;
+    do {
+        byte = static_cast<uint8_t>(data[offset + size]);
+        length |= static_cast<size_t>(byte & 0x7f) << (7 * size);
+        ++size;
+    } while (byte & 0x80);
+
+    return {offset, 2 * size + length, data.substr(offset + size, length)};
+}
+
+Listpack::Frame Listpack::frameBefore(std::string_view data, size_t end) {
+    size_t length = 0;
+    size_t size = 0;
+    uint8_t byte;
+    do {
+        byte = static_cast<uint8_t>(data[end - 1 - size]);
+        length |= static_cast<size_t>(byte & 0x7f) << (7 * size);
+        ++size;
+    } while (byte & 0x80);
+
+    size_t offset = end - 2 * size - length;
+    return {offset, 2 * size + length, data.substr(offset + size, length)};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * Framing of byte strings packed back to back into one buffer, as in Redis' listpack. Every element is framed as
+ * [length][bytes][length reversed], both lengths as LEB128 varints, so a buffer is walked forward from its first
+ * element and backward from its last one. An element up to 127 bytes costs two bytes of framing.
+ */
+namespace Listpack {
+    // An element framed inside a buffer: where its frame starts, how long the frame is and the element's bytes.
+    struct Frame {
+        size_t offset;
+        size_t size;
+        std::string_view element;
+
+        size_t end() const { return offset + size; }
+    };
+
+    size_t varintSize(size_t value);
+
+    inline size_t frameSize(size_t length) { return 2 * varintSize(length) + length; }
+
+    /**
+     * Appends the framed element to out.
+     */
+    void append(std::string &out, std::string_view element);
+
+    /**
+     * @return The frame starting at offset, which must start a frame.
+     */
+    Frame frameAt(std::string_view data, size_t offset);
+
+    /**
+     * @return The frame ending at end, which must end a frame.
+     */
+    Frame frameBefore(std::string_view data, size_t end);
+}// namespace Listpack
+
+/**
+ * Limits of a value kept packed in a listpack, such as a small hash or sorted set. Past either one the value is
+ * converted to its general encoding. The defaults are those of Redis' hash-max-listpack-* and zset-max-listpack-*.
+ */
+struct ListpackLimits {
+    size_t maxEntries = 128;
+
+    // Longest element in bytes, such as a field or member.
+    size_t maxValue = 64;
+};
@@ -1,6 +1,59 @@
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
 #include "spdlog/spdlog.h"
 #include "tcp_server.h"
 
+/**
+ * Parses a decimal number into T. Unlike std::stoul, rejects signs, whitespace, trailing characters and values that do
+ * not fit, rather than wrapping "-1" around to the largest value.
+ */
+template<std::unsigned_integral T = size_t>
+static T parseUnsigned(std::string_view str) {
+    T value = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec == std::errc::result_out_of_range) { throw std::out_of_range("number out of range " + std::string(str)); }
+    if (ec != std::errc() || end != str.data() + str.size()) {
+        throw std::invalid_argument("invalid number " + std::string(str));
+    }
+    return value;
+}
+
+/**
+ * Parses a memory amount such as "1024", "64kb", "32mb" or "1gb" into bytes.
+ */
+static size_t parseMemory(std::string_view str) {
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc()) { throw std::invalid_argument("invalid memory amount " + std::string(str)); }
+
+    std::string unit(end, str.data() + str.size());
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+
+    size_t multiplier;
+    if (unit.empty() || unit == "b") {
+        multiplier = 1;
+    } else if (unit == "k" || unit == "kb") {
+        multiplier = 1024;
+    } else if (unit == "m" || unit == "mb") {
+        multiplier = 1024 * 1024;
+    } else if (unit == "g" || unit == "gb") {
+        multiplier = 1024 * 1024 * 1024;
+    } else {
+        throw std::invalid_argument("unknown memory unit " + unit);
+    }
+
+    if (value > std::numeric_limits<size_t>::max() / multiplier) {
+        throw std::out_of_range("memory amount out of range " + std::string(str));
+    }
+    return value * multiplier;
+}
+
 int main(int argc, char **argv) {
 #if SPDLOG_ACTIVE_LEVEL == SPDLOG_LEVEL_DEBUG
     spdlog::set_level(spdlog::level::debug);
@@ -8,24 +61,174 @@ int main(int argc, char **argv) {
     spdlog::set_level(spdlog::level::info);
 #endif
 
-    std::optional<std::string> fileName;
+    ServerConfig config;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--persist" || arg == "-p") {
             if (i + 1 < argc) {
-                fileName = argv[i + 1];
+                config.writeAheadLogFileName = argv[++i];
             } else {
                 spdlog::error("No filename provided after {}.", arg);
                 return 1;
             }
-            break;
+        } else if (arg == "--threads" || arg == "-t") {
+            if (i + 1 < argc) {
+                try {
+                    config.numThreads = parseUnsigned(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid number of threads: {}.", argv[i]);
+                    return 1;
+                }
+                if (config.numThreads == 0) {
+                    spdlog::error("Number of threads must be at least 1.");
+                    return 1;
+                }
+            } else {
+                spdlog::error("No number of threads provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--backend") {
+            if (i + 1 < argc) {
+                std::string backend = argv[++i];
+                if (backend == "epoll") {
+                    config.backend = NetworkBackend::Epoll;
+                } else if (backend == "io_uring") {
+                    config.backend = NetworkBackend::IoUring;
+                } else {
+                    spdlog::error("Unsupported backend: {}.", backend);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No backend provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--unixsocket") {
+            if (i + 1 < argc) {
+                config.unixSocketPath = argv[++i];
+            } else {
+                spdlog::error("No path provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--client-output-buffer-limit") {
+            if (i + 3 < argc) {
+                try {
+                    config.clientOutputBufferLimit.hard = parseMemory(argv[i + 1]);
+                    config.clientOutputBufferLimit.soft = parseMemory(argv[i + 2]);
+                    config.clientOutputBufferLimit.softSeconds =
+                            std::chrono::seconds(parseUnsigned<uint32_t>(argv[i + 3]));
+                } catch (...) {
+                    spdlog::error("Invalid client output buffer limit.");
+                    return 1;
+                }
+                i += 3;
+            } else {
+                spdlog::error("Expected <hard> <soft> <soft-seconds> after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--timeout" || arg == "--tcp-keepalive") {
+            if (i + 1 < argc) {
+                try {
+                    auto seconds = std::chrono::seconds(parseUnsigned<uint32_t>(argv[++i]));
+                    (arg == "--timeout" ? config.timeout : config.tcpKeepalive) = seconds;
+                } catch (...) {
+                    spdlog::error("Invalid number of seconds: {}.", argv[i]);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No number of seconds provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--maxclients") {
+            if (i + 1 < argc) {
+                try {
+                    config.maxClients = parseUnsigned(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid number of clients: {}.", argv[i]);
+                    return 1;
+                }
+                if (config.maxClients == 0) {
+                    spdlog::error("Max number of clients must be at least 1.");
+                    return 1;
+                }
+            } else {
+                spdlog::error("No number of clients provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--proto-max-bulk-len") {
+            if (i + 1 < argc) {
+                try {
+                    config.protoMaxBulkLen = parseMemory(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid bulk length: {}.", argv[i]);
+                    return 1;
+                }
+                if (config.protoMaxBulkLen < 1024 * 1024) {
+                    spdlog::error("Max bulk length must be at least 1mb.");
+                    return 1;
+                }
+            } else {
+                spdlog::error("No bulk length provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--hash-max-listpack-entries" || arg == "--hash-max-listpack-value" ||
+                   arg == "--zset-max-listpack-entries" || arg == "--zset-max-listpack-value") {
+            if (i + 1 < argc) {
+                try {
+                    auto limit = parseUnsigned(argv[++i]);
+                    auto &limits = arg.starts_with("--hash") ? config.encodingLimits.hash
+                                                             : config.encodingLimits.sortedSet;
+                    (arg.ends_with("-entries") ? limits.maxEntries : limits.maxValue) = limit;
+                } catch (...) {
+                    spdlog::error("Invalid limit: {}.", argv[i]);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No limit provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--set-max-intset-entries") {
+            if (i + 1 < argc) {
+                try {
+                    config.encodingLimits.maxIntsetEntries = parseUnsigned(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid limit: {}.", argv[i]);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No limit provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--set-intersection-threads") {
+            if (i + 1 < argc) {
+                try {
+                    config.setIntersectionThreads = parseUnsigned(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid number of threads: {}.", argv[i]);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No number of threads provided after {}.", arg);
+                return 1;
+            }
+        } else if (arg == "--hll-sparse-max-bytes") {
+            if (i + 1 < argc) {
+                try {
+                    config.encodingLimits.hyperLogLogSparseMaxBytes = parseUnsigned(argv[++i]);
+                } catch (...) {
+                    spdlog::error("Invalid limit: {}.", argv[i]);
+                    return 1;
+                }
+            } else {
+                spdlog::error("No limit provided after {}.", arg);
+                return 1;
+            }
         } else {
             spdlog::error("Unsupported argument: {}.", arg);
             return 1;
         }
     }
 
-    TCPServer server(fileName);
+    TCPServer server(config);
     server.start("0.0.0.0", 6379);
 }
@@ -0,0 +1,90 @@
+#include "output_buffer.h"
+
+void OutputBuffer::append(std::span<const uint8_t> bytes) {
+    if (bytes.empty()) return;
+
+    // Start a new byte chunk with the memory of one that has been written already.
+    if (chunks.empty() || chunks.back().ref) { chunks.push_back(Chunk{std::move(spare), nullptr}); }
+
+    auto &tail = chunks.back().bytes;
+    tail.insert(tail.end(), bytes.begin(), bytes.end());
+    pending += bytes.size();
+}
+
+void OutputBuffer::append(std::string_view bytes) {
+    append(std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size()));
+}
+
+void OutputBuffer::append(std::shared_ptr<const std::string> value) {
+    if (!value || value->empty()) return;
+
+    pending += value->size();
+    chunks.push_back(Chunk{{}, std::move(value)});
+}
+
+size_t OutputBuffer::prepare(struct iovec *iov, size_t maxIov) const {
+    size_t count = 0;
+
+    for (size_t i = 0; i < chunks.size() && count < maxIov; ++i) {
+        auto data = chunks[i].data();
+        size_t skip = i == 0 ? offset : 0;
+
+        iov[count].iov_base = const_cast<uint8_t *>(data.data() + skip);
+        iov[count].iov_len = data.size() - skip;
+        ++count;
+    }
+
+    return count;
+}
+
+void OutputBuffer::consume(size_t n) {
+    pending -= n;
+
+    while (n > 0) {
+        size_t remaining = chunks.front().data().size() - offset;
+
+        if (n < remaining) {
+            offset += n;
+            return;
+        }
+
+        n -= remaining;
+        offset = 0;
+        release();
+    }
+}
+
+void OutputBuffer::release() {
+    auto &front = chunks.front();
+
+    if (!front.ref && front.bytes.capacity() > spare.capacity() && front.bytes.capacity() <= MAX_SPARE_CAPACITY) {
+        spare = std::move(front.bytes);
+        spare.clear();
+    }
+
+    // Clearing instead of popping the last chunk keeps the deque's storage allocated.
+    if (chunks.size() == 1) {
+        chunks.clear();
+    } else {
+        chunks.pop_front();
+    }
+}
+
+void OutputBuffer::clear() {
+    while (!chunks.empty()) { release(); }
+    offset = 0;
+    pending = 0;
+}
+
+std::string OutputBuffer::toString() const {
+    std::string result;
+    result.reserve(pending);
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        auto data = chunks[i].data();
+        size_t skip = i == 0 ? offset : 0;
+        result.append(reinterpret_cast<const char *>(data.data()) + skip, data.size() - skip);
+    }
+
+    return result;
+}
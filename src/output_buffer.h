@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+/**
+ * Pending output of a connection, kept as a list of chunks that can be handed to writev/sendmsg as is.
+ *
+ * Small writes are copied and coalesced into byte chunks, while large values are appended by reference so the
+ * stored bytes go straight from the data store to the socket. The memory of written byte chunks is reused, so
+ * once a connection's buffer has grown, replies are encoded without allocating.
+ */
+class OutputBuffer {
+public:
+    void append(std::span<const uint8_t> bytes);
+    void append(std::string_view bytes);
+
+    /**
+     * Appends a reference to value, which is kept alive until it has been written.
+     */
+    void append(std::shared_ptr<const std::string> value);
+
+    /**
+     * Fills iov with the pending chunks, in order, and returns the number of entries used.
+     */
+    size_t prepare(struct iovec *iov, size_t maxIov) const;
+
+    /**
+     * Drops the first n pending bytes after they have been written.
+     */
+    void consume(size_t n);
+
+    bool empty() const { return pending == 0; }
+    size_t size() const { return pending; }
+    void clear();
+
+    std::string toString() const;
+
+private:
+    struct Chunk {
+        std::vector<uint8_t> bytes;
+        std::shared_ptr<const std::string> ref;
+
+        std::span<const uint8_t> data() const {
+            if (ref) return {reinterpret_cast<const uint8_t *>(ref->data()), ref->size()};
+            return bytes;
+        }
+    };
+
+    /**
+     * Drops the first chunk, keeping its memory for reuse.
+     */
+    void release();
+
+    std::deque<Chunk> chunks;
+    std::vector<uint8_t> spare;
+
+    // Larger chunks are freed, so one burst of output does not pin its memory for the connection's lifetime.
+    static constexpr size_t MAX_SPARE_CAPACITY = 64 * 1024;
+    size_t offset = 0;
+    size_t pending = 0;
+};
@@ -1,5 +1,7 @@
 #include "persister.h"
 #include "controller.h"
+#include "request_parser.h"
+#include "spdlog/fmt/ranges.h"
 
 WriteAheadLogPersister::WriteAheadLogPersister(const std::string &fileName)
     : file(fileName, std::ios::binary | std::ios::app) {
@@ -11,6 +13,7 @@ WriteAheadLogPersister::WriteAheadLogPersister(const std::string &fileName)
 WriteAheadLogPersister::~WriteAheadLogPersister() { file.close(); }
 
 void WriteAheadLogPersister::writeAndFlush(const std::vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lock(mtx);
     file.write(reinterpret_cast<const char *>(data.data()), static_cast<long>(data.size()));
     file.flush();
 }
@@ -25,6 +28,7 @@ void WriteAheadLogPersister::restoreFromFile(const std::string &fileName, Contro
     }
 
     const std::size_t RECV_SIZE = 2048;
+    RequestParser parser;
 
     while (file) {
         std::vector<uint8_t> data(RECV_SIZE);
@@ -37,50 +41,32 @@ void WriteAheadLogPersister::restoreFromFile(const std::string &fileName, Contro
 
         buffer.insert(buffer.end(), data.begin(), data.begin() + bytes_received);
 
-        while (true) {
-            auto parsed = parseMessage(buffer);
-            if (!parsed) {
-                // No complete message in buffer, wait for more data
-                break;
-            }
-
-            // Parse message
-            auto [message, length] = *parsed;
-
-            if (!std::holds_alternative<RedisType::Array>(message)) {
-                spdlog::error("Unexpected message type, expected RedisType::Array");
-                buffer.erase(buffer.begin(), buffer.begin() + static_cast<long>(length));
-                continue;
-            }
+        size_t consumed = 0;
 
-            // If successfully parsed message, then erase from buffer
-            buffer.erase(buffer.begin(), buffer.begin() + static_cast<long>(length));
-
-            auto array = std::get<RedisType::Array>(message).data;
+        while (true) {
+            auto status = parser.parse(std::span<const uint8_t>(buffer).subspan(consumed));
 
-            if (!array) { continue; }
+            // No complete message in buffer, wait for more data
+            if (status == RequestParser::Status::Incomplete) { break; }
 
-            // Convert message to internal command format
-            std::vector<RedisType::BulkString> command;
-            bool err = false;
-            for (const auto &item: *array) {
-                if (!std::holds_alternative<RedisType::BulkString>(item)) {
-                    err = true;
-                    break;
-                }
-                command.push_back(std::get<RedisType::BulkString>(item));
+            if (status == RequestParser::Status::Error) {
+                spdlog::error("Corrupted write-ahead log: {}", parser.error());
+                return;
             }
 
-            if (err) {
-                spdlog::error("Array contains non-BulkString items");
-                continue;
+            // Handle command
+            if (!parser.args().empty()) {
+                OutputBuffer response;
+                controller.replayCommand(parser.args(), response);
+                spdlog::info("Restored: {}, Response: {}", fmt::join(parser.args(), " "), response.toString());
             }
 
-            // Handle command
-            RedisType::RedisValue res = controller.handleSet(command, false);
-            auto encoded = encode(res);
-            spdlog::info("Restored: {}, Response: {}", std::get<RedisType::Array>(message), res);
+            consumed += parser.length();
+            parser.reset();
         }
+
+        // Drop all restored messages at once, a partial one stays for the next read.
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<long>(consumed));
     }
 
     file.close();
@@ -3,6 +3,7 @@
 #include "spdlog/spdlog.h"
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -15,10 +16,14 @@ public:
     WriteAheadLogPersister(const std::string &fileName);
     ~WriteAheadLogPersister();
 
+    /**
+     * Appends data to the log as one record, safe to call from several threads.
+     */
     void writeAndFlush(const std::vector<uint8_t> &data);
 
     static void restoreFromFile(const std::string &fileName, Controller &controller);
 
 private:
+    std::mutex mtx;
     std::ofstream file;
 };
@@ -1,86 +1,149 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
 #include <cstdint>
 #include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 
+#include "crlf_scan.h"
 #include "overloaded.h"
 #include "redis_type.h"
 
 static const std::string CLRF = "\r\n";
 static const size_t CLRF_SIZE = CLRF.size();
 
-static size_t findSeparator(const std::vector<uint8_t> &buffer) {
-    auto it = std::search(buffer.begin(), buffer.end(), CLRF.begin(), CLRF.end());
-    return it == buffer.end() ? std::string::npos : std::distance(buffer.begin(), it);
-}
+static size_t findSeparator(std::span<const uint8_t> buffer) { return findCrlf(buffer); }
 
-static std::string extractStringFromBytes(const std::vector<uint8_t> &buffer, size_t start, size_t length) {
+static std::string extractStringFromBytes(std::span<const uint8_t> buffer, size_t start, size_t length) {
     return {buffer.begin() + static_cast<long>(start),
             buffer.begin() + static_cast<long>(start) + static_cast<long>(length)};
 }
 
+/**
+ * Decodes the integer between start and end, e.g. the length in a "$<length>\r\n" header, without copying it.
+ *
+ * @throws std::invalid_argument If the bytes are not a valid integer.
+ */
+static long long parseInteger(std::span<const uint8_t> buffer, size_t start, size_t end) {
+    const auto *first = reinterpret_cast<const char *>(buffer.data() + start);
+    const auto *last = reinterpret_cast<const char *>(buffer.data() + end);
+    long long value;
+
+    auto [ptr, ec] = std::from_chars(first, last, value);
+    if (ec != std::errc() || ptr != last || first == last) { throw std::invalid_argument("invalid integer"); }
+
+    return value;
+}
+
 static std::vector<uint8_t> stringToByteVector(const std::string &str) { return {str.begin(), str.end()}; }
 
-static std::optional<std::pair<RedisType::RedisValue, size_t>> parseMessage(const std::vector<uint8_t> &buffer) {
+static std::optional<std::pair<RedisType::RedisValue, size_t>> parseMessage(std::span<const uint8_t> buffer);
+
+/**
+ * Parses the elements of an aggregate whose header ends at separator.
+ *
+ * @return The elements and the encoded length of the whole aggregate, or std::nullopt if it is not complete yet.
+ */
+static std::optional<std::pair<std::vector<RedisType::RedisValue>, size_t>>
+parseElements(std::span<const uint8_t> buffer, size_t separator, long long count) {
+    std::vector<RedisType::RedisValue> elements;
+
+    size_t currentPos = separator + CLRF_SIZE;
+
+    for (long long i = 0; i < count; ++i) {
+        auto nextElem = parseMessage(buffer.subspan(currentPos));
+        if (!nextElem) { return std::nullopt; }
+
+        elements.push_back(std::move(nextElem->first));
+        currentPos += nextElem->second;
+    }
+
+    return std::make_pair(std::move(elements), currentPos);
+}
+
+/**
+ * Parses the first message in the buffer.
+ *
+ * @return The message and its encoded length, or std::nullopt if the buffer does not hold a complete message yet.
+ * @throws std::invalid_argument If the message is malformed.
+ */
+static std::optional<std::pair<RedisType::RedisValue, size_t>> parseMessage(std::span<const uint8_t> buffer) {
     size_t separator = findSeparator(buffer);
 
     if (separator == std::string::npos) return std::nullopt;
 
-    std::string payload = extractStringFromBytes(buffer, 1, separator - 1);
     char prefix = static_cast<char>(buffer[0]);
 
     switch (prefix) {
         case '+': {
-            RedisType::SimpleString result{payload};
+            RedisType::SimpleString result{extractStringFromBytes(buffer, 1, separator - 1)};
             return std::make_pair(result, separator + CLRF_SIZE);
         }
         case '-': {
-            RedisType::SimpleError result{payload};
+            RedisType::SimpleError result{extractStringFromBytes(buffer, 1, separator - 1)};
             return std::make_pair(result, separator + CLRF_SIZE);
         }
         case ':': {
-            RedisType::Integer result{std::stoll(payload)};
+            RedisType::Integer result{parseInteger(buffer, 1, separator)};
             return std::make_pair(result, separator + CLRF_SIZE);
         }
         case '$': {
-            int length = std::stoi(payload);
+            long long length = parseInteger(buffer, 1, separator);
 
-            if (length == -1) { return std::make_pair(RedisType::BulkString{std::nullopt}, 5); }
+            if (length == -1) { return std::make_pair(RedisType::BulkString{std::nullopt}, separator + CLRF_SIZE); }
+            if (length < 0) { throw std::invalid_argument("invalid bulk length"); }
 
             size_t endOfMessage = separator + 2 + length;
+            if (buffer.size() < endOfMessage + CLRF_SIZE) { return std::nullopt; }
+
             std::vector<uint8_t> data(buffer.begin() + static_cast<long>(separator) + 2,
                                       buffer.begin() + static_cast<long>(endOfMessage));
             return std::make_pair(RedisType::BulkString{data}, endOfMessage + CLRF_SIZE);
         }
         case '*': {
-            int length = std::stoi(payload);
+            long long length = parseInteger(buffer, 1, separator);
 
             if (length == -1) { return std::make_pair(RedisType::Array{std::nullopt}, separator + CLRF_SIZE); }
+            if (length < 0) { throw std::invalid_argument("invalid multibulk length"); }
 
-            if (length == 0) {
-                return std::make_pair(RedisType::Array{std::vector<RedisType::RedisValue>{}}, separator + CLRF_SIZE);
-            }
+            auto elements = parseElements(buffer, separator, length);
+            if (!elements) { return std::nullopt; }
 
-            std::vector<RedisType::RedisValue> array;
+            return std::make_pair(RedisType::Array{std::move(elements->first)}, elements->second);
+        }
+        case '_': {
+            return std::make_pair(RedisType::Null{}, separator + CLRF_SIZE);
+        }
+        case '%': {
+            long long length = parseInteger(buffer, 1, separator);
+            if (length < 0) { throw std::invalid_argument("invalid map length"); }
 
-            size_t currentPos = separator;
+            auto elements = parseElements(buffer, separator, 2 * length);
+            if (!elements) { return std::nullopt; }
 
-            for (int i = 0; i < length; ++i) {
-                auto nextElem =
-                        parseMessage({buffer.begin() + static_cast<long>(currentPos + CLRF_SIZE), buffer.end()});
-                if (nextElem) {
-                    array.push_back(nextElem->first);
-                    currentPos += nextElem->second;
-                } else {
-                    return std::nullopt;
-                }
+            RedisType::Map map;
+            map.data.reserve(length);
+            for (size_t i = 0; i < elements->first.size(); i += 2) {
+                map.data.emplace_back(std::move(elements->first[i]), std::move(elements->first[i + 1]));
             }
 
-            return std::make_pair(RedisType::Array{array}, currentPos + CLRF_SIZE);
+            return std::make_pair(std::move(map), elements->second);
+        }
+        case '>': {
+            long long length = parseInteger(buffer, 1, separator);
+            if (length < 0) { throw std::invalid_argument("invalid push length"); }
+
+            auto elements = parseElements(buffer, separator, length);
+            if (!elements) { return std::nullopt; }
+
+            return std::make_pair(RedisType::Push{std::move(elements->first)}, elements->second);
         }
         default:
             return {};
@@ -137,6 +200,23 @@ static std::vector<uint8_t> encode(const RedisType::RedisValue &message) {
                                }
                            }
                        },
+                       [&encoded](const RedisType::Null &) { encoded = stringToByteVector("_" + CLRF); },
+                       [&encoded](const RedisType::Map &map) {
+                           encoded = stringToByteVector("%" + std::to_string(map.data.size()) + CLRF);
+                           for (const auto &[key, value]: map.data) {
+                               auto keyEncoded = encode(key);
+                               auto valueEncoded = encode(value);
+                               encoded.insert(encoded.end(), keyEncoded.begin(), keyEncoded.end());
+                               encoded.insert(encoded.end(), valueEncoded.begin(), valueEncoded.end());
+                           }
+                       },
+                       [&encoded](const RedisType::Push &push) {
+                           encoded = stringToByteVector(">" + std::to_string(push.data.size()) + CLRF);
+                           for (const auto &element: push.data) {
+                               auto elementEncoded = encode(element);
+                               encoded.insert(encoded.end(), elementEncoded.begin(), elementEncoded.end());
+                           }
+                       },
                },
                message);
 
@@ -144,18 +224,17 @@ static std::vector<uint8_t> encode(const RedisType::RedisValue &message) {
 }
 
 
-static std::vector<uint8_t> fileEncode(const std::vector<RedisType::BulkString> &command) {
+/**
+ * Encodes a command as a RESP array of bulk strings, the format of the write-ahead log.
+ */
+static std::vector<uint8_t> fileEncode(std::span<const std::string_view> args) {
+    std::string encoded = "*" + std::to_string(args.size()) + CLRF;
 
-    RedisType::Array array;
-    std::vector<RedisType::RedisValue> elements;
-
-    for (const auto &item: command) {
-        RedisType::BulkString bulkString;
-        bulkString.data = item.data;
-        elements.push_back(bulkString);
+    for (auto arg: args) {
+        encoded += "$" + std::to_string(arg.size()) + CLRF;
+        encoded.append(arg);
+        encoded += CLRF;
     }
-    array.data = elements;
-
 
-    return encode(array);
-}
\ No newline at end of file
+    return stringToByteVector(encoded);
+}
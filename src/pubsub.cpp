@@ -0,0 +1,250 @@
+#include "pubsub.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+#include "output_buffer.h"
+#include "reply_writer.h"
+
+namespace {
+    constexpr std::string_view SPECIAL_CHARACTERS = "*?[\\";
+
+    // Matches c against the set starting after the '[' at pattern[p], and moves p past the closing ']'.
+    bool matchSet(std::string_view pattern, size_t &p, char c) {
+        bool negate = p < pattern.size() && pattern[p] == '^';
+        if (negate) { ++p; }
+
+        bool match = false;
+        for (; p < pattern.size() && pattern[p] != ']'; ++p) {
+            if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+                match = match || pattern[++p] == c;
+            } else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+                auto [low, high] = std::minmax(pattern[p], pattern[p + 2]);
+                match = match || (c >= low && c <= high);
+                p += 2;
+            } else {
+                match = match || pattern[p] == c;
+            }
+        }
+
+        // An unterminated set runs to the end of the pattern.
+        if (p < pattern.size()) { ++p; }
+        return match != negate;
+    }
+
+    // Matches c against the element of the pattern at p other than '*', and moves p past it.
+    bool matchOne(std::string_view pattern, size_t &p, char c) {
+        switch (pattern[p]) {
+            case '?':
+                ++p;
+                return true;
+            case '[':
+                ++p;
+                return matchSet(pattern, p, c);
+            case '\\':
+                if (p + 1 < pattern.size()) { ++p; }
+                [[fallthrough]];
+            default:
+                return pattern[p++] == c;
+        }
+    }
+
+    std::string_view literalPrefix(std::string_view pattern) {
+        return pattern.substr(0, std::min(pattern.find_first_of(SPECIAL_CHARACTERS), pattern.size()));
+    }
+
+    // A message encoded on first use for each protocol version, then shared by every recipient using it.
+    class EncodedMessage {
+    public:
+        EncodedMessage(std::initializer_list<std::string_view> parts) : parts(parts) {}
+
+        const std::shared_ptr<const std::string> &forProtocol(int protocol) {
+            auto &encoded = protocol >= 3 ? resp3 : resp2;
+            if (encoded) { return encoded; }
+
+            OutputBuffer out;
+            ReplyWriter writer(out, protocol);
+            if (protocol >= 3) {
+                writer.pushHeader(parts.size());
+            } else {
+                writer.arrayHeader(parts.size());
+            }
+            for (auto part: parts) { writer.bulkString(part); }
+
+            encoded = std::make_shared<const std::string>(out.toString());
+            return encoded;
+        }
+
+    private:
+        std::vector<std::string_view> parts;
+        std::shared_ptr<const std::string> resp2;
+        std::shared_ptr<const std::string> resp3;
+    };
+
+    void removeClient(std::vector<Client *> &clients, const Client &client) {
+        auto it = std::find(clients.begin(), clients.end(), &client);
+        if (it == clients.end()) { return; }
+
+        *it = clients.back();
+        clients.pop_back();
+    }
+}// namespace
+
+bool globMatch(std::string_view pattern, std::string_view str) {
+    size_t p = 0;
+    size_t s = 0;
+
+    // Where to resume after the last '*' if the rest fails to match: the star matches one more character.
+    size_t starPattern = std::string_view::npos;
+    size_t starString = 0;
+
+    while (s < str.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            starPattern = ++p;
+            starString = s;
+            continue;
+        }
+
+        if (p < pattern.size()) {
+            size_t next = p;
+            if (matchOne(pattern, next, str[s])) {
+                p = next;
+                ++s;
+                continue;
+            }
+        }
+
+        if (starPattern == std::string_view::npos) { return false; }
+        p = starPattern;
+        s = ++starString;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') { ++p; }
+    return p == pattern.size();
+}
+
+bool PubSub::subscribe(Client &client, std::string_view channel) {
+    if (std::find(client.channels.begin(), client.channels.end(), channel) != client.channels.end()) { return false; }
+
+    client.channels.emplace_back(channel);
+
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    auto it = channels.find(channel);
+    if (it == channels.end()) { it = channels.emplace(std::string(channel), std::vector<Client *>{}).first; }
+    it->second.push_back(&client);
+    return true;
+}
+
+bool PubSub::unsubscribe(Client &client, std::string_view channel) {
+    auto subscribed = std::find(client.channels.begin(), client.channels.end(), channel);
+    if (subscribed == client.channels.end()) { return false; }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        removeFromChannel(channel, client);
+    }
+
+    client.channels.erase(subscribed);
+    return true;
+}
+
+bool PubSub::psubscribe(Client &client, std::string_view pattern) {
+    if (std::find(client.patterns.begin(), client.patterns.end(), pattern) != client.patterns.end()) { return false; }
+
+    client.patterns.emplace_back(pattern);
+
+    auto prefix = literalPrefix(pattern);
+
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    auto it = patternsByPrefix.find(prefix);
+    if (it == patternsByPrefix.end()) {
+        it = patternsByPrefix.emplace(std::string(prefix), std::vector<PatternSubscribers>{}).first;
+    }
+
+    auto &subscribers = it->second;
+    auto entry = std::find_if(subscribers.begin(), subscribers.end(),
+                              [&](const PatternSubscribers &s) { return s.pattern == pattern; });
+    if (entry == subscribers.end()) {
+        entry = subscribers.insert(subscribers.end(), PatternSubscribers{std::string(pattern), {}});
+        ++prefixLengths[prefix.size()];
+    }
+
+    entry->clients.push_back(&client);
+    return true;
+}
+
+bool PubSub::punsubscribe(Client &client, std::string_view pattern) {
+    auto subscribed = std::find(client.patterns.begin(), client.patterns.end(), pattern);
+    if (subscribed == client.patterns.end()) { return false; }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        removeFromPattern(pattern, client);
+    }
+
+    client.patterns.erase(subscribed);
+    return true;
+}
+
+void PubSub::unsubscribeAll(Client &client) {
+    if (client.subscriptions() == 0) { return; }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        for (const auto &channel: client.channels) { removeFromChannel(channel, client); }
+        for (const auto &pattern: client.patterns) { removeFromPattern(pattern, client); }
+    }
+
+    client.channels.clear();
+    client.patterns.clear();
+}
+
+size_t PubSub::publish(std::string_view channel, std::string_view message) {
+    size_t receivers = 0;
+
+    std::shared_lock<std::shared_mutex> lock(mtx);
+
+    if (auto it = channels.find(channel); it != channels.end()) {
+        EncodedMessage encoded{"message", channel, message};
+        for (auto *client: it->second) { client->deliver(encoded.forProtocol(client->protocol)); }
+        receivers += it->second.size();
+    }
+
+    for (auto [length, count]: prefixLengths) {
+        if (length > channel.size()) { break; }
+
+        auto it = patternsByPrefix.find(channel.substr(0, length));
+        if (it == patternsByPrefix.end()) { continue; }
+
+        for (const auto &subscribers: it->second) {
+            if (!globMatch(subscribers.pattern, channel)) { continue; }
+
+            EncodedMessage encoded{"pmessage", subscribers.pattern, channel, message};
+            for (auto *client: subscribers.clients) { client->deliver(encoded.forProtocol(client->protocol)); }
+            receivers += subscribers.clients.size();
+        }
+    }
+
+    return receivers;
+}
+
+void PubSub::removeFromChannel(std::string_view channel, const Client &client) {
+    auto it = channels.find(channel);
+    removeClient(it->second, client);
+    if (it->second.empty()) { channels.erase(it); }
+}
+
+void PubSub::removeFromPattern(std::string_view pattern, const Client &client) {
+    auto prefix = literalPrefix(pattern);
+    auto it = patternsByPrefix.find(prefix);
+    auto &subscribers = it->second;
+    auto entry = std::find_if(subscribers.begin(), subscribers.end(),
+                              [&](const PatternSubscribers &s) { return s.pattern == pattern; });
+
+    removeClient(entry->clients, client);
+    if (!entry->clients.empty()) { return; }
+
+    subscribers.erase(entry);
+    if (--prefixLengths[prefix.size()] == 0) { prefixLengths.erase(prefix.size()); }
+    if (subscribers.empty()) { patternsByPrefix.erase(it); }
+}
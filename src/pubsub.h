@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "client.h"
+#include "string_view_hash.h"
+
+/**
+ * Matches str against a glob-style pattern as Redis does: '*' matches any sequence, '?' any single character,
+ * "[abc]", "[^abc]" and "[a-z]" a character in or out of a set, and '\' escapes the next character.
+ */
+bool globMatch(std::string_view pattern, std::string_view str);
+
+/**
+ * Channel and pattern subscriptions of the connected clients. Publishing encodes a message once per protocol version
+ * and hands the same buffer to every subscriber's mailbox, so fan-out costs a reference per subscriber.
+ *
+ * Subscriptions are changed by the thread serving the client, which must unsubscribe it from everything before it is
+ * destroyed. Messages are published from any thread.
+ */
+class PubSub {
+public:
+    /**
+     * @return Whether the client was not subscribed to the channel yet.
+     */
+    bool subscribe(Client &client, std::string_view channel);
+
+    /**
+     * @return Whether the client was subscribed to the channel.
+     */
+    bool unsubscribe(Client &client, std::string_view channel);
+
+    /**
+     * @return Whether the client was not subscribed to the pattern yet.
+     */
+    bool psubscribe(Client &client, std::string_view pattern);
+
+    /**
+     * @return Whether the client was subscribed to the pattern.
+     */
+    bool punsubscribe(Client &client, std::string_view pattern);
+
+    void unsubscribeAll(Client &client);
+
+    /**
+     * Delivers a message to the subscribers of the channel and of every pattern matching it.
+     *
+     * @return The number of deliveries. A client subscribed through several patterns receives the message once for
+     * each.
+     */
+    size_t publish(std::string_view channel, std::string_view message);
+
+private:
+    struct PatternSubscribers {
+        std::string pattern;
+        std::vector<Client *> clients;
+    };
+
+    // Shared by publishers, exclusive for changing subscriptions.
+    std::shared_mutex mtx;
+
+    std::unordered_map<std::string, std::vector<Client *>, StringViewHash, std::equal_to<>> channels;
+
+    // Patterns by their literal prefix, the part before the first special character. A channel is only matched against
+    // the patterns whose prefix it starts with.
+    std::unordered_map<std::string, std::vector<PatternSubscribers>, StringViewHash, std::equal_to<>> patternsByPrefix;
+
+    // Number of patterns with a literal prefix of each length, so publishing only looks up the lengths in use.
+    std::map<size_t, size_t> prefixLengths;
+
+    // Remove a subscriber the client's own list shows. Must be called with mtx held exclusively.
+    void removeFromChannel(std::string_view channel, const Client &client);
+    void removeFromPattern(std::string_view pattern, const Client &client);
+};
@@ -0,0 +1,93 @@
+#include "quicklist.h"
+
+void QuickList::pushFront(std::string_view element) {
+    auto &node = nodeForPush(true, Listpack::frameSize(element.size()));
+
+    if (node.data.empty()) {
+        Listpack::append(node.data, element);
+    } else {
+        std::string frame;
+        Listpack::append(frame, element);
+        node.data.insert(0, frame);
+    }
+
+    ++node.count;
+    ++length;
+    totalBytes += Listpack::frameSize(element.size());
+}
+
+void QuickList::pushBack(std::string_view element) {
+    auto &node = nodeForPush(false, Listpack::frameSize(element.size()));
+    Listpack::append(node.data, element);
+
+    ++node.count;
+    ++length;
+    totalBytes += Listpack::frameSize(element.size());
+}
+
+std::string QuickList::popFront() {
+    auto &node = nodes.front();
+    auto frame = Listpack::frameAt(node.data, 0);
+    std::string element(frame.element);
+
+    node.data.erase(0, frame.size);
+    --length;
+    totalBytes -= frame.size;
+    if (--node.count == 0) { nodes.pop_front(); }
+
+    return element;
+}
+
+std::string QuickList::popBack() {
+    auto &node = nodes.back();
+    auto frame = Listpack::frameBefore(node.data, node.data.size());
+    std::string element(frame.element);
+
+    node.data.resize(frame.offset);
+    --length;
+    totalBytes -= frame.size;
+    if (--node.count == 0) { nodes.pop_back(); }
+
+    return element;
+}
+
+std::vector<std::string> QuickList::range(size_t start, size_t end) const {
+    std::vector<std::string> elements;
+    elements.reserve(end - start + 1);
+
+    // Whole nodes are skipped by their counts, from whichever end of the list is closer.
+    auto node = nodes.begin();
+    size_t first = 0;
+    if (start < length / 2) {
+        while (first + node->count <= start) { first += node++->count; }
+    } else {
+        node = nodes.end();
+        first = length;
+        do { first -= (--node)->count; } while (first > start);
+    }
+
+    size_t offset = 0;
+    for (size_t i = first; i < start; ++i) { offset += Listpack::frameAt(node->data, offset).size; }
+
+    for (size_t i = start; i <= end; ++i) {
+        if (offset == node->data.size()) {
+            ++node;
+            offset = 0;
+        }
+
+        auto frame = Listpack::frameAt(node->data, offset);
+        elements.emplace_back(frame.element);
+        offset += frame.size;
+    }
+
+    return elements;
+}
+
+QuickList::Node &QuickList::nodeForPush(bool front, size_t size) {
+    if (!nodes.empty()) {
+        auto &node = front ? nodes.front() : nodes.back();
+        if (node.data.size() + size <= NODE_SIZE) { return node; }
+    }
+
+    return front ? nodes.emplace_front() : nodes.emplace_back();
+}
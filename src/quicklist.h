@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "listpack.h"
+
+/**
+ * A list of byte strings stored as a chain of nodes, each packing its elements into one contiguous buffer like Redis'
+ * quicklist of listpacks. An element costs its bytes plus a little framing, see Listpack, instead of a heap node of
+ * its own, and ranges are read by scanning buffers front to back.
+ */
+class QuickList {
+public:
+    // Nodes are filled up to this many bytes, same as Redis' default list-max-listpack-size of -2. A larger element
+    // gets a node of its own.
+    static constexpr size_t NODE_SIZE = 8 * 1024;
+
+    void pushFront(std::string_view element);
+    void pushBack(std::string_view element);
+
+    /**
+     * Removes and returns the first or last element, the list must not be empty.
+     */
+    std::string popFront();
+    std::string popBack();
+
+    /**
+     * Copies the elements from start to end inclusive, which must be valid indices with start <= end.
+     */
+    std::vector<std::string> range(size_t start, size_t end) const;
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    // Bytes held by the node buffers, including framing.
+    size_t bytes() const { return totalBytes; }
+
+    size_t numNodes() const { return nodes.size(); }
+
+private:
+    struct Node {
+        std::string data;
+        size_t count = 0;
+    };
+
+    // The node to push a frame of the given size onto, creating one if the current end node is full.
+    Node &nodeForPush(bool front, size_t size);
+
+    std::deque<Node> nodes;
+    size_t length = 0;
+    size_t totalBytes = 0;
+};
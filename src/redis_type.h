@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <optional>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <variant>
@@ -35,11 +36,27 @@ namespace RedisType {
         std::string data;
     };
 
+    // RESP3 null, replacing the null bulk string and null array of RESP2.
+    struct Null {};
+
+    struct Map;
+    struct Push;
+
     struct Array {
-        std::optional<std::vector<std::variant<SimpleString, BulkString, Integer, SimpleError, Array>>> data;
+        std::optional<std::vector<std::variant<SimpleString, BulkString, Integer, SimpleError, Array, Null, Map, Push>>>
+                data;
     };
 
-    using RedisValue = std::variant<SimpleString, BulkString, Integer, SimpleError, Array>;
+    using RedisValue = std::variant<SimpleString, BulkString, Integer, SimpleError, Array, Null, Map, Push>;
+
+    struct Map {
+        std::vector<std::pair<RedisValue, RedisValue>> data;
+    };
+
+    // Out-of-band RESP3 message, e.g. an invalidation sent to a client tracking keys.
+    struct Push {
+        std::vector<RedisValue> data;
+    };
 
 };// namespace RedisType
 
@@ -65,6 +82,32 @@ static std::ostream &operator<<(std::ostream &os, const RedisType::SimpleError &
     return os << "SimpleError: " << value.data;
 }
 
+static std::ostream &operator<<(std::ostream &os, const RedisType::RedisValue &value);
+
+static std::ostream &operator<<(std::ostream &os, const RedisType::Null &) { return os << "Null"; }
+
+static std::ostream &operator<<(std::ostream &os, const RedisType::Map &value) {
+    os << "Map: {";
+    bool first = true;
+    for (const auto &[key, val]: value.data) {
+        if (!first) { os << ", "; }
+        first = false;
+        os << key << ": " << val;
+    }
+    return os << "}";
+}
+
+static std::ostream &operator<<(std::ostream &os, const RedisType::Push &value) {
+    os << "Push: [";
+    bool first = true;
+    for (const auto &elem: value.data) {
+        if (!first) { os << ", "; }
+        first = false;
+        os << elem;
+    }
+    return os << "]";
+}
+
 static std::ostream &operator<<(std::ostream &os, const RedisType::Array &value) {
     os << "Array: ";
     if (value.data.has_value()) {
@@ -154,6 +197,40 @@ struct fmt::formatter<RedisType::Array> {
     }
 };
 
+template<>
+struct fmt::formatter<RedisType::Null> {
+    constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+
+    template<typename FormatContext>
+    auto format(const RedisType::Null &, FormatContext &ctx) {
+        return fmt::format_to(ctx.out(), "Null");
+    }
+};
+
+template<>
+struct fmt::formatter<RedisType::Map> {
+    constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+
+    template<typename FormatContext>
+    auto format(const RedisType::Map &value, FormatContext &ctx) {
+        std::ostringstream os;
+        os << value;
+        return fmt::format_to(ctx.out(), "{}", os.str());
+    }
+};
+
+template<>
+struct fmt::formatter<RedisType::Push> {
+    constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+
+    template<typename FormatContext>
+    auto format(const RedisType::Push &value, FormatContext &ctx) {
+        std::ostringstream os;
+        os << value;
+        return fmt::format_to(ctx.out(), "{}", os.str());
+    }
+};
+
 template<>
 struct fmt::formatter<RedisType::RedisValue> {
     constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
@@ -0,0 +1,128 @@
+#include "reply_writer.h"
+
+#include <array>
+#include <charconv>
+
+namespace {
+    constexpr std::string_view CRLF = "\r\n";
+    constexpr int SHARED_INTEGERS = 10000;
+
+    // ":0\r\n" to ":9999\r\n", encoded at compile time.
+    struct EncodedInteger {
+        char data[8];
+        uint8_t length;
+    };
+
+    constexpr std::array<EncodedInteger, SHARED_INTEGERS> encodeIntegers() {
+        std::array<EncodedInteger, SHARED_INTEGERS> table{};
+
+        for (int i = 0; i < SHARED_INTEGERS; ++i) {
+            auto &entry = table[i];
+            char digits[4];
+            int numDigits = 0;
+            for (int n = i; n > 0 || numDigits == 0; n /= 10) { digits[numDigits++] = static_cast<char>('0' + n % 10); }
+
+            entry.data[entry.length++] = ':';
+            while (numDigits > 0) { entry.data[entry.length++] = digits[--numDigits]; }
+            entry.data[entry.length++] = '\r';
+            entry.data[entry.length++] = '\n';
+        }
+
+        return table;
+    }
+
+    constexpr auto sharedIntegers = encodeIntegers();
+}// namespace
+
+void ReplyWriter::simpleString(std::string_view str) {
+    out.append(std::string_view("+"));
+    out.append(str);
+    out.append(CRLF);
+}
+
+void ReplyWriter::error(std::string_view message) {
+    out.append(std::string_view("-"));
+    out.append(message);
+    out.append(CRLF);
+}
+
+void ReplyWriter::wrongArity(std::string_view command) {
+    out.append(std::string_view("-ERR wrong number of arguments for '"));
+    out.append(command);
+    out.append(std::string_view("' command\r\n"));
+}
+
+void ReplyWriter::integer(long long value) {
+    if (value >= 0 && value < SHARED_INTEGERS) {
+        const auto &encoded = sharedIntegers[value];
+        out.append(std::string_view(encoded.data, encoded.length));
+        return;
+    }
+
+    header(':', value);
+}
+
+void ReplyWriter::bulkString(std::string_view str) {
+    header('$', static_cast<long long>(str.size()));
+    out.append(str);
+    out.append(CRLF);
+}
+
+void ReplyWriter::bulkInteger(long long value) {
+    // Length header, sign and digits of any 64-bit value, and both CRLFs.
+    char buffer[32];
+    char digits[20];
+    auto [digitsEnd, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    auto length = digitsEnd - digits;
+
+    char *end = buffer;
+    *end++ = '$';
+    end = std::to_chars(end, buffer + sizeof(buffer), length).ptr;
+    end = std::copy(CRLF.begin(), CRLF.end(), end);
+    end = std::copy(digits, digitsEnd, end);
+    end = std::copy(CRLF.begin(), CRLF.end(), end);
+    out.append(std::string_view(buffer, end - buffer));
+}
+
+void ReplyWriter::bulkString(std::shared_ptr<const std::string> value) {
+    if (value->size() < ZERO_COPY_THRESHOLD) { return bulkString(std::string_view(*value)); }
+
+    header('$', static_cast<long long>(value->size()));
+    out.append(std::move(value));
+    out.append(CRLF);
+}
+
+void ReplyWriter::doubleValue(double value) {
+    // Long enough for the sign, 17 significant digits, the point and an exponent. Infinities read "inf" and "-inf".
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    std::string_view formatted(buffer, end - buffer);
+
+    if (protocol < 3) { return bulkString(formatted); }
+
+    out.append(std::string_view(","));
+    out.append(formatted);
+    out.append(CRLF);
+}
+
+void ReplyWriter::arrayHeader(size_t length) { header('*', static_cast<long long>(length)); }
+
+void ReplyWriter::mapHeader(size_t length) {
+    if (protocol >= 3) { return header('%', static_cast<long long>(length)); }
+
+    header('*', static_cast<long long>(2 * length));
+}
+
+void ReplyWriter::setHeader(size_t length) { header(protocol >= 3 ? '~' : '*', static_cast<long long>(length)); }
+
+void ReplyWriter::pushHeader(size_t length) { header('>', static_cast<long long>(length)); }
+
+void ReplyWriter::header(char prefix, long long value) {
+    // Prefix, sign and digits of any 64-bit value, and the CRLF.
+    char buffer[24];
+    buffer[0] = prefix;
+    auto [end, ec] = std::to_chars(buffer + 1, buffer + sizeof(buffer) - 2, value);
+    *end++ = '\r';
+    *end++ = '\n';
+    out.append(std::string_view(buffer, end - buffer));
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "output_buffer.h"
+
+/**
+ * Pre-encoded replies, appended to the output as is.
+ */
+namespace Replies {
+    constexpr std::string_view OK = "+OK\r\n";
+    constexpr std::string_view PONG = "+PONG\r\n";
+    constexpr std::string_view QUEUED = "+QUEUED\r\n";
+    constexpr std::string_view NIL = "$-1\r\n";
+    constexpr std::string_view NULL_ARRAY = "*-1\r\n";
+    constexpr std::string_view NULL_RESP3 = "_\r\n";
+    constexpr std::string_view EMPTY_ARRAY = "*0\r\n";
+    constexpr std::string_view EMPTY_BULK = "$0\r\n\r\n";
+
+    constexpr std::string_view SYNTAX_ERROR = "-ERR syntax error\r\n";
+    constexpr std::string_view NOT_INTEGER_ERROR = "-ERR value is not an integer or out of range\r\n";
+    constexpr std::string_view NOT_FLOAT_ERROR = "-ERR value is not a valid float\r\n";
+    constexpr std::string_view WRONG_TYPE_ERROR =
+            "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+    constexpr std::string_view EMPTY_COMMAND_ERROR = "-ERR empty command\r\n";
+    constexpr std::string_view UNSUPPORTED_COMMAND_ERROR = "-ERR unsupported command\r\n";
+}// namespace Replies
+
+/**
+ * Encodes RESP replies straight into a connection's output buffer, without building intermediate strings. Types that
+ * differ between RESP2 and RESP3 are encoded for the protocol version the client negotiated with HELLO.
+ */
+class ReplyWriter {
+public:
+    explicit ReplyWriter(OutputBuffer &out, int protocol = 2) : out(out), protocol(protocol) {}
+
+    /**
+     * Switches the encoding to another protocol version, for HELLO.
+     */
+    void setProtocol(int version) { protocol = version; }
+
+    /**
+     * Appends a pre-encoded reply, see Replies.
+     */
+    void raw(std::string_view encoded) { out.append(encoded); }
+
+    void simpleString(std::string_view str);
+
+    /**
+     * Appends an error reply, message includes the error code, e.g. "ERR syntax error".
+     */
+    void error(std::string_view message);
+
+    /**
+     * Appends "ERR wrong number of arguments for '<command>' command".
+     */
+    void wrongArity(std::string_view command);
+
+    void integer(long long value);
+    void bulkString(std::string_view str);
+
+    /**
+     * Appends the decimal form of an integer as a bulk string, for values stored as integers.
+     */
+    void bulkInteger(long long value);
+
+    /**
+     * Appends a stored value, by reference if it is large enough for copying to be slower than an extra iovec.
+     */
+    void bulkString(std::shared_ptr<const std::string> value);
+
+    void null() { raw(protocol >= 3 ? Replies::NULL_RESP3 : Replies::NIL); }
+    void nullArray() { raw(protocol >= 3 ? Replies::NULL_RESP3 : Replies::NULL_ARRAY); }
+    void arrayHeader(size_t length);
+
+    /**
+     * A floating point number in its shortest exact form, as a double in RESP3 and a bulk string in RESP2.
+     */
+    void doubleValue(double value);
+
+    /**
+     * Starts a map of length key-value pairs, a flat array of twice the length in RESP2.
+     */
+    void mapHeader(size_t length);
+
+    /**
+     * Starts a set of length elements, an array in RESP2.
+     */
+    void setHeader(size_t length);
+
+    /**
+     * Starts an out-of-band push message, RESP3 only.
+     */
+    void pushHeader(size_t length);
+
+    // Values at least this large are referenced by the reply instead of being copied into it.
+    static constexpr size_t ZERO_COPY_THRESHOLD = 16 * 1024;
+
+private:
+    void header(char prefix, long long value);
+
+    OutputBuffer &out;
+    int protocol;
+};
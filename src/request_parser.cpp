@@ -0,0 +1,149 @@
+#include "request_parser.h"
+
+#include <algorithm>
+
+RequestParser::Status RequestParser::parse(std::span<const uint8_t> buffer) {
+    if (multibulkLength < 0) {
+        if (buffer.empty()) { return Status::Incomplete; }
+        if (buffer[0] != '*') {
+            return fail("Protocol error: expected '*', got '" + std::string(1, static_cast<char>(buffer[0])) + "'");
+        }
+
+        auto status = parseHeader(buffer, '*', multibulkLength);
+        if (status != Status::Complete) { return status; }
+
+        if (multibulkLength > MAX_MULTIBULK_LENGTH) { return fail("Protocol error: invalid multibulk length"); }
+
+        // "*0" and "*-1" are empty requests.
+        if (multibulkLength <= 0) { multibulkLength = 0; }
+
+        // Reserve lazily for large counts, the arguments might never arrive.
+        offsets.reserve(static_cast<size_t>(std::min(multibulkLength, 1024LL)));
+    }
+
+    while (offsets.size() < static_cast<size_t>(multibulkLength)) {
+        if (bulkLength < 0) {
+            if (position >= buffer.size()) { return Status::Incomplete; }
+            if (buffer[position] != '$') {
+                return fail("Protocol error: expected '$', got '" +
+                            std::string(1, static_cast<char>(buffer[position])) + "'");
+            }
+
+            auto status = parseHeader(buffer, '$', bulkLength);
+            if (status != Status::Complete) { return status; }
+
+            if (bulkLength < 0 || static_cast<size_t>(bulkLength) > maxBulkLength) {
+                return fail("Protocol error: invalid bulk length");
+            }
+
+            // Allocated once, the caller receives the rest of the argument straight into it.
+            if (bulkLength >= LARGE_ARGUMENT_THRESHOLD &&
+                buffer.size() - position < static_cast<size_t>(bulkLength) + 2) {
+                receiving = std::make_shared<std::string>();
+                receiving->resize_and_overwrite(bulkLength, [](char *, size_t n) { return n; });
+                received = 0;
+            }
+        }
+
+        auto length = static_cast<size_t>(bulkLength);
+
+        if (receiving) {
+            // Take over the bytes of the argument that were read before its buffer existed.
+            size_t available = std::min(buffer.size() - position, length - received);
+            std::copy_n(buffer.data() + position, available, receiving->data() + received);
+            received += available;
+            position += available;
+
+            if (received < length || buffer.size() - position < 2) { return Status::Incomplete; }
+
+            if (buffer[position] != '\r' || buffer[position + 1] != '\n') {
+                return fail("Protocol error: bulk string not terminated by CRLF");
+            }
+
+            buffers.resize(offsets.size() + 1);
+            buffers.back() = std::move(receiving);
+            offsets.emplace_back(LARGE_ARGUMENT, length);
+            position += 2;
+            bulkLength = -1;
+            continue;
+        }
+
+        // The argument's bytes are only looked at once all of them, and the trailing CRLF, have arrived.
+        if (buffer.size() - position < length + 2) { return Status::Incomplete; }
+
+        if (buffer[position + length] != '\r' || buffer[position + length + 1] != '\n') {
+            return fail("Protocol error: bulk string not terminated by CRLF");
+        }
+
+        offsets.emplace_back(position, length);
+        position += length + 2;
+        bulkLength = -1;
+    }
+
+    arguments.clear();
+    arguments.reserve(offsets.size());
+    for (auto [offset, length]: offsets) {
+        if (offset == LARGE_ARGUMENT) {
+            arguments.emplace_back(*buffers[arguments.size()]);
+        } else {
+            arguments.emplace_back(reinterpret_cast<const char *>(buffer.data()) + offset, length);
+        }
+    }
+
+    if (!buffers.empty()) { buffers.resize(offsets.size()); }
+
+    return Status::Complete;
+}
+
+std::span<uint8_t> RequestParser::bulkDestination() {
+    if (!receiving) return {};
+    return {reinterpret_cast<uint8_t *>(receiving->data()) + received, receiving->size() - received};
+}
+
+void RequestParser::reset() {
+    position = 0;
+    multibulkLength = -1;
+    bulkLength = -1;
+    offsets.clear();
+    arguments.clear();
+    buffers.clear();
+    receiving.reset();
+}
+
+RequestParser::Status RequestParser::parseHeader(std::span<const uint8_t> buffer, char prefix, long long &value) {
+    auto invalid = [&] {
+        return fail(prefix == '*' ? "Protocol error: invalid multibulk length" : "Protocol error: invalid bulk length");
+    };
+
+    // Decode the digits while looking for the CRLF, a single pass over the header. A header is too short for the
+    // vector CRLF scan to pay off.
+    size_t i = position + 1;
+    bool negative = i < buffer.size() && buffer[i] == '-';
+    if (negative) { ++i; }
+
+    size_t digitsStart = i;
+    long long result = 0;
+
+    for (; i < buffer.size() && buffer[i] >= '0' && buffer[i] <= '9'; ++i) {
+        if (__builtin_mul_overflow(result, 10, &result) || __builtin_add_overflow(result, buffer[i] - '0', &result)) {
+            break;
+        }
+    }
+
+    // Leading zeros never overflow, so the header is bounded to be rejected once it cannot end in time.
+    if (i - (position + 1) > MAX_HEADER_LENGTH - 2) { return invalid(); }
+
+    // Still receiving the header: only digits so far.
+    if (i == buffer.size() || (buffer[i] == '\r' && i + 1 == buffer.size())) { return Status::Incomplete; }
+
+    if (i == digitsStart || buffer[i] != '\r' || buffer[i + 1] != '\n') { return invalid(); }
+
+    value = negative ? -result : result;
+    position = i + 2;
+    return Status::Complete;
+}
+
+RequestParser::Status RequestParser::fail(std::string message) {
+    errorMessage = std::move(message);
+    return Status::Error;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Incremental parser for client requests, i.e. RESP arrays of bulk strings.
+ *
+ * Parsing resumes where the previous call stopped, so a request that arrives over many reads is scanned only once.
+ * The arguments of a parsed request are views into the caller's buffer, no bytes are copied. Malformed input is
+ * reported through Status::Error instead of an exception.
+ *
+ * Large arguments are the exception to parsing in place: once the header of one has been parsed, the parser
+ * allocates a buffer for it, and the caller receives the rest of the argument straight into that buffer instead of
+ * its read buffer. Commands can keep that buffer as the stored value, so a large SET is never copied.
+ */
+class RequestParser {
+public:
+    enum class Status { Complete, Incomplete, Error };
+
+    explicit RequestParser(size_t maxBulkLength = DEFAULT_MAX_BULK_LENGTH) : maxBulkLength(maxBulkLength) {}
+
+    /**
+     * Continues parsing the request at the start of buffer. The buffer has to start with the same bytes as in the
+     * previous call, possibly followed by new ones, but it may have moved in memory.
+     *
+     * On Complete, args() views the arguments of the request, in buffer or in argumentBuffers(), and length() is
+     * its encoded size in buffer.
+     * On Error, error() describes the problem.
+     */
+    Status parse(std::span<const uint8_t> buffer);
+
+    const std::vector<std::string_view> &args() const { return arguments; }
+
+    /**
+     * Buffers backing the large arguments of a complete request, indexed like args(), null for arguments viewing
+     * the caller's buffer. Empty if the request has no large argument.
+     */
+    std::vector<std::shared_ptr<std::string>> &argumentBuffers() { return buffers; }
+
+    /**
+     * Where the next bytes from the client go while a large argument is being received, empty otherwise. Only
+     * non-empty after parse() consumed every byte of the caller's buffer.
+     */
+    std::span<uint8_t> bulkDestination();
+
+    /**
+     * Records that the caller wrote n bytes to the start of bulkDestination().
+     */
+    void bulkReceived(size_t n) { received += n; }
+
+    size_t length() const { return position; }
+    const std::string &error() const { return errorMessage; }
+
+    /**
+     * Prepares the parser for the next request.
+     */
+    void reset();
+
+    static constexpr long long MAX_MULTIBULK_LENGTH = 1024 * 1024;
+    static constexpr size_t DEFAULT_MAX_BULK_LENGTH = 512 * 1024 * 1024;
+
+    // Arguments at least this large are received into their own buffer.
+    static constexpr long long LARGE_ARGUMENT_THRESHOLD = 32 * 1024;
+
+    // Longest "<number>\r\n" after a header's prefix, enough for any 64-bit length.
+    static constexpr size_t MAX_HEADER_LENGTH = 32;
+
+private:
+    /**
+     * Parses the "<prefix><number>\r\n" line at the current position and advances past it. The value is only
+     * assigned once the line is complete.
+     */
+    Status parseHeader(std::span<const uint8_t> buffer, char prefix, long long &value);
+
+    Status fail(std::string message);
+
+    // Bytes of the current request parsed so far.
+    size_t position = 0;
+
+    // Number of arguments of the current request, -1 until its header has been parsed.
+    long long multibulkLength = -1;
+
+    // Length of the argument being parsed, -1 until its header has been parsed.
+    long long bulkLength = -1;
+
+    // Offset and length of every parsed argument, turned into views once the request is complete.
+    std::vector<std::pair<size_t, size_t>> offsets;
+    std::vector<std::string_view> arguments;
+    std::string errorMessage;
+    size_t maxBulkLength;
+
+    // Offset of arguments that live in their own buffer.
+    static constexpr size_t LARGE_ARGUMENT = SIZE_MAX;
+
+    std::vector<std::shared_ptr<std::string>> buffers;
+    std::shared_ptr<std::string> receiving;
+    size_t received = 0;
+};
@@ -0,0 +1,163 @@
+#include "set.h"
+
+#include <algorithm>
+#include <charconv>
+
+#include "datastore.h"
+#include "worker_pool.h"
+
+bool Set::add(std::string_view member, size_t maxIntsetEntries) {
+    if (!table) {
+        auto value = parseCanonicalInteger(member);
+        if (value && (intset.size() < maxIntsetEntries || intset.contains(*value))) { return intset.insert(*value); }
+
+        convertToTable();
+    }
+
+    auto [it, inserted] = table->emplace(member);
+    if (inserted) { tableBytes += member.size(); }
+    return inserted;
+}
+
+bool Set::remove(std::string_view member) {
+    if (!table) {
+        auto value = parseCanonicalInteger(member);
+        return value && intset.remove(*value);
+    }
+
+    auto it = table->find(member);
+    if (it == table->end()) { return false; }
+
+    tableBytes -= it->size();
+    table->erase(it);
+    return true;
+}
+
+bool Set::contains(std::string_view member) const {
+    if (table) { return table->contains(member); }
+
+    auto value = parseCanonicalInteger(member);
+    return value && intset.contains(*value);
+}
+
+bool Set::containsInteger(long long value) const {
+    if (!table) { return intset.contains(value); }
+
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return table->contains(std::string_view(buffer, end - buffer));
+}
+
+std::vector<std::string> Set::members() const {
+    std::vector<std::string> members;
+    members.reserve(size());
+
+    if (table) {
+        members.assign(table->begin(), table->end());
+    } else {
+        for (auto value: intset.members()) { members.push_back(std::to_string(value)); }
+    }
+
+    return members;
+}
+
+std::vector<std::string> Set::intersection(std::vector<const Set *> sets, WorkerPool &workers) {
+    std::sort(sets.begin(), sets.end(), [](const Set *a, const Set *b) { return a->size() < b->size(); });
+    const Set &smallest = *sets.front();
+    std::span<const Set *const> others(sets.begin() + 1, sets.end());
+
+    // One chunk per thread at most, the calling thread being one of them.
+    size_t numChunks = std::clamp<size_t>(smallest.size() / PARALLEL_CHUNK_SIZE, 1, workers.size() + 1);
+    if (numChunks == 1) { return smallest.intersectChunk(others, 0, 1); }
+
+    // The sets are only read, concurrently, by the chunks.
+    std::vector<std::vector<std::string>> chunks(numChunks);
+    workers.run(numChunks, [&](size_t i) { chunks[i] = smallest.intersectChunk(others, i, numChunks); });
+
+    std::vector<std::string> members = std::move(chunks.front());
+    for (size_t i = 1; i < numChunks; ++i) {
+        members.insert(members.end(), std::make_move_iterator(chunks[i].begin()),
+                       std::make_move_iterator(chunks[i].end()));
+    }
+    return members;
+}
+
+std::vector<std::string> Set::unionOf(std::span<const Set *const> sets) {
+    Table combined;
+    for (const auto *set: sets) {
+        if (set->table) {
+            combined.insert(set->table->begin(), set->table->end());
+        } else {
+            for (auto value: set->intset.members()) { combined.insert(std::to_string(value)); }
+        }
+    }
+
+    std::vector<std::string> members;
+    members.reserve(combined.size());
+    while (!combined.empty()) { members.push_back(std::move(combined.extract(combined.begin()).value())); }
+    return members;
+}
+
+std::vector<std::string> Set::difference(const Set &first, std::span<const Set *const> others) {
+    std::vector<std::string> members;
+
+    if (first.table) {
+        for (const auto &member: *first.table) {
+            if (std::none_of(others.begin(), others.end(), [&](const Set *set) { return set->contains(member); })) {
+                members.push_back(member);
+            }
+        }
+        return members;
+    }
+
+    for (auto value: first.intset.members()) {
+        if (std::none_of(others.begin(), others.end(), [&](const Set *set) { return set->containsInteger(value); })) {
+            members.push_back(std::to_string(value));
+        }
+    }
+    return members;
+}
+
+std::vector<std::string> Set::intersectChunk(std::span<const Set *const> others, size_t chunk,
+                                             size_t numChunks) const {
+    std::vector<std::string> members;
+
+    // A hash table is split by buckets, an intset by position.
+    if (table) {
+        auto inAllOthers = [&](const std::string &member) {
+            return std::all_of(others.begin(), others.end(), [&](const Set *set) { return set->contains(member); });
+        };
+
+        size_t numBuckets = table->bucket_count();
+        for (size_t bucket = numBuckets * chunk / numChunks; bucket < numBuckets * (chunk + 1) / numChunks; ++bucket) {
+            for (auto it = table->begin(bucket); it != table->end(bucket); ++it) {
+                if (inAllOthers(*it)) { members.push_back(*it); }
+            }
+        }
+        return members;
+    }
+
+    auto inAllOthers = [&](long long value) {
+        return std::all_of(others.begin(), others.end(), [&](const Set *set) { return set->containsInteger(value); });
+    };
+
+    auto values = intset.members();
+    for (size_t i = values.size() * chunk / numChunks; i < values.size() * (chunk + 1) / numChunks; ++i) {
+        if (inAllOthers(values[i])) { members.push_back(std::to_string(values[i])); }
+    }
+    return members;
+}
+
+void Set::convertToTable() {
+    auto converted = std::make_unique<Table>();
+    converted->reserve(intset.size() + 1);
+
+    for (auto value: intset.members()) {
+        auto member = std::to_string(value);
+        tableBytes += member.size();
+        converted->insert(std::move(member));
+    }
+
+    table = std::move(converted);
+    intset = IntSet();
+}
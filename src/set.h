@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "intset.h"
+#include "string_view_hash.h"
+
+class WorkerPool;
+
+/**
+ * A set of byte strings. A set of integers, each in its canonical form, is kept as an IntSet until it grows past
+ * set-max-intset-entries or a member that is not an integer is added. It is then converted, for good, to a hash table.
+ */
+class Set {
+public:
+    // Default of set-max-intset-entries, same as Redis.
+    static constexpr size_t DEFAULT_MAX_INTSET_ENTRIES = 512;
+
+    // Members of the smallest set an intersection hands to each task. Smaller intersections run on the calling thread.
+    static constexpr size_t PARALLEL_CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * @return Whether the member was added, false if it already was one.
+     */
+    bool add(std::string_view member, size_t maxIntsetEntries);
+
+    /**
+     * @return Whether the member existed.
+     */
+    bool remove(std::string_view member);
+
+    bool contains(std::string_view member) const;
+
+    // Same as contains() with the canonical form of value, without formatting it for an intset.
+    bool containsInteger(long long value) const;
+
+    // Copies the members, in no particular order.
+    std::vector<std::string> members() const;
+
+    size_t size() const { return table ? table->size() : intset.size(); }
+    bool empty() const { return size() == 0; }
+    bool isIntSet() const { return !table; }
+
+    // Bytes of the members.
+    size_t bytes() const { return table ? tableBytes : intset.size() * sizeof(long long); }
+
+    /**
+     * @return The members all sets contain. The smallest set is walked and every other set probed for its members,
+     * split across the workers and the calling thread if the smallest set spans several PARALLEL_CHUNK_SIZE chunks.
+     * The sets must not change until it returns.
+     */
+    static std::vector<std::string> intersection(std::vector<const Set *> sets, WorkerPool &workers);
+
+    /**
+     * @return The members any of the sets contains.
+     */
+    static std::vector<std::string> unionOf(std::span<const Set *const> sets);
+
+    /**
+     * @return The members of first that none of the others contains.
+     */
+    static std::vector<std::string> difference(const Set &first, std::span<const Set *const> others);
+
+private:
+    using Table = std::unordered_set<std::string, StringViewHash, std::equal_to<>>;
+
+    IntSet intset;
+    std::unique_ptr<Table> table;
+    size_t tableBytes = 0;
+
+    /**
+     * @return The members in the given chunk of this set, out of numChunks of about the same size, that all others
+     * contain.
+     */
+    std::vector<std::string> intersectChunk(std::span<const Set *const> others, size_t chunk, size_t numChunks) const;
+
+    void convertToTable();
+};
@@ -0,0 +1,172 @@
+#include "skiplist.h"
+
+#include <new>
+#include <random>
+
+SkipList::SkipList() : head(createNode(MAX_LEVEL, 0, {})) {
+    for (int i = 0; i < MAX_LEVEL; ++i) { head->levels()[i] = {nullptr, 0}; }
+}
+
+SkipList::~SkipList() {
+    Node *node = head;
+    while (node) {
+        Node *next = node->next();
+        destroyNode(node);
+        node = next;
+    }
+}
+
+SkipList::Node *SkipList::insert(double score, std::string_view member) {
+    Node *update[MAX_LEVEL];
+    size_t ranks[MAX_LEVEL];
+    findPredecessors(score, member, update, ranks);
+
+    int height = randomLevel();
+    if (height > level) {
+        for (int i = level; i < height; ++i) {
+            ranks[i] = 0;
+            update[i] = head;
+            update[i]->levels()[i].span = length;
+        }
+        level = height;
+    }
+
+    Node *node = createNode(height, score, member);
+    for (int i = 0; i < height; ++i) {
+        auto &link = update[i]->levels()[i];
+        node->levels()[i].forward = link.forward;
+        link.forward = node;
+
+        // The predecessor's span is split around the new node.
+        node->levels()[i].span = link.span - (ranks[0] - ranks[i]);
+        link.span = ranks[0] - ranks[i] + 1;
+    }
+
+    // Links above the node's height now skip it too.
+    for (int i = height; i < level; ++i) { ++update[i]->levels()[i].span; }
+
+    node->backward = update[0] == head ? nullptr : update[0];
+    if (node->next()) {
+        node->next()->backward = node;
+    } else {
+        tail = node;
+    }
+
+    ++length;
+    return node;
+}
+
+bool SkipList::remove(double score, std::string_view member) {
+    Node *update[MAX_LEVEL];
+    size_t ranks[MAX_LEVEL];
+    findPredecessors(score, member, update, ranks);
+
+    Node *node = update[0]->next();
+    if (!node || node->score != score || node->member != member) { return false; }
+
+    for (int i = 0; i < level; ++i) {
+        auto &link = update[i]->levels()[i];
+        if (link.forward == node) {
+            link.span += node->levels()[i].span - 1;
+            link.forward = node->levels()[i].forward;
+        } else {
+            --link.span;
+        }
+    }
+
+    if (node->next()) {
+        node->next()->backward = node->backward;
+    } else {
+        tail = node->backward;
+    }
+
+    while (level > 1 && !head->levels()[level - 1].forward) { --level; }
+    --length;
+
+    destroyNode(node);
+    return true;
+}
+
+size_t SkipList::rank(double score, std::string_view member) const {
+    Node *update[MAX_LEVEL];
+    size_t ranks[MAX_LEVEL];
+    findPredecessors(score, member, update, ranks);
+
+    // The member follows its predecessor, ranked from 1 with the head at 0.
+    return ranks[0];
+}
+
+SkipList::Node *SkipList::at(size_t rank) const {
+    // Ranked from 1 here, with the head at 0.
+    size_t target = rank + 1;
+    size_t traversed = 0;
+
+    Node *node = head;
+    for (int i = level - 1; i >= 0; --i) {
+        while (node->levels()[i].forward && traversed + node->levels()[i].span <= target) {
+            traversed += node->levels()[i].span;
+            node = node->levels()[i].forward;
+        }
+        if (traversed == target) { return node; }
+    }
+
+    return nullptr;
+}
+
+SkipList::Node *SkipList::firstInRange(const ScoreRange &range) const {
+    if (range.isEmpty() || !tail || !range.aboveMin(tail->score)) { return nullptr; }
+
+    Node *node = head;
+    for (int i = level - 1; i >= 0; --i) {
+        while (node->levels()[i].forward && !range.aboveMin(node->levels()[i].forward->score)) {
+            node = node->levels()[i].forward;
+        }
+    }
+
+    node = node->next();
+    return node && range.belowMax(node->score) ? node : nullptr;
+}
+
+SkipList::Node *SkipList::lastInRange(const ScoreRange &range) const {
+    if (range.isEmpty() || !first() || !range.belowMax(first()->score)) { return nullptr; }
+
+    Node *node = head;
+    for (int i = level - 1; i >= 0; --i) {
+        while (node->levels()[i].forward && range.belowMax(node->levels()[i].forward->score)) {
+            node = node->levels()[i].forward;
+        }
+    }
+
+    return node != head && range.aboveMin(node->score) ? node : nullptr;
+}
+
+SkipList::Node *SkipList::createNode(uint32_t height, double score, std::string_view member) {
+    void *memory = ::operator new(sizeof(Node) + height * sizeof(Level));
+    return new (memory) Node{std::string(member), score, nullptr, height};
+}
+
+void SkipList::destroyNode(Node *node) {
+    node->~Node();
+    ::operator delete(node);
+}
+
+int SkipList::randomLevel() {
+    // Each level is kept with a probability of 1/4, from two random bits per level.
+    thread_local std::minstd_rand random(std::random_device{}());
+
+    int height = 1;
+    while (height < MAX_LEVEL && (random() & 3) == 0) { ++height; }
+    return height;
+}
+
+void SkipList::findPredecessors(double score, std::string_view member, Node **update, size_t *ranks) const {
+    Node *node = head;
+    for (int i = level - 1; i >= 0; --i) {
+        ranks[i] = i == level - 1 ? 0 : ranks[i + 1];
+        while (node->levels()[i].forward && precedes(node->levels()[i].forward, score, member)) {
+            ranks[i] += node->levels()[i].span;
+            node = node->levels()[i].forward;
+        }
+        update[i] = node;
+    }
+}
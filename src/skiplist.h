@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * A range of scores, each end inclusive unless marked exclusive, as in ZRANGEBYSCORE's "(1.5".
+ */
+struct ScoreRange {
+    double min;
+    double max;
+    bool minExclusive = false;
+    bool maxExclusive = false;
+
+    bool aboveMin(double score) const { return minExclusive ? score > min : score >= min; }
+    bool belowMax(double score) const { return maxExclusive ? score < max : score <= max; }
+    bool contains(double score) const { return aboveMin(score) && belowMax(score); }
+
+    // Whether no score at all lies in the range.
+    bool isEmpty() const { return min > max || (min == max && (minExclusive || maxExclusive)); }
+};
+
+/**
+ * Members ordered by score, then by their bytes, like Redis' zskiplist. Every node links to the next one on each of
+ * its levels and counts the nodes each link skips, so a member is found, inserted or removed in O(log n) and so is the
+ * node at a rank. A node is one allocation holding its member, score and levels, so a search touches one cache line per
+ * visited node for short members.
+ *
+ * The list owns its nodes. A node, and thus its member's bytes, stays at its address until it is removed.
+ */
+class SkipList {
+public:
+    // Same as Redis: enough levels for 2^64 nodes with a quarter of them promoted on each level.
+    static constexpr int MAX_LEVEL = 32;
+
+    struct Level;
+
+    struct Node {
+        std::string member;
+        double score;
+        Node *backward;
+        uint32_t height;
+
+        Node *next() const { return levels()[0].forward; }
+        Node *prev() const { return backward; }
+
+        Level *levels() { return reinterpret_cast<Level *>(this + 1); }
+        const Level *levels() const { return reinterpret_cast<const Level *>(this + 1); }
+    };
+
+    struct Level {
+        Node *forward;
+        // Number of nodes the link advances by, for ranks.
+        size_t span;
+    };
+
+    SkipList();
+    ~SkipList();
+
+    SkipList(const SkipList &) = delete;
+    SkipList &operator=(const SkipList &) = delete;
+
+    /**
+     * Inserts the member, which must not be in the list yet.
+     */
+    Node *insert(double score, std::string_view member);
+
+    /**
+     * Removes the member stored with score.
+     *
+     * @return Whether it was found.
+     */
+    bool remove(double score, std::string_view member);
+
+    /**
+     * @return The zero-based rank of the member stored with score, which must be in the list.
+     */
+    size_t rank(double score, std::string_view member) const;
+
+    /**
+     * @return The node at the zero-based rank, which must be less than size().
+     */
+    Node *at(size_t rank) const;
+
+    /**
+     * @return The first or last node with a score in range, or nullptr if there is none.
+     */
+    Node *firstInRange(const ScoreRange &range) const;
+    Node *lastInRange(const ScoreRange &range) const;
+
+    Node *first() const { return head->next(); }
+    Node *last() const { return tail; }
+
+    size_t size() const { return length; }
+
+private:
+    Node *head;
+    Node *tail = nullptr;
+    size_t length = 0;
+    // Levels in use, at least 1.
+    int level = 1;
+
+    static Node *createNode(uint32_t height, double score, std::string_view member);
+    static void destroyNode(Node *node);
+    static int randomLevel();
+
+    // Whether node sorts before the member stored with score.
+    static bool precedes(const Node *node, double score, std::string_view member) {
+        return node->score < score || (node->score == score && node->member < member);
+    }
+
+    /**
+     * Finds the last node before the member on each level, and on how many nodes each of them is ranked, with the
+     * head at 0.
+     */
+    void findPredecessors(double score, std::string_view member, Node **update, size_t *ranks) const;
+};
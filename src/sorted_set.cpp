@@ -0,0 +1,223 @@
+#include "sorted_set.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    std::string_view encodeScore(const double &score) {
+        return {reinterpret_cast<const char *>(&score), sizeof(score)};
+    }
+
+    double decodeScore(std::string_view bytes) {
+        double score;
+        std::memcpy(&score, bytes.data(), sizeof(score));
+        return score;
+    }
+
+    // The packed encoding sorts like the skiplist: by score, then by member.
+    bool sortsBefore(double score, std::string_view member, double otherScore, std::string_view otherMember) {
+        return score < otherScore || (score == otherScore && member < otherMember);
+    }
+}// namespace
+
+template<typename Fn>
+void SortedSet::forEachPacked(Fn &&fn) const {
+    for (size_t offset = 0; offset < packed.size();) {
+        auto member = Listpack::frameAt(packed, offset);
+        auto score = Listpack::frameAt(packed, member.end());
+        if (!fn(member.element, decodeScore(score.element), offset)) { return; }
+        offset = score.end();
+    }
+}
+
+bool SortedSet::set(std::string_view member, double score, const ListpackLimits &limits) {
+    if (!list && member.size() > limits.maxValue) { convertToList(); }
+
+    if (!list) {
+        if (auto position = findPacked(member)) {
+            if (position->score == score) { return false; }
+
+            // Moved to where the new score sorts, the entries in between shift.
+            remove(member);
+            insertPacked(member, score);
+            return false;
+        }
+
+        if (packedCount < limits.maxEntries) {
+            insertPacked(member, score);
+            return true;
+        }
+
+        convertToList();
+    }
+
+    auto it = index->find(member);
+    if (it != index->end()) {
+        auto *node = it->second;
+        if (node->score == score) { return false; }
+
+        // The index views the node's member, so it is re-pointed at the new node.
+        index->erase(it);
+        list->remove(node->score, member);
+        auto *moved = list->insert(score, member);
+        index->emplace(moved->member, moved);
+        return false;
+    }
+
+    auto *node = list->insert(score, member);
+    index->emplace(node->member, node);
+    listBytes += member.size() + sizeof(double);
+    return true;
+}
+
+bool SortedSet::remove(std::string_view member) {
+    if (list) {
+        auto it = index->find(member);
+        if (it == index->end()) { return false; }
+
+        double score = it->second->score;
+        index->erase(it);
+        list->remove(score, member);
+        listBytes -= member.size() + sizeof(double);
+        return true;
+    }
+
+    auto position = findPacked(member);
+    if (!position) { return false; }
+
+    auto memberFrame = Listpack::frameAt(packed, position->offset);
+    auto scoreFrame = Listpack::frameAt(packed, memberFrame.end());
+    packed.erase(position->offset, scoreFrame.end() - position->offset);
+    --packedCount;
+    return true;
+}
+
+std::optional<double> SortedSet::score(std::string_view member) const {
+    if (list) {
+        auto it = index->find(member);
+        if (it == index->end()) { return std::nullopt; }
+        return it->second->score;
+    }
+
+    auto position = findPacked(member);
+    if (!position) { return std::nullopt; }
+    return position->score;
+}
+
+std::optional<size_t> SortedSet::rank(std::string_view member, bool reverse) const {
+    std::optional<size_t> rank;
+    if (list) {
+        auto it = index->find(member);
+        if (it == index->end()) { return std::nullopt; }
+        rank = list->rank(it->second->score, member);
+    } else {
+        auto position = findPacked(member);
+        if (!position) { return std::nullopt; }
+        rank = position->index;
+    }
+
+    return reverse ? size() - 1 - *rank : *rank;
+}
+
+std::vector<SortedSet::Entry> SortedSet::range(size_t start, size_t end, bool reverse) const {
+    std::vector<Entry> entries;
+    entries.reserve(end - start + 1);
+
+    if (list) {
+        auto *node = list->at(reverse ? size() - 1 - start : start);
+        for (size_t i = start; i <= end; ++i) {
+            entries.emplace_back(node->member, node->score);
+            node = reverse ? node->prev() : node->next();
+        }
+        return entries;
+    }
+
+    // Packed entries are only walked forward, a reverse range is collected in order and flipped.
+    size_t first = reverse ? size() - 1 - end : start;
+    size_t last = reverse ? size() - 1 - start : end;
+    size_t i = 0;
+    forEachPacked([&](std::string_view member, double score, size_t) {
+        if (i >= first) { entries.emplace_back(member, score); }
+        return ++i <= last;
+    });
+
+    if (reverse) { std::reverse(entries.begin(), entries.end()); }
+    return entries;
+}
+
+std::vector<SortedSet::Entry> SortedSet::rangeByScore(const ScoreRange &range, bool reverse, size_t offset,
+                                                      size_t count) const {
+    std::vector<Entry> entries;
+    if (count == 0 || range.isEmpty()) { return entries; }
+
+    if (list) {
+        auto *node = reverse ? list->lastInRange(range) : list->firstInRange(range);
+        for (; node && offset > 0; --offset) { node = reverse ? node->prev() : node->next(); }
+
+        while (node && entries.size() < count && range.contains(node->score)) {
+            entries.emplace_back(node->member, node->score);
+            node = reverse ? node->prev() : node->next();
+        }
+        return entries;
+    }
+
+    // Small enough to collect every entry in range and apply the limit after.
+    forEachPacked([&](std::string_view member, double score, size_t) {
+        if (range.contains(score)) { entries.emplace_back(member, score); }
+        return range.belowMax(score);
+    });
+
+    if (reverse) { std::reverse(entries.begin(), entries.end()); }
+    if (offset >= entries.size()) { return {}; }
+
+    entries.erase(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(offset));
+    if (entries.size() > count) { entries.resize(count); }
+    return entries;
+}
+
+std::optional<SortedSet::PackedPosition> SortedSet::findPacked(std::string_view member) const {
+    std::optional<PackedPosition> found;
+    size_t index = 0;
+    forEachPacked([&](std::string_view candidate, double score, size_t offset) {
+        if (candidate == member) {
+            found = PackedPosition{offset, score, index};
+            return false;
+        }
+        ++index;
+        return true;
+    });
+    return found;
+}
+
+void SortedSet::insertPacked(std::string_view member, double score) {
+    size_t at = packed.size();
+    forEachPacked([&](std::string_view candidate, double candidateScore, size_t offset) {
+        if (!sortsBefore(score, member, candidateScore, candidate)) { return true; }
+        at = offset;
+        return false;
+    });
+
+    std::string framed;
+    Listpack::append(framed, member);
+    Listpack::append(framed, encodeScore(score));
+    packed.insert(at, framed);
+    ++packedCount;
+}
+
+void SortedSet::convertToList() {
+    auto converted = std::make_unique<SkipList>();
+    auto convertedIndex = std::make_unique<Index>();
+    convertedIndex->reserve(packedCount);
+
+    forEachPacked([&](std::string_view member, double score, size_t) {
+        auto *node = converted->insert(score, member);
+        convertedIndex->emplace(node->member, node);
+        listBytes += member.size() + sizeof(double);
+        return true;
+    });
+
+    list = std::move(converted);
+    index = std::move(convertedIndex);
+    packed = std::string();
+    packedCount = 0;
+}
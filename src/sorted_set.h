@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "listpack.h"
+#include "skiplist.h"
+#include "string_view_hash.h"
+
+/**
+ * Members with scores, ordered by score and then by their bytes. A small set packs its members and scores, alternating
+ * and in order, into one contiguous buffer framed like a listpack, and is scanned linearly. Once it outgrows its
+ * ListpackLimits it is converted, for good, to a SkipList for ordered access plus a hash table from each member to its
+ * node, which finds a member's score in O(1).
+ */
+class SortedSet {
+public:
+    // A member and its score.
+    using Entry = std::pair<std::string, double>;
+
+    /**
+     * Sets the member's score, adding the member if it is new, and converting the set first if the member would not
+     * fit the packed encoding.
+     *
+     * @return Whether the member is new.
+     */
+    bool set(std::string_view member, double score, const ListpackLimits &limits);
+
+    /**
+     * @return Whether the member existed.
+     */
+    bool remove(std::string_view member);
+
+    std::optional<double> score(std::string_view member) const;
+
+    /**
+     * @return The zero-based rank of the member, counted from the lowest score or, if reverse is set, from the highest.
+     */
+    std::optional<size_t> rank(std::string_view member, bool reverse) const;
+
+    /**
+     * Copies the entries ranked from start to end inclusive, which must be valid ranks with start <= end, in the
+     * order of their ranks.
+     */
+    std::vector<Entry> range(size_t start, size_t end, bool reverse) const;
+
+    /**
+     * Copies up to count entries with a score in range, after skipping offset of them, from the lowest score or, if
+     * reverse is set, from the highest.
+     */
+    std::vector<Entry> rangeByScore(const ScoreRange &range, bool reverse, size_t offset, size_t count) const;
+
+    size_t size() const { return list ? list->size() : packedCount; }
+    bool empty() const { return size() == 0; }
+    bool isPacked() const { return !list; }
+
+    // Bytes of the members and scores, plus framing while packed.
+    size_t bytes() const { return list ? listBytes : packed.size(); }
+
+private:
+    // Keys view the members owned by the nodes, which stay put until removed.
+    using Index = std::unordered_map<std::string_view, SkipList::Node *, StringViewHash, std::equal_to<>>;
+
+    // A member's position in the packed encoding: the offset of its frame, its score and how many entries precede it.
+    struct PackedPosition {
+        size_t offset;
+        double score;
+        size_t index;
+    };
+
+    // Members and scores as alternating frames in order, while the set is packed. Scores are framed as their bytes.
+    std::string packed;
+    size_t packedCount = 0;
+
+    std::unique_ptr<SkipList> list;
+    std::unique_ptr<Index> index;
+    size_t listBytes = 0;
+
+    std::optional<PackedPosition> findPacked(std::string_view member) const;
+
+    // Inserts the entry at the position its score and member sort to.
+    void insertPacked(std::string_view member, double score);
+
+    // Calls fn with each packed entry in order, until it returns false.
+    template<typename Fn>
+    void forEachPacked(Fn &&fn) const;
+
+    void convertToList();
+};
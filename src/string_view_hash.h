@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+/**
+ * Transparent hash for containers of strings, used with std::equal_to<>, so they are looked up by views, e.g. into a
+ * request, without building a std::string.
+ */
+struct StringViewHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+};
@@ -1,12 +1,22 @@
 #include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <span>
 #include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include "spdlog/fmt/ranges.h"
 #include "spdlog/spdlog.h"
 
 #include "controller.h"
@@ -14,19 +24,28 @@
 #include "redis_type.h"
 #include "tcp_server.h"
 
-TCPServer::TCPServer(const std::optional<std::string> &writeAheadLogFileName) : controller{writeAheadLogFileName} {
-    m_serverFD = socket(AF_INET, SOCK_STREAM, 0);
+namespace {
+    // Event user data (epoll data.u64, io_uring user_data): a connection pointer or a listener index, tagged with
+    // the operation type in its low bits.
+    enum EventOp : uint64_t { OP_ACCEPT = 0, OP_RECV = 1, OP_SEND = 2, OP_CANCEL = 3, OP_TICK = 4, OP_WAKE = 5 };
+    constexpr uint64_t OP_MASK = 0x7;
+    constexpr int OP_BITS = 3;
 
-    if (m_serverFD < 0) { throw std::runtime_error("Failed to create server socket!"); }
+    static_assert(alignof(Connection) > OP_MASK);
 
-    int reuse = 1;
-    if (setsockopt(m_serverFD, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
-        throw std::runtime_error("Setsockopt failed!");
-    }
+    uint64_t makeUserData(Connection *conn, EventOp op) { return reinterpret_cast<uint64_t>(conn) | op; }
+    uint64_t makeListenerData(size_t listener) { return (listener << OP_BITS) | OP_ACCEPT; }
+
+    constexpr std::string_view MAX_CLIENTS_ERROR = "-ERR max number of clients reached\r\n";
+}// namespace
 
-    if (writeAheadLogFileName) {
+TCPServer::TCPServer(const ServerConfig &config)
+    : config{config},
+      controller{config.writeAheadLogFileName, config.encodingLimits, config.protoMaxBulkLen,
+                 config.setIntersectionThreads} {
+    if (config.writeAheadLogFileName) {
         spdlog::info("Write-Ahead Log enabled.");
-        WriteAheadLogPersister::restoreFromFile(*writeAheadLogFileName, controller);
+        WriteAheadLogPersister::restoreFromFile(*config.writeAheadLogFileName, controller);
     } else {
         spdlog::info("Write-Ahead Log disabled.");
     }
@@ -43,93 +62,790 @@ TCPServer::TCPServer(const std::optional<std::string> &writeAheadLogFileName) :
     }
     server_addr.sin_port = htons(port);
 
-    if (bind(m_serverFD, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
-        throw std::runtime_error("Port " + std::to_string(port) + " already in use!");
+    bool useIoUring = config.backend == NetworkBackend::IoUring;
+
+    // Every event loop gets its own SO_REUSEPORT listener, so the kernel spreads incoming connections across them.
+    for (size_t i = 0; i < config.numThreads; ++i) {
+        auto loop = std::make_unique<EventLoop>();
+        loop->listenFDs.push_back(createListener(server_addr));
+        loop->wakeFD = eventfd(0, EFD_CLOEXEC);
+        if (loop->wakeFD < 0) { throw std::runtime_error("Failed to create eventfd!"); }
+        eventLoops.push_back(std::move(loop));
+    }
+
+    // Local clients skip the TCP stack, the Unix socket is shared by all event loops.
+    if (config.unixSocketPath) {
+        int unixFD = createUnixListener(*config.unixSocketPath);
+        for (auto &loop: eventLoops) { loop->listenFDs.push_back(unixFD); }
+        spdlog::info("Listening on Unix socket {}", *config.unixSocketPath);
     }
 
-    int connection_backlog = 128;
-    if (listen(m_serverFD, connection_backlog) != 0) { throw std::runtime_error("Listen failed!"); }
+    if (useIoUring) {
+        try {
+            for (auto &loop: eventLoops) {
+                loop->ring = std::make_unique<IoUring>(IO_URING_ENTRIES, IO_URING_BUFFERS, RECV_SIZE);
+            }
+        } catch (const std::runtime_error &e) {
+            spdlog::warn("io_uring unavailable ({}), falling back to epoll", e.what());
+            for (auto &loop: eventLoops) { loop->ring.reset(); }
+            useIoUring = false;
+        }
+    }
+
+    if (!useIoUring) {
+        for (auto &loop: eventLoops) {
+            loop->epollFD = epoll_create1(EPOLL_CLOEXEC);
+            if (loop->epollFD < 0) { throw std::runtime_error("Failed to create epoll instance!"); }
+
+            for (size_t i = 0; i < loop->listenFDs.size(); ++i) {
+                struct epoll_event event {};
+                // Listeners shared between loops only wake up one of them per connection.
+                event.events = EPOLLIN | EPOLLET;
+                if (i > 0) { event.events |= EPOLLEXCLUSIVE; }
+                event.data.u64 = makeListenerData(i);
+                if (epoll_ctl(loop->epollFD, EPOLL_CTL_ADD, loop->listenFDs[i], &event) != 0) {
+                    throw std::runtime_error("Failed to register listening socket!");
+                }
+            }
+
+            struct epoll_event event {};
+            event.events = EPOLLIN;
+            event.data.u64 = OP_WAKE;
+            if (epoll_ctl(loop->epollFD, EPOLL_CTL_ADD, loop->wakeFD, &event) != 0) {
+                throw std::runtime_error("Failed to register eventfd!");
+            }
+        }
+    }
+
+    spdlog::info("Listening on port {} with {} {} event loops", port, eventLoops.size(),
+                 useIoUring ? "io_uring" : "epoll");
+
+    std::vector<int> cpus = allowedCpus();
+
+    for (size_t i = 1; i < eventLoops.size(); ++i) {
+        eventLoops[i]->thread = std::thread(&TCPServer::runLoop, this, std::ref(*eventLoops[i]));
+        pinToCpu(eventLoops[i]->thread.native_handle(), cpus[i % cpus.size()]);
+    }
+
+    // The calling thread serves the first event loop.
+    pinToCpu(pthread_self(), cpus[0]);
+    runLoop(*eventLoops[0]);
+}
+
+[[noreturn]] void TCPServer::runLoop(EventLoop &loop) {
+    if (loop.ring) { runIoUringLoop(loop); }
+    runEventLoop(loop);
+}
+
+int TCPServer::createListener(const struct sockaddr_in &serverAddr) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) { throw std::runtime_error("Failed to create server socket!"); }
+
+    int reuse = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        throw std::runtime_error("Setsockopt failed!");
+    }
+
+    if (bind(fd, (struct sockaddr *) &serverAddr, sizeof(serverAddr)) != 0) {
+        throw std::runtime_error("Port " + std::to_string(ntohs(serverAddr.sin_port)) + " already in use!");
+    }
+
+    if (listen(fd, LISTEN_BACKLOG) != 0) { throw std::runtime_error("Listen failed!"); }
+
+    return fd;
+}
+
+int TCPServer::createUnixListener(const std::string &path) {
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) { throw std::runtime_error("Unix socket path too long!"); }
+    std::copy(path.begin(), path.end(), addr.sun_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) { throw std::runtime_error("Failed to create Unix socket!"); }
+
+    // Remove a socket file left behind by a previous run.
+    unlink(path.c_str());
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        throw std::runtime_error("Failed to bind Unix socket " + path + "!");
+    }
+
+    if (listen(fd, LISTEN_BACKLOG) != 0) { throw std::runtime_error("Listen failed!"); }
+
+    return fd;
+}
+
+std::vector<int> TCPServer::allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+        }
+    }
+
+    if (cpus.empty()) { cpus.push_back(0); }
+    return cpus;
+}
+
+void TCPServer::pinToCpu(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        spdlog::warn("Failed to pin event loop to CPU {}", cpu);
+    }
+}
+
+void TCPServer::setKeepalive(int fd, int interval) {
+    int yes = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(yes)) != 0) { return; }
+
+    // Start probing after interval seconds of silence and drop the peer after three unanswered probes.
+    int intvl = std::max(interval / 3, 1);
+    int cnt = 3;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+}
+
+bool TCPServer::admitClient(int fd, bool tcp) {
+    if (numClients.fetch_add(1, std::memory_order_relaxed) >= config.maxClients) {
+        numClients.fetch_sub(1, std::memory_order_relaxed);
+        spdlog::warn("Connection rejected, max number of clients reached");
+        // Best effort, the socket is closed either way.
+        send(fd, MAX_CLIENTS_ERROR.data(), MAX_CLIENTS_ERROR.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        close(fd);
+        return false;
+    }
 
-    spdlog::info("Listening on port {}", port);
+    if (tcp && config.tcpKeepalive.count() > 0) { setKeepalive(fd, static_cast<int>(config.tcpKeepalive.count())); }
+    return true;
+}
 
+void TCPServer::acceptConnections(EventLoop &loop, size_t listener) {
     while (true) {
-        struct sockaddr_in client_addr = {};
+        struct sockaddr_storage client_addr = {};
         socklen_t socklen = sizeof(client_addr);
 
-        int connFD = accept(m_serverFD, (struct sockaddr *) &client_addr, &socklen);
+        int connFD = accept4(loop.listenFDs[listener], (struct sockaddr *) &client_addr, &socklen,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
 
         if (connFD < 0) {
-            continue;// error
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { spdlog::error("Accept failed: {}", strerror(errno)); }
+            return;
         }
 
         char clientIP[INET_ADDRSTRLEN];
+        auto *inetAddr = reinterpret_cast<struct sockaddr_in *>(&client_addr);
 
-        if (inet_ntop(AF_INET, &(client_addr.sin_addr), clientIP, INET_ADDRSTRLEN) != nullptr) {
-            int clientPort = ntohs(client_addr.sin_port);
+        if (client_addr.ss_family == AF_UNIX) {
+            spdlog::info("Client connected on Unix socket");
+        } else if (inet_ntop(AF_INET, &(inetAddr->sin_addr), clientIP, INET_ADDRSTRLEN) != nullptr) {
+            int clientPort = ntohs(inetAddr->sin_port);
             spdlog::info("Client connected from {}:{}", clientIP, clientPort);
         }
 
-        std::thread(&TCPServer::handleRequest, this, connFD).detach();
+        if (!admitClient(connFD, client_addr.ss_family != AF_UNIX)) { continue; }
+
+        auto *conn = openConnection(loop, connFD);
+        struct epoll_event event {};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = makeUserData(conn, OP_RECV);
+
+        if (epoll_ctl(loop.epollFD, EPOLL_CTL_ADD, connFD, &event) != 0) {
+            spdlog::error("Failed to register connection: {}", strerror(errno));
+            releaseConnection(loop, conn);
+            continue;
+        }
+
+        scheduleTimer(loop, conn);
     }
 }
 
-void TCPServer::handleRequest(int connFD) {
-    std::vector<uint8_t> buffer;
+[[noreturn]] void TCPServer::runEventLoop(EventLoop &loop) {
+    std::vector<struct epoll_event> events(MAX_EVENTS);
 
     while (true) {
-        std::vector<uint8_t> data(RECV_SIZE);
+        bool woken = false;
+
+        // Only wake up periodically while there are timers to expire.
+        int waitMs = loop.timers.size() > 0 ? static_cast<int>(TIMER_TICK.count()) : -1;
+        int numEvents = epoll_wait(loop.epollFD, events.data(), MAX_EVENTS, waitMs);
+        loop.now = std::chrono::steady_clock::now();
+
+        if (numEvents < 0) {
+            if (errno != EINTR) { spdlog::error("epoll_wait failed: {}", strerror(errno)); }
+            continue;
+        }
+
+        for (int i = 0; i < numEvents; ++i) {
+            uint64_t data = events[i].data.u64;
+
+            if ((data & OP_MASK) == OP_ACCEPT) {
+                acceptConnections(loop, data >> OP_BITS);
+                continue;
+            }
+
+            // Delivered after the batch, so connections closed meanwhile are not referenced by pending events.
+            if (data == OP_WAKE) {
+                woken = true;
+                continue;
+            }
+
+            auto *conn = reinterpret_cast<Connection *>(data & ~OP_MASK);
+            uint32_t flags = events[i].events;
+
+            if (flags & EPOLLERR) {
+                closeConnection(loop, conn);
+                continue;
+            }
+
+            conn->lastInteraction = loop.now;
+
+            bool keepOpen = true;
+            bool readable = flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP);
+
+            // Edge-triggered: keep going until the socket would block, it might not signal again.
+            while (keepOpen) {
+                if (!conn->writeBuffer.empty()) { keepOpen = handleWrite(*conn); }
+
+                // The client caught up with its output, pick up the requests that were left in the socket.
+                if (conn->readPaused && conn->outputSize() < OUTPUT_PAUSE_THRESHOLD) {
+                    conn->readPaused = false;
+                    readable = true;
+                }
+
+                if (!keepOpen || !readable) { break; }
+
+                auto status = handleRead(*conn);
+                bool peerOpen = status != ReadStatus::Closed;
+                readable = status == ReadStatus::More;
+                bool requestsOk = handleRequest(loop, *conn);
+                keepOpen = requestsOk && checkOutputLimits(loop, *conn);
+
+                // Requests that arrived before the peer closed its end, or a protocol error, are still answered.
+                if (!peerOpen || !requestsOk) {
+                    if (!conn->writeBuffer.empty()) { handleWrite(*conn); }
+                    keepOpen = false;
+                }
+            }
+
+            if (!keepOpen || !checkOutputLimits(loop, *conn)) { closeConnection(loop, conn); }
+        }
+
+        if (woken) {
+            eventfd_t value;
+            eventfd_read(loop.wakeFD, &value);
+            deliverMessages(loop);
+        }
+
+        expireTimers(loop);
+    }
+}
+
+TCPServer::ReadStatus TCPServer::handleRead(Connection &conn) {
+    // Leave the data in the socket so TCP flow control pushes back on the client.
+    if (conn.readPaused) { return ReadStatus::WouldBlock; }
+
+    size_t buffered = 0;
+
+    while (true) {
+        // The rest of a large argument goes straight to its final buffer.
+        auto destination = conn.parser.bulkDestination();
+
+        if (!destination.empty()) {
+            ssize_t bytes_received = recv(conn.fd, destination.data(), destination.size(), 0);
+
+            if (bytes_received < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK ? ReadStatus::WouldBlock : ReadStatus::Closed;
+            }
+
+            if (bytes_received == 0) { return ReadStatus::Closed; }
+
+            conn.parser.bulkReceived(bytes_received);
+            continue;
+        }
+
+        // Let the request parser look at what has arrived so far.
+        if (buffered >= READ_BATCH) { return ReadStatus::More; }
+
+        size_t oldSize = conn.readBuffer.size();
+        conn.readBuffer.resize(oldSize + RECV_SIZE);
 
         // Read from socket
-        ssize_t bytes_received = recv(connFD, data.data(), RECV_SIZE, 0);
+        ssize_t bytes_received = recv(conn.fd, conn.readBuffer.data() + oldSize, RECV_SIZE, 0);
 
-        if (bytes_received <= 0) {
-            close(connFD);
-            break;
+        if (bytes_received < 0) {
+            int err = errno;
+            conn.readBuffer.resize(oldSize);
+            if (err == EINTR) continue;
+            return err == EAGAIN || err == EWOULDBLOCK ? ReadStatus::WouldBlock : ReadStatus::Closed;
         }
 
-        buffer.insert(buffer.end(), data.begin(), data.begin() + bytes_received);
+        conn.readBuffer.resize(oldSize + bytes_received);
+        buffered += bytes_received;
 
-        // Parse message
-        auto [message, length] = *parseMessage(buffer);
+        // Peer closed the connection
+        if (bytes_received == 0) { return ReadStatus::Closed; }
+    }
+}
 
-        if (!std::holds_alternative<RedisType::Array>(message)) {
-            close(connFD);
-            break;
+bool TCPServer::handleWrite(Connection &conn) {
+    struct iovec iov[MAX_IOV];
+
+    while (!conn.writeBuffer.empty()) {
+        // Gather the pending chunks, large values are sent straight from the data store's buffers.
+        struct msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = conn.writeBuffer.prepare(iov, MAX_IOV);
+
+        ssize_t sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            // Socket buffer is full, EPOLLOUT will fire once it drains.
+            return errno == EAGAIN || errno == EWOULDBLOCK;
         }
 
-        // If successfully parsed message, then erase
-        buffer.erase(buffer.begin(), buffer.begin() + static_cast<long>(length));
+        conn.writeBuffer.consume(sent);
+    }
 
-        auto array = std::get<RedisType::Array>(message).data;
+    return true;
+}
 
-        if (!array) {
-            close(connFD);
-            break;
+bool TCPServer::checkOutputLimits(EventLoop &loop, Connection &conn) {
+    const auto &limit = config.clientOutputBufferLimit;
+    size_t size = conn.outputSize();
+
+    if (limit.hard > 0 && size >= limit.hard) {
+        spdlog::warn("Client closed for overcoming of output buffer limits ({} bytes pending)", size);
+        return false;
+    }
+
+    if (limit.soft == 0 || size < limit.soft) {
+        conn.softLimitReachedAt.reset();
+        return true;
+    }
+
+    // A client that stops reading gets no further events, its timer enforces the soft limit instead.
+    if (!conn.softLimitReachedAt) {
+        conn.softLimitReachedAt = loop.now;
+        scheduleTimer(loop, &conn);
+    }
+
+    if (loop.now - *conn.softLimitReachedAt >= limit.softSeconds) {
+        spdlog::warn("Client closed for overcoming of output buffer soft limit ({} bytes pending)", size);
+        return false;
+    }
+
+    return true;
+}
+
+Connection *TCPServer::openConnection(EventLoop &loop, int fd) {
+    // The event loop owns the connection and frees it on close.
+    auto *conn = new Connection(fd, loop.now, config.protoMaxBulkLen);
+    conn->client = controller.connectClient([&loop](uint64_t clientId) { wake(loop, clientId); });
+    loop.connections.emplace(conn->client->id, conn);
+    return conn;
+}
+
+void TCPServer::closeConnection(EventLoop &loop, Connection *conn) {
+    epoll_ctl(loop.epollFD, EPOLL_CTL_DEL, conn->fd, nullptr);
+    releaseConnection(loop, conn);
+}
+
+void TCPServer::releaseConnection(EventLoop &loop, Connection *conn) {
+    loop.timers.cancel(conn->timer);
+    loop.connections.erase(conn->client->id);
+    controller.disconnectClient(*conn->client);
+    close(conn->fd);
+    delete conn;
+    numClients.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void TCPServer::scheduleTimer(EventLoop &loop, Connection *conn) {
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+
+    const auto &client = *conn->client;
+
+    // Subscribers and blocked clients wait for messages, they are never idle.
+    if (config.timeout.count() > 0 && client.subscriptions() == 0 && !client.blocked) {
+        deadline = conn->lastInteraction + config.timeout;
+    }
+
+    if (client.blocked && client.blockedUntil) {
+        if (!deadline || *client.blockedUntil < *deadline) { deadline = client.blockedUntil; }
+    }
+
+    if (conn->softLimitReachedAt) {
+        auto softDeadline = *conn->softLimitReachedAt + config.clientOutputBufferLimit.softSeconds;
+        if (!deadline || softDeadline < *deadline) { deadline = softDeadline; }
+    }
+
+    if (deadline) {
+        loop.timers.schedule(conn->timer, conn, *deadline);
+    } else {
+        loop.timers.cancel(conn->timer);
+    }
+}
+
+void TCPServer::wake(EventLoop &loop, uint64_t clientId) {
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(loop.mailMutex);
+        first = loop.mail.empty();
+        loop.mail.push_back(clientId);
+    }
+
+    if (first) { eventfd_write(loop.wakeFD, 1); }
+}
+
+void TCPServer::deliverMessages(EventLoop &loop) {
+    std::vector<uint64_t> clientIds;
+    {
+        std::lock_guard<std::mutex> lock(loop.mailMutex);
+        std::swap(clientIds, loop.mail);
+    }
+
+    for (auto clientId: clientIds) {
+        // The client may have disconnected since its messages were queued.
+        auto it = loop.connections.find(clientId);
+        if (it == loop.connections.end() || it->second->closing) { continue; }
+
+        auto *conn = it->second;
+        appendMessages(*conn);
+
+        if (loop.ring) {
+            touch(loop, conn);
+            continue;
+        }
+
+        // A client that was blocked picks up the requests that arrived meanwhile.
+        bool requestsOk = !conn->blocked || handleRequest(loop, *conn);
+        if (!handleWrite(*conn) || !requestsOk || !checkOutputLimits(loop, *conn)) { closeConnection(loop, conn); }
+    }
+}
+
+void TCPServer::appendMessages(Connection &conn) {
+    // Large messages, shared by all their recipients, are sent from the one buffer they were encoded into.
+    for (auto &message: conn.client->takeMessages()) {
+        if (message->size() >= ReplyWriter::ZERO_COPY_THRESHOLD) {
+            conn.writeBuffer.append(std::move(message));
+        } else {
+            conn.writeBuffer.append(std::string_view(*message));
+        }
+    }
+}
+
+void TCPServer::expireTimers(EventLoop &loop) {
+    loop.timers.advance(loop.now, [&](Connection *conn) {
+        if (conn->closing) { return; }
+
+        auto &client = *conn->client;
+
+        // The null reply goes through the mailbox like one from a push, which also resumes the client's requests.
+        if (client.blocked && client.blockedUntil && loop.now >= *client.blockedUntil) {
+            controller.timeoutBlockedClient(client);
+            conn->lastInteraction = loop.now;
+        }
+
+        bool idle = config.timeout.count() > 0 && client.subscriptions() == 0 && !client.blocked &&
+                    loop.now - conn->lastInteraction >= config.timeout;
+        if (idle) { spdlog::info("Closing idle client"); }
+
+        // Still active: the deadline moved since the timer was scheduled, schedule it again.
+        if (!idle && checkOutputLimits(loop, *conn)) {
+            scheduleTimer(loop, conn);
+            return;
         }
 
-        // Convert message to internal command format
-        std::vector<RedisType::BulkString> command;
+        if (loop.ring) {
+            beginClose(conn);
+            touch(loop, conn);
+        } else {
+            closeConnection(loop, conn);
+        }
+    });
+}
+
+[[noreturn]] void TCPServer::runIoUringLoop(EventLoop &loop) {
+    auto &ring = *loop.ring;
+
+    for (size_t i = 0; i < loop.listenFDs.size(); ++i) { submitAccept(loop, i); }
+    submitWakeRead(loop);
+
+    while (true) {
+        // Every send queued while handling the previous batch goes to the kernel in this single call.
+        if (ring.submitAndWait(1) < 0 && errno != EBUSY) {
+            spdlog::error("io_uring_enter failed: {}", strerror(errno));
+        }
+        loop.now = std::chrono::steady_clock::now();
 
-        bool err = false;
-        for (const auto &item: *array) {
-            if (!std::holds_alternative<RedisType::BulkString>(item)) {
-                err = true;
-                break;
+        ring.forEachCqe([&](const io_uring_cqe &cqe) {
+            auto op = static_cast<EventOp>(cqe.user_data & OP_MASK);
+            auto *conn = reinterpret_cast<Connection *>(cqe.user_data & ~OP_MASK);
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+
+            if (op == OP_TICK) {
+                loop.tickArmed = false;
+                return;
+            }
+
+            if (op == OP_WAKE) {
+                deliverMessages(loop);
+                submitWakeRead(loop);
+                return;
+            }
+
+            if (op == OP_ACCEPT) {
+                // The first listener is the loop's TCP listener, the shared ones are Unix sockets.
+                size_t listener = cqe.user_data >> OP_BITS;
+                if (cqe.res >= 0 && admitClient(cqe.res, listener == 0)) {
+                    conn = openConnection(loop, cqe.res);
+                    submitRecv(loop, conn);
+                    scheduleTimer(loop, conn);
+                } else if (cqe.res == -EINVAL && loop.multishotAccept) {
+                    spdlog::warn("Multishot accept unsupported, falling back to single-shot accept");
+                    loop.multishotAccept = false;
+                }
+                if (!more) { submitAccept(loop, listener); }
+                return;
+            }
+
+            conn->lastInteraction = loop.now;
+            touch(loop, conn);
+
+            if (op == OP_CANCEL) {
+                --conn->pendingOps;
+                return;
+            }
+
+            if (op == OP_RECV) {
+                if (!more) {
+                    --conn->pendingOps;
+                    conn->recvArmed = false;
+                    conn->recvCancelled = false;
+                }
+
+                // Receives are re-armed once the batch has been handled, see below.
+                if (cqe.res > 0) {
+                    auto bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    auto *data = ring.buffer(bufferId);
+                    size_t size = cqe.res;
+
+                    // The rest of a large argument goes straight to its final buffer.
+                    auto destination = conn->parser.bulkDestination();
+                    size_t direct = std::min(destination.size(), size);
+                    std::copy_n(data, direct, destination.data());
+                    conn->parser.bulkReceived(direct);
+
+                    conn->readBuffer.insert(conn->readBuffer.end(), data + direct, data + size);
+                    ring.recycleBuffer(bufferId);
+                } else if (cqe.res == -EINVAL && loop.multishotRecv) {
+                    spdlog::warn("Multishot recv unsupported, falling back to single-shot recv");
+                    loop.multishotRecv = false;
+                } else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED && !more) {
+                    // Peer closed the connection or the receive failed
+                    beginClose(conn);
+                }
+                return;
+            }
+
+            // OP_SEND
+            --conn->pendingOps;
+            if (cqe.res < 0) {
+                beginClose(conn);
+                return;
+            }
+
+            conn->sendBuffer.consume(cqe.res);
+            if (!conn->sendBuffer.empty() && !conn->closing) { submitSend(loop, conn); }
+        });
+
+        expireTimers(loop);
+
+        for (auto *conn: loop.touched) {
+            conn->touched = false;
+
+            if (conn->readPaused && conn->outputSize() < OUTPUT_PAUSE_THRESHOLD) { conn->readPaused = false; }
+
+            if (!conn->closing) {
+                bool requestsOk = handleRequest(loop, *conn);
+                // Best effort to report a protocol error, unless it would overtake the in-flight send.
+                if (!requestsOk && conn->sendBuffer.empty()) { handleWrite(*conn); }
+                if (!requestsOk || !checkOutputLimits(loop, *conn)) { beginClose(conn); }
+            }
+
+            // Only one send per connection is in flight, the next one picks up whatever accumulated meanwhile.
+            if (!conn->closing && conn->sendBuffer.empty() && !conn->writeBuffer.empty()) {
+                std::swap(conn->sendBuffer, conn->writeBuffer);
+                submitSend(loop, conn);
+            }
+
+            // Stop receiving while the client is not reading its replies, resume once it caught up.
+            if (!conn->closing) {
+                if (!conn->readPaused && !conn->recvArmed) {
+                    submitRecv(loop, conn);
+                } else if (conn->readPaused && conn->recvArmed && !conn->recvCancelled) {
+                    submitCancelRecv(loop, conn);
+                }
             }
-            command.push_back(std::get<RedisType::BulkString>(item));
+
+            if (conn->closing && conn->pendingOps == 0) { releaseConnection(loop, conn); }
+        }
+        loop.touched.clear();
+
+        // Only wake up periodically while there are timers to expire.
+        if (loop.timers.size() > 0 && !loop.tickArmed) { submitTick(loop); }
+    }
+}
+
+void TCPServer::submitAccept(EventLoop &loop, size_t listener) {
+    auto *sqe = loop.ring->getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = loop.listenFDs[listener];
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (loop.multishotAccept) { sqe->ioprio |= IORING_ACCEPT_MULTISHOT; }
+    sqe->user_data = makeListenerData(listener);
+}
+
+void TCPServer::submitRecv(EventLoop &loop, Connection *conn) {
+    auto *sqe = loop.ring->getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IoUring::BUFFER_GROUP;
+    if (loop.multishotRecv) { sqe->ioprio |= IORING_RECV_MULTISHOT; }
+    sqe->user_data = makeUserData(conn, OP_RECV);
+    ++conn->pendingOps;
+    conn->recvArmed = true;
+}
+
+void TCPServer::submitSend(EventLoop &loop, Connection *conn) {
+    auto *sqe = loop.ring->getSqe();
+    // The iovecs and message header live in the connection, they must stay valid until the send completes.
+    conn->sendIov.resize(MAX_IOV);
+    conn->sendMsg = {};
+    conn->sendMsg.msg_iov = conn->sendIov.data();
+    conn->sendMsg.msg_iovlen = conn->sendBuffer.prepare(conn->sendIov.data(), MAX_IOV);
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&conn->sendMsg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(conn, OP_SEND);
+    ++conn->pendingOps;
+}
+
+void TCPServer::submitCancelRecv(EventLoop &loop, Connection *conn) {
+    auto *sqe = loop.ring->getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = makeUserData(conn, OP_RECV);
+    sqe->user_data = makeUserData(conn, OP_CANCEL);
+    ++conn->pendingOps;
+    conn->recvCancelled = true;
+}
+
+void TCPServer::submitTick(EventLoop &loop) {
+    auto *sqe = loop.ring->getSqe();
+    // The timespec lives in the event loop, it must stay valid until the timeout completes.
+    auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(TIMER_TICK);
+    loop.tickTimeout.tv_sec = tick.count() / 1'000'000'000;
+    loop.tickTimeout.tv_nsec = tick.count() % 1'000'000'000;
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&loop.tickTimeout);
+    sqe->len = 1;
+    sqe->user_data = OP_TICK;
+    loop.tickArmed = true;
+}
+
+void TCPServer::submitWakeRead(EventLoop &loop) {
+    auto *sqe = loop.ring->getSqe();
+    // The counter is read into the event loop, it must stay valid until the read completes.
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = loop.wakeFD;
+    sqe->addr = reinterpret_cast<uint64_t>(&loop.wakeValue);
+    sqe->len = sizeof(loop.wakeValue);
+    sqe->user_data = OP_WAKE;
+}
+
+void TCPServer::touch(EventLoop &loop, Connection *conn) {
+    if (conn->touched) return;
+    conn->touched = true;
+    loop.touched.push_back(conn);
+}
+
+void TCPServer::beginClose(Connection *conn) {
+    if (conn->closing) return;
+    conn->closing = true;
+    // Completes any outstanding receive, the connection is freed once no operation references it.
+    shutdown(conn->fd, SHUT_RDWR);
+}
+
+bool TCPServer::handleRequest(EventLoop &loop, Connection &conn) {
+    size_t consumed = 0;
+    bool ok = true;
+
+    // Drain every complete frame, replies are batched in the write buffer and flushed together.
+    while (consumed < conn.readBuffer.size()) {
+        if (conn.blocked) {
+            if (conn.client->blocked) { break; }
+
+            // The blocking command's reply is in the mailbox by now, it goes out ahead of the replies that follow.
+            appendMessages(conn);
+            conn.blocked = false;
+            conn.lastInteraction = loop.now;
+        }
+
+        if (conn.outputSize() >= OUTPUT_PAUSE_THRESHOLD) {
+            conn.readPaused = true;
+            break;
         }
 
-        if (err) {
-            close(connFD);
+        std::span<const uint8_t> pending(conn.readBuffer.data() + consumed, conn.readBuffer.size() - consumed);
+        auto status = conn.parser.parse(pending);
+
+        // Incomplete frame, wait for more data
+        if (status == RequestParser::Status::Incomplete) { break; }
+
+        if (status == RequestParser::Status::Error) {
+            spdlog::debug("{}", conn.parser.error());
+            conn.writeBuffer.append("-ERR " + conn.parser.error() + CLRF);
+            ok = false;
             break;
         }
 
-        // Handle command
-        RedisType::RedisValue res = controller.handleCommand(command);
-        auto encoded = encode(res);
-        spdlog::debug("Request: {}, Response: {}", std::get<RedisType::Array>(message), res);
+        // The arguments view the read buffer, which stays untouched until the command has been handled.
+        if (!conn.parser.args().empty()) {
+            spdlog::debug("Request: {}", fmt::join(conn.parser.args(), " "));
+            controller.handleCommand(*conn.client, conn.parser.args(), conn.writeBuffer,
+                                     conn.parser.argumentBuffers());
 
-        // Send response
-        send(connFD, encoded.data(), encoded.size(), 0);
+            if (conn.client->blocked) {
+                conn.blocked = true;
+                scheduleTimer(loop, &conn);
+            }
+        }
+
+        consumed += conn.parser.length();
+        conn.parser.reset();
     }
+
+    // Drop all handled frames at once instead of shifting the buffer after every command
+    conn.readBuffer.erase(conn.readBuffer.begin(), conn.readBuffer.begin() + static_cast<long>(consumed));
+
+    return ok;
 }
@@ -1,21 +1,255 @@
 #pragma once
 
 #include "controller.h"
+#include "io_uring.h"
+#include "output_buffer.h"
+#include "request_parser.h"
+#include "timer_wheel.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <pthread.h>
 #include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 
+enum class NetworkBackend { Epoll, IoUring };
+
+/**
+ * Mirrors Redis' client-output-buffer-limit: a client is disconnected once its pending output reaches the hard
+ * limit, or stays at or above the soft limit for softSeconds. A limit of 0 disables it.
+ */
+struct OutputBufferLimit {
+    size_t hard = 0;
+    size_t soft = 0;
+    std::chrono::seconds softSeconds{0};
+};
+
+struct ServerConfig {
+    std::optional<std::string> writeAheadLogFileName;
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    NetworkBackend backend = NetworkBackend::Epoll;
+    std::optional<std::string> unixSocketPath;
+    OutputBufferLimit clientOutputBufferLimit;
+
+    // Close clients idle for this long, 0 disables the timeout.
+    std::chrono::seconds timeout{0};
+
+    // TCP keepalive probe interval, 0 disables keepalive.
+    std::chrono::seconds tcpKeepalive{300};
+    size_t maxClients = 10000;
+
+    // Longest bulk string accepted in a request, and longest string APPEND and SETRANGE build.
+    size_t protoMaxBulkLen = RequestParser::DEFAULT_MAX_BULK_LENGTH;
+
+    // Largest values kept in the packed encodings.
+    EncodingLimits encodingLimits;
+
+    // Threads that help the event loop running a large SINTER, which holds the store lock meanwhile. A quarter of the
+    // cores by default, so they do not take the cores of the event loops, which mostly wait for that lock anyway.
+    size_t setIntersectionThreads = std::thread::hardware_concurrency() / 4;
+};
+
+/**
+ * Per-connection state owned by the event loop that serves the connection.
+ */
+struct Connection {
+    int fd;
+    std::shared_ptr<Client> client;
+    std::vector<uint8_t> readBuffer;
+    OutputBuffer writeBuffer;
+
+    // Holds the progress on a request that has not been received completely yet.
+    RequestParser parser;
+
+    // Set while too much output is pending: requests are left unread in the socket until the client catches up.
+    bool readPaused = false;
+    std::optional<std::chrono::steady_clock::time_point> softLimitReachedAt;
+
+    // Set while the client waits in a blocking command: later requests stay in the read buffer until the command's
+    // reply arrives in the mailbox, see Client::blocked.
+    bool blocked = false;
+
+    // Checked lazily when the connection's timer fires, so activity never has to touch the timer wheel.
+    std::chrono::steady_clock::time_point lastInteraction;
+    TimerWheel<Connection *>::Handle timer;
+
+    // io_uring backend only: output handed to the in-flight send, and bookkeeping so the connection is
+    // freed only after the kernel has completed every operation referencing it.
+    OutputBuffer sendBuffer;
+    std::vector<struct iovec> sendIov;
+    struct msghdr sendMsg {};
+    unsigned pendingOps = 0;
+    bool recvArmed = false;
+    bool recvCancelled = false;
+    bool closing = false;
+    bool touched = false;
+
+    Connection(int fd, std::chrono::steady_clock::time_point now, size_t maxBulkLength)
+        : fd(fd), parser(maxBulkLength), lastInteraction(now) {}
+
+    size_t outputSize() const { return writeBuffer.size() + sendBuffer.size(); }
+};
+
 class TCPServer {
 public:
-    explicit TCPServer(const std::optional<std::string> &writeAheadLogFileName);
+    explicit TCPServer(const ServerConfig &config);
     [[noreturn]] void start(const std::string &address, int port);
-    void handleRequest(int conn_fd);
 
 private:
-    int m_serverFD;
+    struct EventLoop {
+        // The event loop's own TCP listener first, followed by listeners shared with the other loops.
+        std::vector<int> listenFDs;
+        int epollFD = -1;
+        std::unique_ptr<IoUring> ring;
+        bool multishotAccept = true;
+        bool multishotRecv = true;
+        std::thread thread;
+
+        // Idle timeouts and soft output limit deadlines of the loop's connections.
+        TimerWheel<Connection *> timers{TIMER_TICK, TIMER_SLOTS};
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        // io_uring backend only: the timeout waking the loop up while timers are pending, and the connections
+        // that need attention after the current batch of completions.
+        struct __kernel_timespec tickTimeout {};
+        bool tickArmed = false;
+        std::vector<Connection *> touched;
+
+        // The loop's connections by client id, so messages queued by other threads find their connection.
+        std::unordered_map<uint64_t, Connection *> connections;
+
+        // Ids of the loop's clients that received messages, and the eventfd waking the loop up for them.
+        int wakeFD = -1;
+        uint64_t wakeValue = 0;
+        std::mutex mailMutex;
+        std::vector<uint64_t> mail;
+    };
+
+    ServerConfig config;
     Controller controller;
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    std::atomic<size_t> numClients{0};
+
+    [[noreturn]] void runLoop(EventLoop &loop);
+
+    /**
+     * Runs an edge-triggered epoll loop serving the connections accepted on the event loop's listeners.
+     */
+    [[noreturn]] void runEventLoop(EventLoop &loop);
+
+    /**
+     * Runs an io_uring completion loop: multishot accept on the event loop's listeners, provided-buffer multishot
+     * receives, and all sends produced by one batch of completions submitted with a single io_uring_enter.
+     */
+    [[noreturn]] void runIoUringLoop(EventLoop &loop);
+
+    void submitAccept(EventLoop &loop, size_t listener);
+    void submitRecv(EventLoop &loop, Connection *conn);
+    void submitSend(EventLoop &loop, Connection *conn);
+    void submitCancelRecv(EventLoop &loop, Connection *conn);
+    void submitTick(EventLoop &loop);
+    void submitWakeRead(EventLoop &loop);
+    void beginClose(Connection *conn);
+    void touch(EventLoop &loop, Connection *conn);
+
+    /**
+     * Handles every complete request in the connection's read buffer and queues the responses in its write
+     * buffer, up to a request that blocks the client. Returns false if the connection should be closed, after
+     * queueing the error for a malformed request.
+     */
+    bool handleRequest(EventLoop &loop, Connection &conn);
+
+    enum class ReadStatus { WouldBlock, More, Closed };
+
+    /**
+     * Reads from the socket until it would block, or until READ_BATCH bytes have been buffered so they can be
+     * parsed before reading on: a large argument is then received straight into its own buffer.
+     */
+    ReadStatus handleRead(Connection &conn);
+
+    /**
+     * Writes buffered output until it is drained or the socket would block. Returns false on error.
+     */
+    bool handleWrite(Connection &conn);
+
+    /**
+     * Creates the state of a freshly admitted socket and registers its client with the controller.
+     */
+    Connection *openConnection(EventLoop &loop, int fd);
+    void closeConnection(EventLoop &loop, Connection *conn);
+
+    /**
+     * Frees a connection once the event loop no longer references it.
+     */
+    void releaseConnection(EventLoop &loop, Connection *conn);
+
+    /**
+     * Enforces the client output buffer limits. Returns false if the client has to be disconnected.
+     */
+    bool checkOutputLimits(EventLoop &loop, Connection &conn);
+
+    /**
+     * Admits a freshly accepted socket, or rejects it with an error once maxclients is reached.
+     */
+    bool admitClient(int fd, bool tcp);
+
+    /**
+     * Schedules the connection's timer for its earliest deadline: idle timeout, soft output limit or the timeout of
+     * the blocking command the client waits in.
+     */
+    void scheduleTimer(EventLoop &loop, Connection *conn);
+
+    /**
+     * Advances the loop's timer wheel, times out blocking commands and disconnects clients that were idle for too
+     * long or stayed above the soft output limit.
+     */
+    void expireTimers(EventLoop &loop);
+
+    /**
+     * Notes that a client of the loop has messages waiting, and wakes the loop up. Callable from any thread.
+     */
+    static void wake(EventLoop &loop, uint64_t clientId);
+
+    /**
+     * Appends the messages queued for the loop's clients to their output, and resumes the requests of clients that
+     * were blocked.
+     */
+    void deliverMessages(EventLoop &loop);
+
+    /**
+     * Appends the messages queued for the connection's client to its output.
+     */
+    static void appendMessages(Connection &conn);
+
+    /**
+     * Accepts pending connections on one of the event loop's listeners until it would block.
+     */
+    void acceptConnections(EventLoop &loop, size_t listener);
+
+    static int createListener(const struct sockaddr_in &serverAddr);
+    static int createUnixListener(const std::string &path);
+    static std::vector<int> allowedCpus();
+    static void pinToCpu(pthread_t thread, int cpu);
+    static void setKeepalive(int fd, int interval);
 
     static constexpr size_t RECV_SIZE = 2048;
-};
+    static constexpr size_t READ_BATCH = 16 * RECV_SIZE;
+    static constexpr int LISTEN_BACKLOG = 511;
+    static constexpr size_t MAX_IOV = 64;
 
-;
+    // Requests of a client are not processed while at least this much of its output is pending.
+    static constexpr size_t OUTPUT_PAUSE_THRESHOLD = 1024 * 1024;
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr unsigned IO_URING_ENTRIES = 1024;
+    static constexpr unsigned IO_URING_BUFFERS = 1024;
+    static constexpr std::chrono::milliseconds TIMER_TICK{100};
+    static constexpr size_t TIMER_SLOTS = 1024;
+};
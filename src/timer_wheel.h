@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+/**
+ * Hashed timing wheel: timers are bucketed by their expiry tick modulo the number of slots, so scheduling and
+ * cancelling are O(1) and advancing the wheel only visits the slots of the ticks that elapsed.
+ *
+ * Timers further away than one revolution stay in their slot until the wheel comes around to their tick.
+ */
+template<typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Timer;
+
+public:
+    /**
+     * Identifies a scheduled timer, owned by whoever scheduled it.
+     */
+    struct Handle {
+        bool active = false;
+        size_t slot = 0;
+        typename std::list<Timer>::iterator it;
+    };
+
+    TimerWheel(Clock::duration tick, size_t numSlots, Clock::time_point now = Clock::now())
+        : tickDuration(tick), start(now), slots(numSlots) {}
+
+    /**
+     * Schedules value to expire at deadline, replacing the timer the handle refers to if it is active.
+     */
+    void schedule(Handle &handle, T value, Clock::time_point deadline) {
+        cancel(handle);
+
+        auto tick = static_cast<uint64_t>((deadline - start + tickDuration - Clock::duration(1)) / tickDuration);
+        if (tick <= currentTick) { tick = currentTick + 1; }
+
+        handle.slot = tick % slots.size();
+        handle.it = slots[handle.slot].insert(slots[handle.slot].end(), Timer{value, tick, &handle});
+        handle.active = true;
+        ++count;
+    }
+
+    void cancel(Handle &handle) {
+        if (!handle.active) return;
+
+        slots[handle.slot].erase(handle.it);
+        handle.active = false;
+        --count;
+    }
+
+    /**
+     * Advances the wheel to now and invokes onExpired for every timer whose deadline has passed. The callback may
+     * schedule or cancel timers.
+     */
+    template<typename F>
+    void advance(Clock::time_point now, F &&onExpired) {
+        auto target = static_cast<uint64_t>((now - start) / tickDuration);
+
+        // Nothing to expire, skip the empty slots.
+        if (count == 0) {
+            currentTick = std::max(currentTick, target);
+            return;
+        }
+
+        while (currentTick < target) {
+            ++currentTick;
+            auto &slot = slots[currentTick % slots.size()];
+
+            std::list<Timer> expired;
+            for (auto it = slot.begin(); it != slot.end();) {
+                auto next = std::next(it);
+                if (it->tick <= currentTick) {
+                    it->handle->active = false;
+                    expired.splice(expired.end(), slot, it);
+                    --count;
+                }
+                it = next;
+            }
+
+            for (auto &timer: expired) { onExpired(timer.value); }
+        }
+    }
+
+    size_t size() const { return count; }
+    Clock::duration tick() const { return tickDuration; }
+
+private:
+    struct Timer {
+        T value;
+        uint64_t tick;
+        Handle *handle;
+    };
+
+    Clock::duration tickDuration;
+    Clock::time_point start;
+    uint64_t currentTick = 0;
+    size_t count = 0;
+    std::vector<std::list<Timer>> slots;
+};
@@ -0,0 +1,42 @@
+#include "tracking_table.h"
+
+void TrackingTable::remember(std::string_view key, uint64_t clientId) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = keys.find(key);
+    if (it == keys.end()) {
+        it = keys.emplace(std::string(key), std::unordered_set<uint64_t>{}).first;
+        numKeys.store(keys.size(), std::memory_order_relaxed);
+    }
+
+    it->second.insert(clientId);
+}
+
+std::vector<uint64_t> TrackingTable::invalidate(std::string_view key) {
+    if (size() == 0) { return {}; }
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = keys.find(key);
+    if (it == keys.end()) { return {}; }
+
+    std::vector<uint64_t> clientIds(it->second.begin(), it->second.end());
+    keys.erase(it);
+    numKeys.store(keys.size(), std::memory_order_relaxed);
+
+    return clientIds;
+}
+
+std::vector<uint64_t> TrackingTable::invalidateAll() {
+    if (size() == 0) { return {}; }
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::unordered_set<uint64_t> clientIds;
+    for (const auto &[key, readers]: keys) { clientIds.insert(readers.begin(), readers.end()); }
+
+    keys.clear();
+    numKeys.store(0, std::memory_order_relaxed);
+
+    return {clientIds.begin(), clientIds.end()};
+}
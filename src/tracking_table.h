@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "string_view_hash.h"
+
+/**
+ * Remembers which clients read which keys, for server-assisted client-side caching. A key is forgotten once it is
+ * invalidated: clients have dropped it from their cache and track it again on their next read.
+ */
+class TrackingTable {
+public:
+    void remember(std::string_view key, uint64_t clientId);
+
+    /**
+     * Forgets the key and returns the ids of the clients that read it since it was last invalidated.
+     */
+    std::vector<uint64_t> invalidate(std::string_view key);
+
+    /**
+     * Forgets all keys and returns the ids of the clients that read any of them, each once.
+     */
+    std::vector<uint64_t> invalidateAll();
+
+    size_t size() const { return numKeys.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<std::string, std::unordered_set<uint64_t>, StringViewHash, std::equal_to<>> keys;
+
+    // Lets writes skip the lock while no client tracks anything, the common case.
+    std::atomic<size_t> numKeys{0};
+};
@@ -0,0 +1,62 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t numWorkers) {
+    workers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) { workers.emplace_back([this] { runWorker(); }); }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    batchStarted.notify_all();
+    for (auto &worker: workers) { worker.join(); }
+}
+
+void WorkerPool::run(size_t numTasks, const std::function<void(size_t)> &task) {
+    if (workers.empty() || numTasks <= 1) {
+        for (size_t i = 0; i < numTasks; ++i) { task(i); }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    batchFinished.wait(lock, [this] { return batch == nullptr; });
+
+    Batch current{&task, numTasks};
+    batch = &current;
+    batchStarted.notify_all();
+
+    // The calling thread takes tasks too, rather than only waiting for the workers.
+    while (runNextTask(lock)) {}
+    batchFinished.wait(lock, [&current] { return current.finished == current.numTasks; });
+
+    batch = nullptr;
+    lock.unlock();
+    batchFinished.notify_all();
+}
+
+bool WorkerPool::runNextTask(std::unique_lock<std::mutex> &lock) {
+    if (!batch || batch->next == batch->numTasks) { return false; }
+
+    // The batch outlives its last task, its submitter waits for every task to finish before it returns.
+    Batch &current = *batch;
+    size_t index = current.next++;
+
+    lock.unlock();
+    (*current.task)(index);
+    lock.lock();
+
+    if (++current.finished == current.numTasks) { batchFinished.notify_all(); }
+    return true;
+}
+
+void WorkerPool::runWorker() {
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (true) {
+        batchStarted.wait(lock, [this] { return stopping || (batch && batch->next < batch->numTasks); });
+        if (stopping) { return; }
+        runNextTask(lock);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed number of threads, started once, that split a batch of tasks with the thread that submits it. Used for
+ * work too large for one thread but too short to be worth starting threads for, such as a large SINTER.
+ */
+class WorkerPool {
+public:
+    /**
+     * Starts numWorkers threads. With none, every batch runs on the calling thread.
+     */
+    explicit WorkerPool(size_t numWorkers);
+
+    /**
+     * Stops the threads. No batch may be running.
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    /**
+     * Runs task(0) to task(numTasks - 1) on the workers and the calling thread, and returns once all have finished.
+     * Batches submitted from several threads run one after another.
+     */
+    void run(size_t numTasks, const std::function<void(size_t)> &task);
+
+private:
+    struct Batch {
+        const std::function<void(size_t)> *task;
+        size_t numTasks;
+        size_t next = 0;
+        size_t finished = 0;
+    };
+
+    // Runs the next task of the batch in progress, if one is left, with the lock released while it runs.
+    bool runNextTask(std::unique_lock<std::mutex> &lock);
+    void runWorker();
+
+    std::mutex mtx;
+    std::condition_variable batchStarted;
+    std::condition_variable batchFinished;
+
+    // The batch in progress, owned by the thread that submitted it.
+    Batch *batch = nullptr;
+    bool stopping = false;
+
+    // Started last, once the members they use exist.
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,44 @@
+#include "command_table.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr CommandTable table{std::array{
+            CommandSpec{"get", 2, CMD_READONLY, 1, 1, 1, nullptr},
+            CommandSpec{"set", -3, CMD_WRITE, 1, 1, 1, nullptr},
+            CommandSpec{"mset", -3, CMD_WRITE, 1, -1, 2, nullptr},
+            CommandSpec{"ping", -1, 0, 0, 0, 0, nullptr},
+    }};
+}// namespace
+
+TEST(CommandTableTests, FindIgnoresCase) {
+    ASSERT_NE(table.find("get"), nullptr);
+    EXPECT_EQ(table.find("GET")->name, "get");
+    EXPECT_EQ(table.find("mSeT")->name, "mset");
+    EXPECT_EQ(table.find("getx"), nullptr);
+    EXPECT_EQ(table.find(""), nullptr);
+
+    // Resolved at compile time.
+    static_assert(table.find("PING") != nullptr);
+}
+
+TEST(CommandTableTests, CheckArity) {
+    EXPECT_TRUE(table.find("get")->acceptsArgs(2));
+    EXPECT_FALSE(table.find("get")->acceptsArgs(3));
+    EXPECT_FALSE(table.find("set")->acceptsArgs(2));
+    EXPECT_TRUE(table.find("set")->acceptsArgs(5));
+}
+
+TEST(CommandTableTests, ListKeys) {
+    std::vector<std::string_view> args{"MSET", "k1", "v1", "k2", "v2"};
+    std::vector<std::string> keys;
+
+    table.find("mset")->forEachKey(args, [&](std::string_view key) { keys.emplace_back(key); });
+    EXPECT_EQ(keys, (std::vector<std::string>{"k1", "k2"}));
+
+    keys.clear();
+    table.find("ping")->forEachKey(args, [&](std::string_view key) { keys.emplace_back(key); });
+    EXPECT_TRUE(keys.empty());
+}
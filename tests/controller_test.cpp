@@ -1,8 +1,14 @@
 #include "controller.h"
+#include "persister.h"
 #include "protocol.h"
 #include "redis_type.h"
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <cstdio>
+#include <latch>
+#include <thread>
+
 
 TEST(ControllerTests, HandleECHOInvalidNumArgs) {
     Controller controller;
@@ -239,4 +245,654 @@ TEST(ControllerTests, HandleExistsMultipleKeys) {
     auto bulkData = std::get<RedisType::Integer>(result).data;
 
     ASSERT_EQ(bulkData, 2);
-}
\ No newline at end of file
+}
+
+TEST(ControllerTests, HandleGETIntoOutputBuffer) {
+    Controller controller;
+    std::string large(64 * 1024, 'x');
+
+    controller.handleCommand(
+            {RedisType::BulkString("SET"), RedisType::BulkString("small"), RedisType::BulkString("val")});
+    controller.handleCommand(
+            {RedisType::BulkString("SET"), RedisType::BulkString("large"), RedisType::BulkString(large)});
+
+    OutputBuffer out;
+    controller.handleCommand(std::vector<std::string_view>{"GET", "small"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"get", "large"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GET", "missing"}, out);
+
+    ASSERT_EQ(out.toString(), "$3\r\nval\r\n$65536\r\n" + large + "\r\n$-1\r\n");
+}
+
+TEST(ControllerTests, HandleSETTakesOverArgumentBuffer) {
+    Controller controller;
+    auto value = std::make_shared<std::string>(64 * 1024, 'x');
+    const auto *data = value->data();
+
+    std::vector<std::string_view> args{"SET", "key", *value};
+    std::vector<std::shared_ptr<std::string>> buffers{nullptr, nullptr, value};
+    OutputBuffer out;
+    controller.handleCommand(args, out, buffers);
+    ASSERT_EQ(out.toString(), "+OK\r\n");
+
+    // GET references the stored value, which is the buffer the argument was received into.
+    OutputBuffer reply;
+    controller.handleCommand(std::vector<std::string_view>{"GET", "key"}, reply);
+
+    struct iovec iov[4];
+    ASSERT_EQ(reply.prepare(iov, 4), 3);
+    EXPECT_EQ(iov[1].iov_base, data);
+}
+
+TEST(ControllerTests, HandleHELLO) {
+    Controller controller;
+    auto client = controller.connectClient();
+
+    OutputBuffer out;
+    controller.handleCommand(*client, std::vector<std::string_view>{"HELLO", "3"}, out);
+    auto reply = out.toString();
+
+    EXPECT_EQ(client->protocol, 3);
+    EXPECT_TRUE(reply.starts_with("%7\r\n$6\r\nserver\r\n$5\r\nredis\r\n"));
+    EXPECT_NE(reply.find("$5\r\nproto\r\n:3\r\n"), std::string::npos);
+
+    // Nulls are encoded the RESP3 way from now on.
+    OutputBuffer get;
+    controller.handleCommand(*client, std::vector<std::string_view>{"GET", "missing"}, get);
+    EXPECT_EQ(get.toString(), "_\r\n");
+
+    OutputBuffer invalid;
+    controller.handleCommand(*client, std::vector<std::string_view>{"HELLO", "4"}, invalid);
+    EXPECT_EQ(invalid.toString(), "-NOPROTO unsupported protocol version\r\n");
+    EXPECT_EQ(client->protocol, 3);
+}
+
+TEST(ControllerTests, HandleCLIENTTRACKINGInvalidatesReadKeys) {
+    Controller controller;
+    int notified = 0;
+    auto reader = controller.connectClient([&](uint64_t) { ++notified; });
+    auto writer = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*reader, std::vector<std::string_view>{"HELLO", "3"}, out);
+    controller.handleCommand(*reader, std::vector<std::string_view>{"CLIENT", "TRACKING", "on"}, out);
+    controller.handleCommand(*reader, std::vector<std::string_view>{"GET", "key"}, out);
+
+    controller.handleCommand(*writer, std::vector<std::string_view>{"SET", "other", "val"}, out);
+    EXPECT_EQ(notified, 0);
+
+    controller.handleCommand(*writer, std::vector<std::string_view>{"SET", "key", "val"}, out);
+    EXPECT_EQ(notified, 1);
+
+    auto messages = reader->takeMessages();
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(*messages[0], ">2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nkey\r\n");
+
+    // The key is only tracked again once the client reads it again.
+    controller.handleCommand(*writer, std::vector<std::string_view>{"SET", "key", "val2"}, out);
+    EXPECT_TRUE(reader->takeMessages().empty());
+}
+
+TEST(ControllerTests, HandleCLIENTTRACKINGNoLoop) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*client, std::vector<std::string_view>{"HELLO", "3"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"CLIENT", "TRACKING", "on", "NOLOOP"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"GET", "key"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"SET", "key", "val"}, out);
+
+    EXPECT_TRUE(client->takeMessages().empty());
+}
+
+TEST(ControllerTests, HandleCOMMANDINFO) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"COMMAND", "INFO", "get", "nosuchcommand"}, out);
+
+    EXPECT_EQ(out.toString(), "*2\r\n*10\r\n$3\r\nget\r\n:2\r\n*2\r\n+readonly\r\n+fast\r\n:1\r\n:1\r\n:1\r\n"
+                              "*0\r\n*0\r\n*0\r\n*0\r\n*-1\r\n");
+}
+
+TEST(ControllerTests, HandleCommandNameInAnyCase) {
+    Controller controller;
+
+    auto result = controller.handleCommand({RedisType::BulkString("CoMmAnD"), RedisType::BulkString("count")});
+
+    ASSERT_TRUE(std::holds_alternative<RedisType::Integer>(result));
+    EXPECT_GT(std::get<RedisType::Integer>(result).data, 5);
+
+    result = controller.handleCommand({RedisType::BulkString("NOSUCHCOMMAND")});
+    ASSERT_TRUE(std::holds_alternative<RedisType::SimpleError>(result));
+}
+
+TEST(ControllerTests, HandleMSETAndMGET) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"MSET", "a", "1", "b", "2", "a", "3"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MGET", "a", "missing", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MSET", "a", "1", "b"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n*3\r\n$1\r\n3\r\n$-1\r\n$1\r\n2\r\n"
+                              "-ERR wrong number of arguments for 'mset' command\r\n");
+}
+
+TEST(ControllerTests, HandleMSETNX) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"MSETNX", "a", "1", "b", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MSETNX", "b", "3", "c", "4"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MGET", "a", "b", "c"}, out);
+
+    EXPECT_EQ(out.toString(), ":1\r\n:0\r\n*3\r\n$1\r\n1\r\n$1\r\n2\r\n$-1\r\n");
+}
+
+TEST(ControllerTests, HandleIncrementCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"INCR", "n"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCRBY", "n", "41"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DECRBY", "n", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DECR", "n"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GET", "n"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCRBYFLOAT", "n", "0.5"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MGET", "n"}, out);
+
+    EXPECT_EQ(out.toString(), ":1\r\n:42\r\n:40\r\n:39\r\n$2\r\n39\r\n$4\r\n39.5\r\n*1\r\n$4\r\n39.5\r\n");
+}
+
+TEST(ControllerTests, RejectInvalidIncrements) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"SET", "s", "abc"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCR", "s"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCRBY", "n", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DECRBY", "n", "-9223372036854775808"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SET", "n", "9223372036854775807"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCR", "n"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCRBYFLOAT", "s", "1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCRBYFLOAT", "n", "inf"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n"
+                              "-ERR value is not an integer or out of range\r\n"
+                              "-ERR value is not an integer or out of range\r\n"
+                              "-ERR decrement would overflow\r\n"
+                              "+OK\r\n"
+                              "-ERR increment or decrement would overflow\r\n"
+                              "-ERR value is not a valid float\r\n"
+                              "-ERR value is not a valid float\r\n");
+}
+
+TEST(ControllerTests, HandleStringRangeCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"APPEND", "s", "Hello"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"APPEND", "s", " World"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SETRANGE", "s", "6", "Redis"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GETRANGE", "s", "-5", "-1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"STRLEN", "s"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"STRLEN", "missing"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SETRANGE", "s", "-1", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GETRANGE", "s", "a", "1"}, out);
+
+    EXPECT_EQ(out.toString(), ":5\r\n:11\r\n:11\r\n$5\r\nRedis\r\n:11\r\n:0\r\n"
+                              "-ERR offset is out of range\r\n"
+                              "-ERR value is not an integer or out of range\r\n");
+}
+
+TEST(ControllerTests, HandleDELAndUNLINK) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"MSET", "a", "1", "b", "2", "c", "3"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DEL", "a", "b", "missing"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"UNLINK", "c", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"EXISTS", "a", "b", "c"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n:2\r\n:1\r\n:0\r\n");
+}
+
+TEST(ControllerTests, HandleFLUSHALLInvalidatesAllKeys) {
+    Controller controller;
+    auto reader = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*reader, std::vector<std::string_view>{"HELLO", "3"}, out);
+    controller.handleCommand(*reader, std::vector<std::string_view>{"CLIENT", "TRACKING", "on"}, out);
+    controller.handleCommand(*reader, std::vector<std::string_view>{"MGET", "a", "b"}, out);
+    out.clear();
+
+    controller.handleCommand(std::vector<std::string_view>{"SET", "a", "1"}, out);
+    reader->takeMessages();
+
+    controller.handleCommand(std::vector<std::string_view>{"FLUSHALL", "ASYNC"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"FLUSHALL", "LATER"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"EXISTS", "a"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n+OK\r\n-ERR syntax error\r\n:0\r\n");
+
+    auto messages = reader->takeMessages();
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(*messages[0], ">2\r\n$10\r\ninvalidate\r\n_\r\n");
+}
+
+TEST(ControllerTests, HandleMULTIAndEXEC) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"SET", "a", "1"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"INCR", "a"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"INCRBY", "a", "x"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"GET", "a"}, out);
+
+    // Nothing runs before EXEC.
+    controller.handleCommand(std::vector<std::string_view>{"EXISTS", "a"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n+QUEUED\r\n+QUEUED\r\n+QUEUED\r\n+QUEUED\r\n:0\r\n"
+                              "*4\r\n+OK\r\n:2\r\n-ERR value is not an integer or out of range\r\n$1\r\n2\r\n"
+                              "-ERR EXEC without MULTI\r\n");
+}
+
+TEST(ControllerTests, DiscardTransactionWithInvalidCommand) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"SET", "a", "1"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"GET"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"SET", "a", "1"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"DISCARD"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXISTS", "a"}, out);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n+QUEUED\r\n-ERR wrong number of arguments for 'get' command\r\n"
+                              "-EXECABORT Transaction discarded because of previous errors.\r\n"
+                              "+OK\r\n+QUEUED\r\n+OK\r\n:0\r\n");
+}
+
+TEST(ControllerTests, HandleWATCH) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"SET", "stock", "10"}, out);
+    out.clear();
+
+    // Unchanged since WATCH: the transaction runs.
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "stock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"DECR", "stock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n+OK\r\n+QUEUED\r\n*1\r\n:9\r\n");
+    out.clear();
+
+    // Written by another client in between: the transaction fails.
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "stock"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCR", "stock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "other"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"DECR", "stock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GET", "stock"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n:10\r\n+OK\r\n-ERR WATCH inside MULTI is not allowed\r\n+QUEUED\r\n*-1\r\n"
+                              "$2\r\n10\r\n");
+    out.clear();
+
+    // EXEC unwatches all keys, and deleting a watched key counts as a write.
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "stock"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DEL", "stock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"UNWATCH"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n:1\r\n+OK\r\n+OK\r\n*0\r\n");
+}
+
+TEST(ControllerTests, HandleWATCHOfRemovedKeys) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    // A missing key that stays missing is unchanged.
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "lock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n+OK\r\n*0\r\n");
+    out.clear();
+
+    // Created and deleted again after WATCH: missing both times, but changed.
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "lock"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SET", "lock", "1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"DEL", "lock"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n+OK\r\n:1\r\n+OK\r\n*-1\r\n");
+    out.clear();
+
+    // Removed by FLUSHALL.
+    controller.handleCommand(std::vector<std::string_view>{"SET", "lock", "1"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "lock"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"FLUSHALL"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+    EXPECT_EQ(out.toString(), "+OK\r\n+OK\r\n+OK\r\n+OK\r\n*-1\r\n");
+    out.clear();
+
+    // Expired, whether or not it was removed yet.
+    for (bool removed: {false, true}) {
+        controller.handleCommand(std::vector<std::string_view>{"SET", "lock", "1", "PX", "1"}, out);
+        controller.handleCommand(*client, std::vector<std::string_view>{"WATCH", "lock"}, out);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (removed) { controller.handleCommand(std::vector<std::string_view>{"GET", "lock"}, out); }
+        controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+        controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+        EXPECT_EQ(out.toString(), removed ? "+OK\r\n+OK\r\n$-1\r\n+OK\r\n*-1\r\n" : "+OK\r\n+OK\r\n+OK\r\n*-1\r\n");
+        out.clear();
+    }
+}
+
+TEST(ControllerTests, ReplayLogOfConcurrentWrites) {
+    std::string fileName = ::testing::TempDir() + "controller_test_wal.aof";
+    std::remove(fileName.c_str());
+
+    // The order of the list's elements shows whether the log holds the writes in the order they were applied.
+    std::string live;
+    {
+        Controller controller(fileName);
+        auto client = controller.connectClient();
+        std::latch start(5);
+
+        {
+            std::vector<std::jthread> writers;
+            for (int i = 0; i < 4; ++i) {
+                writers.emplace_back([&controller, &start, i] {
+                    OutputBuffer out;
+                    start.arrive_and_wait();
+                    for (int n = 0; n < 1000; ++n) {
+                        auto element = std::to_string(i) + ":" + std::to_string(n);
+                        controller.handleCommand(std::vector<std::string_view>{"RPUSH", "list", element}, out);
+                        controller.handleCommand(std::vector<std::string_view>{"INCR", "counter"}, out);
+                    }
+                });
+            }
+
+            writers.emplace_back([&controller, &client, &start] {
+                OutputBuffer out;
+                start.arrive_and_wait();
+                for (int n = 0; n < 500; ++n) {
+                    auto element = "exec:" + std::to_string(n);
+                    controller.handleCommand(*client, std::vector<std::string_view>{"MULTI"}, out);
+                    controller.handleCommand(*client, std::vector<std::string_view>{"RPUSH", "list", element}, out);
+                    controller.handleCommand(*client, std::vector<std::string_view>{"INCR", "counter"}, out);
+                    controller.handleCommand(*client, std::vector<std::string_view>{"EXEC"}, out);
+                }
+            });
+        }
+
+        OutputBuffer out;
+        controller.handleCommand(std::vector<std::string_view>{"LRANGE", "list", "0", "-1"}, out);
+        controller.handleCommand(std::vector<std::string_view>{"GET", "counter"}, out);
+        live = out.toString();
+    }
+
+    Controller restored;
+    WriteAheadLogPersister::restoreFromFile(fileName, restored);
+
+    OutputBuffer out;
+    restored.handleCommand(std::vector<std::string_view>{"LRANGE", "list", "0", "-1"}, out);
+    restored.handleCommand(std::vector<std::string_view>{"GET", "counter"}, out);
+    EXPECT_TRUE(live.ends_with("$4\r\n4500\r\n"));
+    EXPECT_EQ(out.toString(), live);
+
+    std::remove(fileName.c_str());
+}
+
+TEST(ControllerTests, HandleSUBSCRIBEAndPUBLISH) {
+    Controller controller;
+    auto subscriber = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"SUBSCRIBE", "a", "b"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"PSUBSCRIBE", "c*"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"GET", "k"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"PING"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"UNSUBSCRIBE"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"PUNSUBSCRIBE", "c*"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"UNSUBSCRIBE"}, out);
+
+    EXPECT_EQ(out.toString(), "*3\r\n$9\r\nsubscribe\r\n$1\r\na\r\n:1\r\n"
+                              "*3\r\n$9\r\nsubscribe\r\n$1\r\nb\r\n:2\r\n"
+                              "*3\r\n$10\r\npsubscribe\r\n$2\r\nc*\r\n:3\r\n"
+                              "-ERR Can't execute 'get': only (P|S)SUBSCRIBE / (P|S)UNSUBSCRIBE / PING / QUIT / RESET "
+                              "are allowed in this context\r\n"
+                              "*2\r\n$4\r\npong\r\n$0\r\n\r\n"
+                              "*3\r\n$11\r\nunsubscribe\r\n$1\r\na\r\n:2\r\n"
+                              "*3\r\n$11\r\nunsubscribe\r\n$1\r\nb\r\n:1\r\n"
+                              "*3\r\n$12\r\npunsubscribe\r\n$2\r\nc*\r\n:0\r\n"
+                              "*3\r\n$11\r\nunsubscribe\r\n$-1\r\n:0\r\n");
+}
+
+TEST(ControllerTests, PublishToSubscribers) {
+    Controller controller;
+    auto subscriber = controller.connectClient();
+    OutputBuffer out;
+
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"HELLO", "3"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"SUBSCRIBE", "news"}, out);
+    controller.handleCommand(*subscriber, std::vector<std::string_view>{"GET", "k"}, out);
+    out.clear();
+
+    controller.handleCommand(std::vector<std::string_view>{"PUBLISH", "news", "hello"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PUBLISH", "other", "hello"}, out);
+    EXPECT_EQ(out.toString(), ":1\r\n:0\r\n");
+
+    auto messages = subscriber->takeMessages();
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(*messages[0], ">3\r\n$7\r\nmessage\r\n$4\r\nnews\r\n$5\r\nhello\r\n");
+
+    // Disconnecting ends the subscriptions.
+    controller.disconnectClient(*subscriber);
+    controller.handleCommand(std::vector<std::string_view>{"PUBLISH", "news", "hello"}, out);
+    EXPECT_EQ(out.toString(), ":1\r\n:0\r\n:0\r\n");
+}
+
+TEST(ControllerTests, HandleListCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"RPUSH", "l", "a", "b", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPUSH", "l", "z"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LRANGE", "l", "0", "-1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPOP", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"RPOP", "l", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LLEN", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPOP", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPOP", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPOP", "l", "0"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "l"}, out);
+
+    EXPECT_EQ(out.toString(), ":3\r\n:4\r\n*4\r\n$1\r\nz\r\n$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n$1\r\nz\r\n"
+                              "*2\r\n$1\r\nc\r\n$1\r\nb\r\n:1\r\n+list\r\n$1\r\na\r\n$-1\r\n*-1\r\n+none\r\n");
+}
+
+TEST(ControllerTests, RejectWrongType) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"RPUSH", "l", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SET", "s", "a"}, out);
+    out.clear();
+
+    controller.handleCommand(std::vector<std::string_view>{"GET", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"INCR", "l"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"LPUSH", "s", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"BLPOP", "missing", "s", "0"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"MGET", "l", "s"}, out);
+
+    std::string wrongType = "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+    EXPECT_EQ(out.toString(), wrongType + wrongType + wrongType + wrongType + "*2\r\n$-1\r\n$1\r\na\r\n");
+}
+
+TEST(ControllerTests, HandleHashCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"HSET", "h", "a", "1", "b", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HSET", "h", "a", "3"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HSET", "h", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HGET", "h", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HGET", "h", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HMGET", "h", "b", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HINCRBY", "h", "a", "-5"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HINCRBY", "h", "a", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "h"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HDEL", "h", "b", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HGETALL", "h"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"GET", "h"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HDEL", "h", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"HGETALL", "h"}, out);
+
+    EXPECT_EQ(out.toString(), ":2\r\n:0\r\n-ERR wrong number of arguments for 'hset' command\r\n$1\r\n3\r\n$-1\r\n"
+                              "*2\r\n$1\r\n2\r\n$-1\r\n:-2\r\n"
+                              "-ERR value is not an integer or out of range\r\n+hash\r\n:1\r\n"
+                              "*2\r\n$1\r\na\r\n$2\r\n-2\r\n"
+                              "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n:1\r\n*0\r\n");
+}
+
+TEST(ControllerTests, HandleHyperLogLogCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"PFADD", "a", "x", "y", "z"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFADD", "a", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFADD", "b", "z", "w"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFCOUNT", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFCOUNT", "a", "b", "missing"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFMERGE", "c", "a", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFCOUNT", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SET", "s", "value"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"PFADD", "s", "x"}, out);
+
+    EXPECT_EQ(out.toString(), ":1\r\n:0\r\n:1\r\n:3\r\n:4\r\n+OK\r\n:4\r\n+string\r\n+OK\r\n"
+                              "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n");
+}
+
+TEST(ControllerTests, HandleSetCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"SADD", "a", "1", "2", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SADD", "b", "2", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SISMEMBER", "a", "2"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SCARD", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SINTER", "a", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SDIFF", "a", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SREM", "a", "1", "3"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SMEMBERS", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"SADD", "b"}, out);
+
+    EXPECT_EQ(out.toString(), ":2\r\n:2\r\n:1\r\n:2\r\n*1\r\n$1\r\n2\r\n*1\r\n$1\r\n1\r\n:1\r\n"
+                              "*1\r\n$1\r\n2\r\n+set\r\n-ERR wrong number of arguments for 'sadd' command\r\n");
+}
+
+TEST(ControllerTests, HandleSortedSetCommands) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "1", "a", "2", "b", "2.5", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "XX", "CH", "3", "a", "1", "d"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "NX", "XX", "1", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "1", "a", "x"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZINCRBY", "z", "-2.5", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZSCORE", "z", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANK", "z", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZREVRANK", "z", "a", "WITHSCORE"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANGE", "z", "0", "-1", "WITHSCORES"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANGE", "z", "(3", "-inf", "BYSCORE", "REV"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANGEBYSCORE", "z", "0", "+inf", "LIMIT", "1", "1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANGEBYSCORE", "z", "x", "1"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZREM", "z", "a", "missing"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZCARD", "z"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"TYPE", "z"}, out);
+
+    EXPECT_EQ(out.toString(), ":3\r\n:1\r\n-ERR XX and NX options at the same time are not compatible\r\n"
+                              "-ERR syntax error\r\n$1\r\n0\r\n$1\r\n3\r\n:2\r\n*2\r\n:0\r\n$1\r\n3\r\n"
+                              "*6\r\n$1\r\nc\r\n$1\r\n0\r\n$1\r\nb\r\n$1\r\n2\r\n$1\r\na\r\n$1\r\n3\r\n"
+                              "*2\r\n$1\r\nb\r\n$1\r\nc\r\n*1\r\n$1\r\nb\r\n"
+                              "-ERR min or max is not a float\r\n:1\r\n:2\r\n+zset\r\n");
+}
+
+TEST(ControllerTests, RejectScoresWithTwoSigns) {
+    Controller controller;
+    OutputBuffer out;
+
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "+1", "a", "+inf", "b"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "+-1", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZADD", "z", "++1", "c"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZINCRBY", "z", "+-1", "a"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZRANGE", "z", "+-1", "+inf", "BYSCORE"}, out);
+    controller.handleCommand(std::vector<std::string_view>{"ZCARD", "z"}, out);
+
+    EXPECT_EQ(out.toString(), ":2\r\n-ERR value is not a valid float\r\n-ERR value is not a valid float\r\n"
+                              "-ERR value is not a valid float\r\n-ERR min or max is not a float\r\n:2\r\n");
+}
+
+TEST(ControllerTests, HandleBLPOP) {
+    Controller controller;
+    auto client = controller.connectClient();
+    OutputBuffer out;
+
+    // Without a connection to wait on, the command only tries once.
+    controller.handleCommand(std::vector<std::string_view>{"BLPOP", "queue", "0"}, out);
+    EXPECT_EQ(out.toString(), "*-1\r\n");
+    out.clear();
+
+    controller.handleCommand(*client, std::vector<std::string_view>{"BRPOP", "other", "queue", "0"}, out);
+    EXPECT_TRUE(client->blocked);
+    EXPECT_EQ(out.toString(), "");
+
+    // The push serves the blocked client through its mailbox, and replies with the length before that.
+    controller.handleCommand(std::vector<std::string_view>{"RPUSH", "queue", "a", "b"}, out);
+    EXPECT_EQ(out.toString(), ":2\r\n");
+    EXPECT_FALSE(client->blocked);
+
+    auto messages = client->takeMessages();
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(*messages[0], "*2\r\n$5\r\nqueue\r\n$1\r\nb\r\n");
+
+    out.clear();
+    controller.handleCommand(*client, std::vector<std::string_view>{"BLPOP", "queue", "0"}, out);
+    EXPECT_EQ(out.toString(), "*2\r\n$5\r\nqueue\r\n$1\r\na\r\n");
+    EXPECT_FALSE(client->blocked);
+
+    // Timing out replies with a null array, a later push is not served to the client.
+    controller.handleCommand(*client, std::vector<std::string_view>{"BLPOP", "queue", "0.5"}, out);
+    EXPECT_TRUE(client->blocked);
+    controller.timeoutBlockedClient(*client);
+    EXPECT_FALSE(client->blocked);
+    messages = client->takeMessages();
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(*messages[0], "*-1\r\n");
+
+    out.clear();
+    controller.handleCommand(std::vector<std::string_view>{"RPUSH", "queue", "c"}, out);
+    controller.handleCommand(*client, std::vector<std::string_view>{"BLPOP", "queue", "-1"}, out);
+    EXPECT_EQ(out.toString(), ":1\r\n-ERR timeout is negative\r\n");
+    EXPECT_TRUE(client->takeMessages().empty());
+}
@@ -0,0 +1,43 @@
+#include "crlf_scan.h"
+#include "cpu_features.h"
+#include "gtest/gtest.h"
+
+#include <random>
+
+namespace {
+    std::vector<uint8_t> bytes(const std::string &str) { return {str.begin(), str.end()}; }
+}// namespace
+
+TEST(CrlfScanTests, FindCrlf) {
+    EXPECT_EQ(findCrlf(bytes("$5\r\nhello\r\n")), 2);
+    EXPECT_EQ(findCrlf(bytes("no separator")), std::string::npos);
+    EXPECT_EQ(findCrlf(bytes("")), std::string::npos);
+    EXPECT_EQ(findCrlf(bytes("ends with cr\r")), std::string::npos);
+    EXPECT_EQ(findCrlf(bytes("\n\r\r\n")), 2);
+}
+
+TEST(CrlfScanTests, FindCrlfAcrossBlocks) {
+    // Place the separator on every offset around the 16 and 32 byte block boundaries.
+    for (size_t pos = 0; pos < 70; ++pos) {
+        std::string str(80, 'x');
+        str[pos] = '\r';
+        str[pos + 1] = '\n';
+        EXPECT_EQ(findCrlf(bytes(str)), pos);
+    }
+}
+
+TEST(CrlfScanTests, KernelsAgree) {
+    std::mt19937 gen(42);
+    // Mostly separator bytes, so lone '\r' and '\n' are frequent.
+    std::uniform_int_distribution<int> dist(0, 3);
+    const uint8_t alphabet[] = {'\r', '\n', 'a', '\r'};
+
+    for (int round = 0; round < 1000; ++round) {
+        std::vector<uint8_t> buffer(round % 100);
+        for (auto &byte: buffer) { byte = alphabet[dist(gen)]; }
+
+        size_t expected = CrlfScan::scalar(buffer.data(), buffer.size());
+        if (CpuFeatures::hasSse2()) { EXPECT_EQ(CrlfScan::sse2(buffer.data(), buffer.size()), expected); }
+        if (CpuFeatures::hasAvx2()) { EXPECT_EQ(CrlfScan::avx2(buffer.data(), buffer.size()), expected); }
+    }
+}
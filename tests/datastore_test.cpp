@@ -1,6 +1,8 @@
 #include "datastore.h"
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <thread>
 
 TEST(DataStoreTests, GetWithoutExpiry) {
@@ -11,6 +13,19 @@ TEST(DataStoreTests, GetWithoutExpiry) {
     ASSERT_EQ(res, "val");
 }
 
+TEST(DataStoreTests, GetRefSharesStoredValue) {
+    DataStore store;
+    store.set("key", "val");
+
+    auto first = store.getRef("key");
+    auto second = store.getRef("key");
+    ASSERT_NE(first, nullptr);
+    ASSERT_EQ(*first, "val");
+    ASSERT_EQ(first.get(), second.get());
+
+    ASSERT_EQ(store.getRef("missing"), nullptr);
+}
+
 //TEST(DataStoreTests, GetExpired) {
 //    DataStore store;
 //    store.setWithExpiry("key", "val", std::chrono::system_clock::now() + std::chrono::milliseconds(100));
@@ -67,4 +82,375 @@ TEST(DataStoreTests, GetWithoutExpiry) {
 //
 //    auto val2 = store.get("key2");
 //    ASSERT_FALSE(val2.has_value());
-//}
\ No newline at end of file
+//}
+TEST(DataStoreTests, GetValuesInOrder) {
+    DataStore store;
+    store.set("a", "one");
+    store.set("c", "3");
+
+    std::vector<std::string_view> keys{"a", "b", "c", "a"};
+    auto values = store.getValues(keys);
+
+    ASSERT_EQ(values.size(), 4);
+    EXPECT_EQ(*std::get<std::shared_ptr<const std::string>>(*values[0]), "one");
+    EXPECT_FALSE(values[1].has_value());
+    EXPECT_EQ(std::get<long long>(*values[2]), 3);
+    EXPECT_EQ(std::get<std::shared_ptr<const std::string>>(*values[3]).get(),
+              std::get<std::shared_ptr<const std::string>>(*values[0]).get());
+}
+
+TEST(DataStoreTests, EncodeCanonicalIntegers) {
+    EXPECT_EQ(std::get<long long>(encodeValue("42")), 42);
+    EXPECT_EQ(std::get<long long>(encodeValue("-9223372036854775808")), INT64_MIN);
+
+    // Anything that would not print back the same stays a string.
+    for (std::string_view str: {"007", "-0", "+1", " 1", "1.0", "", "9223372036854775808"}) {
+        EXPECT_TRUE(std::holds_alternative<std::shared_ptr<const std::string>>(encodeValue(str))) << str;
+    }
+}
+
+TEST(DataStoreTests, IncrementInPlace) {
+    DataStore store;
+
+    EXPECT_EQ(store.incrementBy("counter", 5), 5);
+    EXPECT_EQ(store.incrementBy("counter", -7), -2);
+    EXPECT_EQ(store.get("counter"), "-2");
+
+    store.set("max", std::to_string(INT64_MAX));
+    EXPECT_EQ(store.incrementBy("max", 1), std::unexpected(StoreError::Overflow));
+    EXPECT_EQ(store.get("max"), std::to_string(INT64_MAX));
+
+    store.set("text", "abc");
+    EXPECT_EQ(store.incrementBy("text", 1), std::unexpected(StoreError::NotAnInteger));
+}
+
+TEST(DataStoreTests, IncrementExpiredKeyFromZero) {
+    DataStore store;
+    store.setWithExpiry("counter", "41", std::chrono::system_clock::now() - std::chrono::milliseconds(1));
+
+    EXPECT_EQ(store.incrementBy("counter", 1), 1);
+    EXPECT_EQ(store.get("counter"), "1");
+}
+
+TEST(DataStoreTests, IncrementByFloat) {
+    DataStore store;
+    store.set("n", "10.50");
+
+    EXPECT_EQ(store.incrementByFloat("n", 0.1L), "10.6");
+    EXPECT_EQ(store.incrementByFloat("n", -5.6L), "5");
+    EXPECT_EQ(std::get<long long>(*store.getValue("n")), 5);
+    EXPECT_EQ(store.incrementByFloat("n", -5), "0");
+
+    store.set("text", "abc");
+    EXPECT_EQ(store.incrementByFloat("text", 1), std::unexpected(StoreError::NotAFloat));
+}
+
+TEST(DataStoreTests, SetManyIfAbsent) {
+    DataStore store;
+    store.set("b", "old");
+
+    std::vector<DataStore::KeyValue> entries{{"a", encodeValue("1")}, {"b", encodeValue("2")}};
+    ASSERT_FALSE(store.setManyIfAbsent(entries));
+    EXPECT_FALSE(store.exists("a"));
+    EXPECT_EQ(store.get("b"), "old");
+
+    entries[1].first = "c";
+    ASSERT_TRUE(store.setManyIfAbsent(entries));
+    EXPECT_EQ(store.get("a"), "1");
+    EXPECT_EQ(store.get("c"), "2");
+}
+
+TEST(DataStoreTests, AppendCopiesValueHeldByReader) {
+    DataStore store;
+    EXPECT_EQ(store.append("log", "a"), 1);
+    EXPECT_EQ(store.append("log", "b"), 2);
+
+    auto snapshot = store.getRef("log");
+    EXPECT_EQ(store.append("log", "c"), 3);
+
+    EXPECT_EQ(*snapshot, "ab");
+    EXPECT_EQ(store.get("log"), "abc");
+
+    store.set("n", "12");
+    EXPECT_EQ(store.append("n", "3"), 3);
+    EXPECT_EQ(store.get("n"), "123");
+}
+
+TEST(DataStoreTests, SetAndGetRange) {
+    DataStore store;
+
+    EXPECT_EQ(store.setRange("k", 0, ""), 0);
+    EXPECT_FALSE(store.exists("k"));
+
+    EXPECT_EQ(store.setRange("k", 2, "ab"), 4);
+    EXPECT_EQ(store.get("k"), std::string("\0\0ab", 4));
+    EXPECT_EQ(store.setRange("k", 1, "xyz"), 4);
+    EXPECT_EQ(store.length("k"), 4);
+    EXPECT_EQ(store.setRange("k", DataStore::DEFAULT_MAX_STRING_LENGTH, "x"), std::unexpected(StoreError::TooLarge));
+
+    EXPECT_EQ(store.getRange("k", 1, 2), "xy");
+    EXPECT_EQ(store.getRange("k", -3, -1), "xyz");
+    EXPECT_EQ(store.getRange("k", 0, 100), std::string("\0xyz", 4));
+    EXPECT_EQ(store.getRange("k", 3, 1), "");
+    EXPECT_EQ(store.getRange("k", -1, -3), "");
+    EXPECT_EQ(store.getRange("missing", 0, -1), "");
+
+    store.set("n", "-123");
+    EXPECT_EQ(store.length("n"), 4);
+    EXPECT_EQ(store.getRange("n", 1, -1), "123");
+}
+
+TEST(DataStoreTests, ConfiguredMaxStringLength) {
+    DataStore store({}, 8);
+
+    EXPECT_EQ(store.append("k", "12345678"), 8);
+    EXPECT_EQ(store.append("k", "9"), std::unexpected(StoreError::TooLarge));
+    EXPECT_EQ(store.setRange("k", 7, "xy"), std::unexpected(StoreError::TooLarge));
+    EXPECT_EQ(store.setRange("k", 6, "xy"), 8);
+    EXPECT_EQ(store.get("k"), "123456xy");
+}
+
+TEST(DataStoreTests, RemoveKeys) {
+    DataStore store;
+    store.set("a", "1");
+    store.set("b", "2");
+    store.setWithExpiry("expired", "3", std::chrono::system_clock::now() - std::chrono::milliseconds(1));
+
+    std::vector<std::string_view> keys{"a", "missing", "expired", "a"};
+    EXPECT_EQ(store.remove(keys, false), 1);
+    EXPECT_EQ(store.count(), 1);
+
+    store.clear(false);
+    EXPECT_EQ(store.count(), 0);
+}
+
+TEST(DataStoreTests, FreeLargeValuesLazily) {
+    DataStore store;
+    store.set("large", std::string(DataStore::LAZY_FREE_THRESHOLD, 'x'));
+    store.set("small", "1");
+
+    std::weak_ptr<const std::string> value = store.getRef("large");
+    std::vector<std::string_view> keys{"large", "small"};
+    EXPECT_EQ(store.remove(keys, true), 2);
+    EXPECT_FALSE(store.get("large").has_value());
+
+    // Freed on the lazy-free thread, which may not have got to it yet.
+    for (int i = 0; i < 100 && !value.expired(); ++i) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    EXPECT_TRUE(value.expired());
+
+    store.set("large", std::string(DataStore::LAZY_FREE_THRESHOLD, 'x'));
+    value = store.getRef("large");
+    store.clear(true);
+    EXPECT_EQ(store.count(), 0);
+
+    for (int i = 0; i < 100 && !value.expired(); ++i) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    EXPECT_TRUE(value.expired());
+}
+
+TEST(DataStoreTests, PushPopAndRange) {
+    DataStore store;
+    std::vector<std::string_view> elements{"a", "b", "c"};
+
+    EXPECT_EQ(store.push("list", elements, false)->length, 3);
+    EXPECT_EQ(store.push("list", elements, true)->length, 6);
+    EXPECT_EQ(store.listRange("list", 0, -1), (std::vector<std::string>{"c", "b", "a", "a", "b", "c"}));
+    EXPECT_EQ(store.listRange("list", -2, 100), (std::vector<std::string>{"b", "c"}));
+    EXPECT_EQ(store.listRange("list", 4, 2), std::vector<std::string>{});
+
+    EXPECT_EQ(store.pop("list", 2, true), (std::vector<std::string>{"c", "b"}));
+    EXPECT_EQ(store.pop("list", 10, false), (std::vector<std::string>{"c", "b", "a", "a"}));
+
+    // An emptied list is removed.
+    EXPECT_FALSE(store.exists("list"));
+    EXPECT_EQ(store.listLength("list"), 0);
+}
+
+TEST(DataStoreTests, RejectWrongType) {
+    DataStore store;
+    std::vector<std::string_view> elements{"a"};
+    store.set("str", "1");
+    store.push("list", elements, false);
+
+    EXPECT_EQ(store.push("str", elements, false), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.listLength("str"), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.incrementBy("list", 1), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.append("list", "x"), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.length("list"), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.getRef("list"), nullptr);
+}
+
+TEST(DataStoreTests, SetAndRemoveHashFields) {
+    DataStore store;
+    std::vector<DataStore::FieldValue> fields{{"a", "1"}, {"b", "2"}, {"a", "3"}};
+
+    EXPECT_EQ(store.hashSet("h", fields), 2);
+    std::vector<std::string_view> lookups{"a", "missing", "b"};
+    EXPECT_EQ(store.hashGet("h", lookups), (std::vector<std::optional<std::string>>{"3", std::nullopt, "2"}));
+    EXPECT_EQ(store.hashIncrementBy("h", "a", 4), 7);
+    EXPECT_EQ(store.hashIncrementBy("h", "c", -1), -1);
+    EXPECT_EQ(store.hashGetAll("h")->size(), 3);
+
+    EXPECT_EQ(store.hashRemove("h", lookups), 2);
+    EXPECT_EQ(store.hashGetAll("h"), (std::vector<std::pair<std::string, std::string>>{{"c", "-1"}}));
+
+    // An emptied hash is removed.
+    std::vector<std::string_view> last{"c"};
+    EXPECT_EQ(store.hashRemove("h", last), 1);
+    EXPECT_FALSE(store.exists("h"));
+
+    store.set("str", "1");
+    EXPECT_EQ(store.hashSet("str", fields), std::unexpected(StoreError::WrongType));
+    EXPECT_EQ(store.hashIncrementBy("str", "a", 1), std::unexpected(StoreError::WrongType));
+}
+
+TEST(DataStoreTests, IncrementHashFields) {
+    EncodingLimits limits;
+    limits.hash.maxEntries = 1;
+    DataStore store(limits);
+    std::vector<DataStore::FieldValue> fields{{"text", "abc"}, {"big", "9223372036854775807"}};
+    store.hashSet("h", fields);
+
+    EXPECT_EQ(store.hashIncrementBy("h", "text", 1), std::unexpected(StoreError::NotAnInteger));
+    EXPECT_EQ(store.hashIncrementBy("h", "big", 1), std::unexpected(StoreError::Overflow));
+    EXPECT_EQ(store.hashIncrementBy("h", "big", -7), 9223372036854775800LL);
+}
+
+TEST(DataStoreTests, CountAndMergeHyperLogLogs) {
+    DataStore store;
+    std::vector<std::string_view> a{"x", "y", "z"};
+    std::vector<std::string_view> b{"z", "w"};
+
+    EXPECT_EQ(store.hyperLogLogAdd("a", a), true);
+    EXPECT_EQ(store.hyperLogLogAdd("a", a), false);
+    EXPECT_EQ(store.hyperLogLogAdd("b", b), true);
+    EXPECT_EQ(store.hyperLogLogAdd("empty", {}), true);
+    EXPECT_TRUE(store.get("a")->starts_with("HYLL"));
+
+    std::vector<std::string_view> single{"a"};
+    EXPECT_EQ(store.hyperLogLogCount(single), 3);
+    EXPECT_EQ(store.hyperLogLogCount(single), 3);
+
+    std::vector<std::string_view> both{"a", "missing", "b"};
+    EXPECT_EQ(store.hyperLogLogCount(both), 4);
+
+    std::vector<std::string_view> sources{"b"};
+    EXPECT_TRUE(store.hyperLogLogMerge("a", sources).has_value());
+    EXPECT_EQ(store.hyperLogLogCount(single), 4);
+
+    // A copy made with GET and SET is a HyperLogLog too.
+    store.set("copy", *store.get("a"));
+    std::vector<std::string_view> copy{"copy"};
+    EXPECT_EQ(store.hyperLogLogCount(copy), 4);
+
+    store.set("str", "HYLL but not really");
+    store.set("number", "1");
+    std::vector<std::string_view> str{"str"};
+    std::vector<std::string_view> number{"number"};
+    EXPECT_EQ(store.hyperLogLogCount(str), std::unexpected(StoreError::NotAHyperLogLog));
+    EXPECT_EQ(store.hyperLogLogAdd("number", a), std::unexpected(StoreError::NotAHyperLogLog));
+    EXPECT_EQ(store.hyperLogLogMerge("a", number), std::unexpected(StoreError::NotAHyperLogLog));
+
+    std::vector<std::string_view> elements{"x"};
+    store.push("list", elements, true);
+    EXPECT_EQ(store.hyperLogLogAdd("list", elements), std::unexpected(StoreError::WrongType));
+}
+
+TEST(DataStoreTests, CombineStoredSets) {
+    DataStore store;
+    std::vector<std::string_view> a{"1", "2", "3"};
+    std::vector<std::string_view> b{"2", "3", "4", "2"};
+
+    EXPECT_EQ(store.setAdd("a", a), 3);
+    EXPECT_EQ(store.setAdd("b", b), 3);
+    EXPECT_EQ(store.setContains("a", "1"), true);
+    EXPECT_EQ(store.setContains("missing", "1"), false);
+
+    std::vector<std::string_view> both{"a", "b"};
+    auto intersection = store.setIntersection(both);
+    std::sort(intersection->begin(), intersection->end());
+    EXPECT_EQ(intersection, (std::vector<std::string>{"2", "3"}));
+
+    std::vector<std::string_view> withMissing{"a", "missing", "b"};
+    EXPECT_EQ(store.setIntersection(withMissing), std::vector<std::string>{});
+    EXPECT_EQ(store.setUnion(withMissing)->size(), 4);
+    EXPECT_EQ(store.setDifference(withMissing), std::vector<std::string>{"1"});
+
+    store.set("str", "1");
+    std::vector<std::string_view> withString{"missing", "str"};
+    EXPECT_EQ(store.setIntersection(withString), std::unexpected(StoreError::WrongType));
+
+    EXPECT_EQ(store.setRemove("a", a), 3);
+    EXPECT_FALSE(store.exists("a"));
+    EXPECT_EQ(store.setLength("a"), 0);
+}
+
+TEST(DataStoreTests, AddToSortedSets) {
+    DataStore store;
+    std::vector<DataStore::ScoreMember> members{{1, "a"}, {2, "b"}};
+
+    // Nothing to update, so no set is created.
+    EXPECT_EQ(store.sortedSetAdd("z", members, {.onlyExisting = true})->added, 0);
+    EXPECT_FALSE(store.exists("z"));
+
+    EXPECT_EQ(store.sortedSetAdd("z", members, {})->added, 2);
+
+    std::vector<DataStore::ScoreMember> lower{{0, "a"}, {3, "b"}, {5, "c"}};
+    auto result = store.sortedSetAdd("z", lower, {.onlyGreater = true});
+    EXPECT_EQ(result->added, 1);
+    EXPECT_EQ(result->updated, 1);
+    EXPECT_EQ(store.sortedSetScore("z", "a"), 1);
+    EXPECT_EQ(store.sortedSetScore("z", "b"), 3);
+
+    std::vector<DataStore::ScoreMember> increment{{-0.5, "a"}};
+    EXPECT_EQ(store.sortedSetAdd("z", increment, {.increment = true})->score, 0.5);
+    EXPECT_EQ(store.sortedSetAdd("z", increment, {.onlyNew = true, .increment = true})->score, std::nullopt);
+    EXPECT_EQ(store.sortedSetRank("z", "c", true), std::pair(size_t{0}, 5.0));
+
+    std::vector<DataStore::ScoreMember> infinite{{std::numeric_limits<double>::infinity(), "a"}};
+    store.sortedSetAdd("z", infinite, {});
+    infinite[0].score = -infinite[0].score;
+    EXPECT_EQ(store.sortedSetAdd("z", infinite, {.increment = true}), std::unexpected(StoreError::NotANumber));
+
+    std::vector<std::string_view> remove{"a", "b", "c"};
+    EXPECT_EQ(store.sortedSetRemove("z", remove), 3);
+    EXPECT_FALSE(store.exists("z"));
+    EXPECT_EQ(store.sortedSetLength("z"), 0);
+}
+
+TEST(DataStoreTests, ServeBlockedPopsInOrder) {
+    DataStore store;
+    std::vector<std::string> served;
+
+    auto block = [&](std::vector<std::string> keys, bool front) {
+        auto blocked = std::make_shared<BlockedPop>();
+        blocked->keys = std::move(keys);
+        blocked->front = front;
+        blocked->serve = [&served](std::string_view key, std::string_view element) {
+            served.push_back(std::string(key) + "=" + std::string(element));
+        };
+        EXPECT_EQ(store.popOrBlock(blocked, true), std::nullopt);
+        return blocked;
+    };
+
+    auto first = block({"a", "b"}, true);
+    auto second = block({"b"}, false);
+    auto third = block({"b"}, true);
+    EXPECT_TRUE(store.cancelBlockedPop(third));
+
+    std::vector<std::string_view> elements{"1", "2", "3"};
+    auto result = store.push("b", elements, false);
+    EXPECT_EQ(result->length, 3);
+    EXPECT_EQ(result->servedFront, 1);
+    EXPECT_EQ(result->servedBack, 1);
+    EXPECT_EQ(served, (std::vector<std::string>{"b=1", "b=3"}));
+    EXPECT_EQ(store.listRange("b", 0, -1), std::vector<std::string>{"2"});
+
+    // Served clients no longer wait on their other keys.
+    EXPECT_FALSE(store.cancelBlockedPop(first));
+    EXPECT_EQ(store.push("a", elements, false)->servedFront, 0);
+
+    // A list holding elements is popped right away.
+    auto blocked = std::make_shared<BlockedPop>();
+    blocked->keys = {"missing", "a"};
+    EXPECT_EQ(store.popOrBlock(blocked, true), (DataStore::KeyElement{"a", "1"}));
+}
@@ -0,0 +1,62 @@
+#include "hash.h"
+#include "gtest/gtest.h"
+
+#include <map>
+
+namespace {
+    std::map<std::string, std::string> contents(const Hash &hash) {
+        std::map<std::string, std::string> fields;
+        hash.forEach([&](std::string_view field, std::string_view value) { fields.emplace(field, value); });
+        return fields;
+    }
+}// namespace
+
+TEST(HashTests, SetGetAndRemove) {
+    Hash hash;
+    ListpackLimits limits;
+
+    EXPECT_TRUE(hash.set("a", "1", limits));
+    EXPECT_TRUE(hash.set("b", "2", limits));
+    EXPECT_FALSE(hash.set("a", "longer", limits));
+    EXPECT_TRUE(hash.isPacked());
+    EXPECT_EQ(hash.size(), 2);
+    EXPECT_EQ(hash.get("a"), "longer");
+    EXPECT_EQ(hash.get("b"), "2");
+    EXPECT_EQ(hash.get("c"), std::nullopt);
+
+    EXPECT_TRUE(hash.remove("a"));
+    EXPECT_FALSE(hash.remove("a"));
+    EXPECT_EQ(contents(hash), (std::map<std::string, std::string>{{"b", "2"}}));
+    EXPECT_TRUE(hash.remove("b"));
+    EXPECT_TRUE(hash.empty());
+    EXPECT_EQ(hash.bytes(), 0);
+}
+
+TEST(HashTests, ConvertPastTheLimits) {
+    ListpackLimits limits{.maxEntries = 4, .maxValue = 8};
+
+    Hash many;
+    for (int i = 0; i < 4; ++i) { many.set(std::to_string(i), "v", limits); }
+    EXPECT_TRUE(many.isPacked());
+    // Updating an existing field does not grow the hash.
+    many.set("0", "w", limits);
+    EXPECT_TRUE(many.isPacked());
+
+    many.set("4", "v", limits);
+    EXPECT_FALSE(many.isPacked());
+    EXPECT_EQ(many.size(), 5);
+    EXPECT_EQ(many.get("0"), "w");
+    EXPECT_EQ(many.get("4"), "v");
+
+    Hash large;
+    large.set("a", "short", limits);
+    large.set("b", "longer than eight", limits);
+    EXPECT_FALSE(large.isPacked());
+    EXPECT_EQ(contents(large), (std::map<std::string, std::string>{{"a", "short"}, {"b", "longer than eight"}}));
+    EXPECT_EQ(large.bytes(), 2 + 5 + 17);
+
+    // A table stays one, even once small again.
+    large.remove("b");
+    EXPECT_FALSE(large.isPacked());
+    EXPECT_EQ(large.bytes(), 6);
+}
@@ -0,0 +1,140 @@
+#include "hyperloglog.h"
+#include "cpu_features.h"
+#include "gtest/gtest.h"
+
+#include <random>
+
+namespace {
+    HyperLogLog::Registers registersOf(std::string_view hll) {
+        HyperLogLog::Registers registers{};
+        HyperLogLog::mergeInto(registers, hll);
+        return registers;
+    }
+
+    HyperLogLog::Registers randomRegisters(std::mt19937 &gen, int maxValue) {
+        std::uniform_int_distribution<int> dist(0, maxValue);
+        HyperLogLog::Registers registers;
+        for (auto &value: registers) { value = static_cast<uint8_t>(dist(gen)); }
+        return registers;
+    }
+}// namespace
+
+TEST(HyperLogLogTests, CreateEmpty) {
+    auto hll = HyperLogLog::create();
+
+    EXPECT_TRUE(HyperLogLog::isValid(hll));
+    EXPECT_TRUE(HyperLogLog::isSparse(hll));
+    EXPECT_EQ(hll.size(), HyperLogLog::HEADER_SIZE + 2);
+    EXPECT_EQ(HyperLogLog::cachedCount(hll), 0);
+    EXPECT_EQ(HyperLogLog::estimate(registersOf(hll)), 0);
+}
+
+TEST(HyperLogLogTests, EstimateDistinctElements) {
+    auto hll = HyperLogLog::create();
+    size_t added = 0;
+
+    for (size_t n: {10, 100, 1000, 10000, 100000}) {
+        for (; added < n; ++added) {
+            HyperLogLog::add(hll, "element:" + std::to_string(added), HyperLogLog::DEFAULT_SPARSE_MAX_BYTES);
+        }
+
+        // Within three standard errors, 1.04 / sqrt(2^14) each.
+        auto estimate = static_cast<double>(HyperLogLog::estimate(registersOf(hll)));
+        EXPECT_NEAR(estimate, static_cast<double>(n), 0.025 * static_cast<double>(n)) << n;
+    }
+
+    EXPECT_FALSE(HyperLogLog::isSparse(hll));
+    EXPECT_EQ(hll.size(), HyperLogLog::DENSE_SIZE);
+    EXPECT_FALSE(HyperLogLog::add(hll, "element:1", HyperLogLog::DEFAULT_SPARSE_MAX_BYTES));
+}
+
+TEST(HyperLogLogTests, SparseAndDenseAgree) {
+    auto sparse = HyperLogLog::create();
+    auto dense = HyperLogLog::create();
+
+    for (int i = 0; i < 500; ++i) {
+        auto element = std::to_string(i);
+        EXPECT_EQ(HyperLogLog::add(sparse, element, 1 << 20), HyperLogLog::add(dense, element, 0));
+    }
+
+    EXPECT_TRUE(HyperLogLog::isSparse(sparse));
+    EXPECT_FALSE(HyperLogLog::isSparse(dense));
+    EXPECT_TRUE(HyperLogLog::isValid(sparse));
+    EXPECT_EQ(registersOf(sparse), registersOf(dense));
+}
+
+TEST(HyperLogLogTests, RoundTripRegisters) {
+    std::mt19937 gen(7);
+
+    auto registers = randomRegisters(gen, 51);
+    auto dense = HyperLogLog::fromRegisters(registers, HyperLogLog::DEFAULT_SPARSE_MAX_BYTES);
+    EXPECT_FALSE(HyperLogLog::isSparse(dense));
+    EXPECT_TRUE(HyperLogLog::isValid(dense));
+    EXPECT_EQ(registersOf(dense), registers);
+
+    // Mostly zero, with a register above what a sparse run holds.
+    HyperLogLog::Registers few{};
+    few[3] = 5;
+    few[4] = 5;
+    few[9000] = 32;
+    auto sparse = HyperLogLog::fromRegisters(few, HyperLogLog::DEFAULT_SPARSE_MAX_BYTES);
+    EXPECT_TRUE(HyperLogLog::isSparse(sparse));
+    EXPECT_TRUE(HyperLogLog::isValid(sparse));
+    EXPECT_EQ(registersOf(sparse), few);
+
+    few[9000] = 33;
+    EXPECT_FALSE(HyperLogLog::isSparse(HyperLogLog::fromRegisters(few, HyperLogLog::DEFAULT_SPARSE_MAX_BYTES)));
+}
+
+TEST(HyperLogLogTests, RejectInvalid) {
+    auto hll = HyperLogLog::create();
+    EXPECT_FALSE(HyperLogLog::isValid("HYLL"));
+    EXPECT_FALSE(HyperLogLog::isValid("not a hyperloglog at all"));
+    EXPECT_FALSE(HyperLogLog::isValid(hll.substr(0, hll.size() - 1)));
+    EXPECT_FALSE(HyperLogLog::isValid(hll + hll.back()));
+
+    HyperLogLog::Registers registers{};
+    registers[0] = 40;
+    auto dense = HyperLogLog::fromRegisters(registers, 0);
+    EXPECT_TRUE(HyperLogLog::isValid(dense));
+    EXPECT_FALSE(HyperLogLog::isValid(dense.substr(0, dense.size() - 1)));
+}
+
+TEST(HyperLogLogTests, CacheCount) {
+    auto hll = HyperLogLog::create();
+    HyperLogLog::add(hll, "a", HyperLogLog::DEFAULT_SPARSE_MAX_BYTES);
+    EXPECT_EQ(HyperLogLog::cachedCount(hll), std::nullopt);
+
+    HyperLogLog::cacheCount(hll, 1);
+    EXPECT_EQ(HyperLogLog::cachedCount(hll), 1);
+    EXPECT_FALSE(HyperLogLog::add(hll, "a", HyperLogLog::DEFAULT_SPARSE_MAX_BYTES));
+    EXPECT_EQ(HyperLogLog::cachedCount(hll), 1);
+}
+
+TEST(HyperLogLogTests, KernelsAgree) {
+    std::mt19937 gen(42);
+
+    for (int maxValue: {0, 1, 20, 51}) {
+        auto packed = HyperLogLog::fromRegisters(randomRegisters(gen, maxValue), 0);
+        const auto *dense = reinterpret_cast<const uint8_t *>(packed.data()) + HyperLogLog::HEADER_SIZE;
+
+        auto scalar = randomRegisters(gen, maxValue);
+        auto vector = scalar;
+        HyperLogLogKernels::mergeDenseScalar(scalar.data(), dense);
+
+        auto sums = HyperLogLogKernels::sumScalar(scalar.data());
+        if (maxValue == 0) {
+            EXPECT_EQ(sums.harmonic, HyperLogLog::NUM_REGISTERS);
+            EXPECT_EQ(sums.zeros, HyperLogLog::NUM_REGISTERS);
+        }
+
+        if (!CpuFeatures::hasAvx2()) { continue; }
+
+        HyperLogLogKernels::mergeDenseAvx2(vector.data(), dense);
+        EXPECT_EQ(vector, scalar);
+
+        auto vectorSums = HyperLogLogKernels::sumAvx2(vector.data());
+        EXPECT_NEAR(vectorSums.harmonic, sums.harmonic, 1e-9);
+        EXPECT_EQ(vectorSums.zeros, sums.zeros);
+    }
+}
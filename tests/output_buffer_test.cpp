@@ -0,0 +1,62 @@
+#include "output_buffer.h"
+#include "gtest/gtest.h"
+
+TEST(OutputBufferTests, CoalescesSmallWrites) {
+    OutputBuffer buffer;
+    buffer.append(std::string_view("+OK\r\n"));
+    buffer.append(std::string_view(":1\r\n"));
+
+    struct iovec iov[4];
+    ASSERT_EQ(buffer.prepare(iov, 4), 1);
+    EXPECT_EQ(buffer.size(), 9);
+    EXPECT_EQ(buffer.toString(), "+OK\r\n:1\r\n");
+}
+
+TEST(OutputBufferTests, ReferencesValueWithoutCopy) {
+    OutputBuffer buffer;
+    auto value = std::make_shared<const std::string>("Hello World");
+
+    buffer.append(std::string_view("$11\r\n"));
+    buffer.append(value);
+    buffer.append(std::string_view("\r\n"));
+
+    struct iovec iov[4];
+    ASSERT_EQ(buffer.prepare(iov, 4), 3);
+    EXPECT_EQ(iov[1].iov_base, value->data());
+    EXPECT_EQ(buffer.toString(), "$11\r\nHello World\r\n");
+}
+
+TEST(OutputBufferTests, ConsumePartialWrites) {
+    OutputBuffer buffer;
+    buffer.append(std::string_view("$11\r\n"));
+    buffer.append(std::make_shared<const std::string>("Hello World"));
+    buffer.append(std::string_view("\r\n"));
+
+    buffer.consume(3);
+    EXPECT_EQ(buffer.toString(), "\r\nHello World\r\n");
+
+    buffer.consume(8);
+    EXPECT_EQ(buffer.toString(), "World\r\n");
+
+    struct iovec iov[4];
+    ASSERT_EQ(buffer.prepare(iov, 4), 2);
+    EXPECT_EQ(iov[0].iov_len, 5);
+
+    buffer.consume(7);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(OutputBufferTests, ReusesWrittenChunks) {
+    OutputBuffer buffer;
+    buffer.append(std::string_view("+OK\r\n"));
+
+    struct iovec iov[4];
+    buffer.prepare(iov, 4);
+    auto *memory = iov[0].iov_base;
+    buffer.consume(5);
+
+    buffer.append(std::string_view(":1\r\n"));
+    buffer.prepare(iov, 4);
+    EXPECT_EQ(iov[0].iov_base, memory);
+    EXPECT_EQ(buffer.toString(), ":1\r\n");
+}
@@ -222,3 +222,79 @@ TEST(ParseTests, EncodeArray) {
 
     EXPECT_EQ(result, expected);
 }
+
+TEST(ParseTests, ParseResp3Types) {
+    auto buffer = stringToByteVector("_\r\n%1\r\n+proto\r\n:3\r\n>2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nkey\r\n");
+    std::span<const uint8_t> pending(buffer);
+
+    auto null = parseMessage(pending);
+    ASSERT_TRUE(null.has_value());
+    EXPECT_TRUE(std::holds_alternative<RedisType::Null>(null->first));
+    EXPECT_EQ(null->second, 3);
+    pending = pending.subspan(null->second);
+
+    auto map = parseMessage(pending);
+    ASSERT_TRUE(map.has_value());
+    ASSERT_TRUE(std::holds_alternative<RedisType::Map>(map->first));
+    const auto &pairs = std::get<RedisType::Map>(map->first).data;
+    ASSERT_EQ(pairs.size(), 1);
+    EXPECT_EQ(std::get<RedisType::SimpleString>(pairs[0].first).data, "proto");
+    EXPECT_EQ(std::get<RedisType::Integer>(pairs[0].second).data, 3);
+    pending = pending.subspan(map->second);
+
+    auto push = parseMessage(pending);
+    ASSERT_TRUE(push.has_value());
+    ASSERT_TRUE(std::holds_alternative<RedisType::Push>(push->first));
+    EXPECT_EQ(std::get<RedisType::Push>(push->first).data.size(), 2);
+    EXPECT_EQ(push->second, pending.size());
+}
+
+TEST(ParseTests, EncodeResp3Types) {
+    RedisType::Map map;
+    map.data.emplace_back(RedisType::SimpleString{"proto"}, RedisType::Integer{3});
+    RedisType::Push push{{RedisType::BulkString{"invalidate"}, RedisType::Null{}}};
+
+    auto encodedMap = encode(map);
+    auto encodedPush = encode(push);
+
+    EXPECT_EQ(std::string(encodedMap.begin(), encodedMap.end()), "%1\r\n+proto\r\n:3\r\n");
+    EXPECT_EQ(std::string(encodedPush.begin(), encodedPush.end()), ">2\r\n$10\r\ninvalidate\r\n_\r\n");
+}
+
+TEST(ParseTests, ParseIncompleteBulkString) {
+    std::string buffer_str = "$11\r\nHello";
+    auto buffer = stringToByteVector(buffer_str);
+    auto result = parseMessage(buffer);
+
+    ASSERT_FALSE(result.has_value());
+}
+
+TEST(ParseTests, ParseIncompleteArray) {
+    std::string buffer_str = "*2\r\n$3\r\nGET\r\n$3\r\nke";
+    auto buffer = stringToByteVector(buffer_str);
+    auto result = parseMessage(buffer);
+
+    ASSERT_FALSE(result.has_value());
+}
+
+TEST(ParseTests, ParsePipelinedArrays) {
+    std::string buffer_str = "*1\r\n$4\r\nPING\r\n*2\r\n$4\r\nECHO\r\n$2\r\nhi\r\n";
+    auto buffer = stringToByteVector(buffer_str);
+
+    auto first = parseMessage(buffer);
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first->second, 14);
+
+    auto second = parseMessage(std::span<const uint8_t>(buffer).subspan(first->second));
+    ASSERT_TRUE(second.has_value());
+    ASSERT_TRUE(std::holds_alternative<RedisType::Array>(second->first));
+    EXPECT_EQ(std::get<RedisType::Array>(second->first).data->size(), 2);
+    EXPECT_EQ(first->second + second->second, buffer.size());
+}
+
+TEST(ParseTests, ParseInvalidBulkLength) {
+    std::string buffer_str = "$abc\r\n";
+    auto buffer = stringToByteVector(buffer_str);
+
+    EXPECT_ANY_THROW(parseMessage(buffer));
+}
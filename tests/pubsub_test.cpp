@@ -0,0 +1,77 @@
+#include "pubsub.h"
+#include "gtest/gtest.h"
+
+TEST(PubSubTests, GlobMatch) {
+    EXPECT_TRUE(globMatch("news.*", "news.sports"));
+    EXPECT_TRUE(globMatch("news.*", "news."));
+    EXPECT_FALSE(globMatch("news.*", "news"));
+    EXPECT_TRUE(globMatch("*.sports", "news.sports"));
+    EXPECT_TRUE(globMatch("h?llo", "hallo"));
+    EXPECT_FALSE(globMatch("h?llo", "hllo"));
+    EXPECT_TRUE(globMatch("h[ae]llo", "hello"));
+    EXPECT_FALSE(globMatch("h[^e]llo", "hello"));
+    EXPECT_TRUE(globMatch("h[a-b]llo", "hbllo"));
+    EXPECT_TRUE(globMatch("h[b-a]llo", "hallo"));
+    EXPECT_TRUE(globMatch("a\\*b", "a*b"));
+    EXPECT_FALSE(globMatch("a\\*b", "axb"));
+    EXPECT_TRUE(globMatch("*a*b*c*", "xxaxxbxxcxx"));
+    EXPECT_FALSE(globMatch("*a*b*c*", "xxaxxcxxbxx"));
+    EXPECT_TRUE(globMatch("*", ""));
+}
+
+TEST(PubSubTests, PublishSharesEncodedMessage) {
+    PubSub pubsub;
+    Client first(1);
+    Client second(2);
+    Client resp3(3);
+    resp3.protocol = 3;
+
+    EXPECT_TRUE(pubsub.subscribe(first, "news"));
+    EXPECT_FALSE(pubsub.subscribe(first, "news"));
+    EXPECT_TRUE(pubsub.subscribe(second, "news"));
+    EXPECT_TRUE(pubsub.subscribe(resp3, "news"));
+
+    EXPECT_EQ(pubsub.publish("news", "hi"), 3);
+    EXPECT_EQ(pubsub.publish("weather", "hi"), 0);
+
+    auto firstMessages = first.takeMessages();
+    auto secondMessages = second.takeMessages();
+    auto resp3Messages = resp3.takeMessages();
+    ASSERT_EQ(firstMessages.size(), 1);
+    ASSERT_EQ(secondMessages.size(), 1);
+    ASSERT_EQ(resp3Messages.size(), 1);
+
+    EXPECT_EQ(*firstMessages[0], "*3\r\n$7\r\nmessage\r\n$4\r\nnews\r\n$2\r\nhi\r\n");
+    EXPECT_EQ(firstMessages[0].get(), secondMessages[0].get());
+    EXPECT_EQ(*resp3Messages[0], ">3\r\n$7\r\nmessage\r\n$4\r\nnews\r\n$2\r\nhi\r\n");
+
+    EXPECT_TRUE(pubsub.unsubscribe(second, "news"));
+    EXPECT_FALSE(pubsub.unsubscribe(second, "news"));
+    pubsub.unsubscribeAll(resp3);
+    EXPECT_EQ(pubsub.publish("news", "hi"), 1);
+}
+
+TEST(PubSubTests, PublishToMatchingPatterns) {
+    PubSub pubsub;
+    Client client(1);
+
+    pubsub.psubscribe(client, "news.*");
+    pubsub.psubscribe(client, "news.[st]*");
+    pubsub.psubscribe(client, "*.sports");
+    pubsub.psubscribe(client, "weather.*");
+
+    EXPECT_EQ(pubsub.publish("news.sports", "goal"), 3);
+    EXPECT_EQ(pubsub.publish("news.politics", "vote"), 1);
+    EXPECT_EQ(pubsub.publish("new", "x"), 0);
+
+    auto messages = client.takeMessages();
+    ASSERT_EQ(messages.size(), 4);
+    EXPECT_EQ(*messages[3], "*4\r\n$8\r\npmessage\r\n$6\r\nnews.*\r\n$13\r\nnews.politics\r\n$4\r\nvote\r\n");
+
+    EXPECT_TRUE(pubsub.punsubscribe(client, "news.*"));
+    EXPECT_EQ(pubsub.publish("news.sports", "goal"), 2);
+
+    pubsub.unsubscribeAll(client);
+    EXPECT_EQ(client.subscriptions(), 0);
+    EXPECT_EQ(pubsub.publish("news.sports", "goal"), 0);
+}
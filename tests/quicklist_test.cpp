@@ -0,0 +1,49 @@
+#include "quicklist.h"
+#include "gtest/gtest.h"
+
+TEST(QuickListTests, PushAndPopAtBothEnds) {
+    QuickList list;
+    list.pushBack("b");
+    list.pushBack("c");
+    list.pushFront("a");
+
+    EXPECT_EQ(list.size(), 3);
+    EXPECT_EQ(list.range(0, 2), (std::vector<std::string>{"a", "b", "c"}));
+
+    EXPECT_EQ(list.popFront(), "a");
+    EXPECT_EQ(list.popBack(), "c");
+    EXPECT_EQ(list.popBack(), "b");
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(list.bytes(), 0);
+}
+
+TEST(QuickListTests, PackElementsIntoNodes) {
+    QuickList list;
+    for (int i = 0; i < 10000; ++i) { list.pushBack(std::to_string(i)); }
+
+    // Short elements cost two bytes of framing each, thousands share a node.
+    EXPECT_LT(list.numNodes(), 10000 * 7 / QuickList::NODE_SIZE + 2);
+    EXPECT_EQ(list.range(4998, 5001), (std::vector<std::string>{"4998", "4999", "5000", "5001"}));
+    EXPECT_EQ(list.range(9999, 9999), std::vector<std::string>{"9999"});
+
+    for (int i = 0; i < 5000; ++i) { EXPECT_EQ(list.popFront(), std::to_string(i)); }
+    EXPECT_EQ(list.range(0, 1), (std::vector<std::string>{"5000", "5001"}));
+    for (int i = 9999; i >= 5000; --i) { EXPECT_EQ(list.popBack(), std::to_string(i)); }
+    EXPECT_EQ(list.numNodes(), 0);
+}
+
+TEST(QuickListTests, LargeElementsGetNodesOfTheirOwn) {
+    QuickList list;
+    std::string large(QuickList::NODE_SIZE + 200, 'x');
+    list.pushBack("first");
+    list.pushBack(large);
+    list.pushBack("");
+    list.pushFront(large);
+
+    EXPECT_EQ(list.numNodes(), 4);
+    EXPECT_EQ(list.range(0, 3), (std::vector<std::string>{large, "first", large, ""}));
+    EXPECT_EQ(list.popBack(), "");
+    EXPECT_EQ(list.popBack(), large);
+    EXPECT_EQ(list.popFront(), large);
+    EXPECT_EQ(list.popFront(), "first");
+}
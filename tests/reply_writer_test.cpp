@@ -0,0 +1,87 @@
+#include "reply_writer.h"
+#include "gtest/gtest.h"
+
+#include <limits>
+
+TEST(ReplyWriterTests, EncodeReplies) {
+    OutputBuffer out;
+    ReplyWriter reply(out);
+
+    reply.raw(Replies::OK);
+    reply.simpleString("PONG");
+    reply.error("ERR syntax error");
+    reply.bulkString("Hello");
+    reply.bulkString("");
+    reply.null();
+    reply.arrayHeader(2);
+
+    EXPECT_EQ(out.toString(), "+OK\r\n+PONG\r\n-ERR syntax error\r\n$5\r\nHello\r\n$0\r\n\r\n$-1\r\n*2\r\n");
+}
+
+TEST(ReplyWriterTests, EncodeIntegers) {
+    OutputBuffer out;
+    ReplyWriter reply(out);
+
+    reply.integer(0);
+    reply.integer(7);
+    reply.integer(9999);
+    reply.integer(10000);
+    reply.integer(-1);
+    reply.integer(INT64_MIN);
+
+    EXPECT_EQ(out.toString(), ":0\r\n:7\r\n:9999\r\n:10000\r\n:-1\r\n:-9223372036854775808\r\n");
+}
+
+TEST(ReplyWriterTests, EncodeBulkIntegers) {
+    OutputBuffer out;
+    ReplyWriter reply(out);
+
+    reply.bulkInteger(0);
+    reply.bulkInteger(-42);
+    reply.bulkInteger(INT64_MIN);
+
+    EXPECT_EQ(out.toString(), "$1\r\n0\r\n$3\r\n-42\r\n$20\r\n-9223372036854775808\r\n");
+}
+
+TEST(ReplyWriterTests, EncodeWrongArity) {
+    OutputBuffer out;
+    ReplyWriter reply(out);
+
+    reply.wrongArity("get");
+
+    EXPECT_EQ(out.toString(), "-ERR wrong number of arguments for 'get' command\r\n");
+}
+
+TEST(ReplyWriterTests, LargeValuesByReference) {
+    OutputBuffer out;
+    ReplyWriter reply(out);
+    auto value = std::make_shared<const std::string>(ReplyWriter::ZERO_COPY_THRESHOLD, 'x');
+
+    reply.bulkString(value);
+
+    struct iovec iov[4];
+    ASSERT_EQ(out.prepare(iov, 4), 3);
+    EXPECT_EQ(iov[1].iov_base, value->data());
+}
+
+TEST(ReplyWriterTests, EncodeForProtocolVersion) {
+    OutputBuffer resp2;
+    ReplyWriter reply2(resp2);
+    reply2.null();
+    reply2.nullArray();
+    reply2.mapHeader(2);
+    reply2.doubleValue(1.5);
+    reply2.setHeader(1);
+
+    OutputBuffer resp3;
+    ReplyWriter reply3(resp3, 3);
+    reply3.null();
+    reply3.nullArray();
+    reply3.mapHeader(2);
+    reply3.pushHeader(2);
+    reply3.doubleValue(-std::numeric_limits<double>::infinity());
+    reply3.setHeader(1);
+
+    EXPECT_EQ(resp2.toString(), "$-1\r\n*-1\r\n*4\r\n$3\r\n1.5\r\n*1\r\n");
+    EXPECT_EQ(resp3.toString(), "_\r\n_\r\n%2\r\n>2\r\n,-inf\r\n~1\r\n");
+}
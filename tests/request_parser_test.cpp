@@ -0,0 +1,127 @@
+#include "protocol.h"
+#include "request_parser.h"
+#include "gtest/gtest.h"
+
+TEST(RequestParserTests, ParseRequest) {
+    auto buffer = stringToByteVector("*2\r\n$4\r\nECHO\r\n$5\r\nHello\r\n");
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Complete);
+    EXPECT_EQ(parser.args(), (std::vector<std::string_view>{"ECHO", "Hello"}));
+    EXPECT_EQ(parser.length(), buffer.size());
+
+    // The arguments point into the buffer.
+    EXPECT_EQ(reinterpret_cast<const uint8_t *>(parser.args()[1].data()), buffer.data() + 18);
+}
+
+TEST(RequestParserTests, ResumeAcrossReads) {
+    std::string request = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$10\r\n0123456789\r\n";
+    std::vector<uint8_t> buffer;
+    RequestParser parser;
+
+    // Feed the request one byte at a time, the buffer reallocates in between.
+    for (size_t i = 0; i < request.size() - 1; ++i) {
+        buffer.push_back(request[i]);
+        ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Incomplete);
+    }
+
+    buffer.push_back(request.back());
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Complete);
+    EXPECT_EQ(parser.args(), (std::vector<std::string_view>{"SET", "key", "0123456789"}));
+}
+
+TEST(RequestParserTests, ParsePipelinedRequests) {
+    auto buffer = stringToByteVector("*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$1\r\nk\r\n");
+    std::span<const uint8_t> pending(buffer);
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(pending), RequestParser::Status::Complete);
+    EXPECT_EQ(parser.args(), std::vector<std::string_view>{"PING"});
+    pending = pending.subspan(parser.length());
+    parser.reset();
+
+    ASSERT_EQ(parser.parse(pending), RequestParser::Status::Complete);
+    EXPECT_EQ(parser.args(), (std::vector<std::string_view>{"GET", "k"}));
+    EXPECT_EQ(parser.length(), pending.size());
+}
+
+TEST(RequestParserTests, ParseEmptyRequest) {
+    auto buffer = stringToByteVector("*0\r\n");
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Complete);
+    EXPECT_TRUE(parser.args().empty());
+    EXPECT_EQ(parser.length(), 4);
+}
+
+TEST(RequestParserTests, ReportInvalidLengths) {
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(stringToByteVector("*abc\r\n")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: invalid multibulk length");
+
+    parser.reset();
+    ASSERT_EQ(parser.parse(stringToByteVector("*1\r\n$-3\r\n")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: invalid bulk length");
+
+    parser.reset();
+    ASSERT_EQ(parser.parse(stringToByteVector("*1\r\n:3\r\n")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: expected '$', got ':'");
+
+    parser.reset();
+    ASSERT_EQ(parser.parse(stringToByteVector("*1\r\n$3\r\nabcd\r\n")), RequestParser::Status::Error);
+}
+
+TEST(RequestParserTests, ReportOverflowingLength) {
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(stringToByteVector("*1\r\n$99999999999999999999\r\n")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: invalid bulk length");
+}
+
+TEST(RequestParserTests, ReportUnterminatedHeader) {
+    RequestParser parser;
+
+    // Zeros, so the length never overflows.
+    std::string header = "*" + std::string(RequestParser::MAX_HEADER_LENGTH - 2, '0');
+    ASSERT_EQ(parser.parse(stringToByteVector(header)), RequestParser::Status::Incomplete);
+    ASSERT_EQ(parser.parse(stringToByteVector(header + "0")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: invalid multibulk length");
+}
+
+TEST(RequestParserTests, ReceiveLargeArgumentIntoOwnBuffer) {
+    std::string value(RequestParser::LARGE_ARGUMENT_THRESHOLD + 10, 'v');
+    std::string header = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$" + std::to_string(value.size()) + "\r\n";
+
+    // The header and the first bytes of the value arrive in the read buffer.
+    auto buffer = stringToByteVector(header + value.substr(0, 100));
+    RequestParser parser;
+
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Incomplete);
+
+    // The rest is received straight into the argument's buffer.
+    auto destination = parser.bulkDestination();
+    ASSERT_EQ(destination.size(), value.size() - 100);
+    std::copy(value.begin() + 100, value.end(), destination.begin());
+    parser.bulkReceived(destination.size());
+    EXPECT_TRUE(parser.bulkDestination().empty());
+
+    buffer.push_back('\r');
+    buffer.push_back('\n');
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::Complete);
+    EXPECT_EQ(parser.length(), buffer.size());
+    ASSERT_EQ(parser.args().size(), 3);
+    EXPECT_EQ(parser.args()[2], value);
+
+    auto &buffers = parser.argumentBuffers();
+    ASSERT_EQ(buffers.size(), 3);
+    EXPECT_EQ(buffers[0], nullptr);
+    EXPECT_EQ(parser.args()[2].data(), buffers[2]->data());
+}
+
+TEST(RequestParserTests, RejectBulkAboveMaxLength) {
+    RequestParser parser(1024);
+
+    ASSERT_EQ(parser.parse(stringToByteVector("*1\r\n$1025\r\n")), RequestParser::Status::Error);
+    EXPECT_EQ(parser.error(), "Protocol error: invalid bulk length");
+}
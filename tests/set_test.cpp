@@ -0,0 +1,108 @@
+#include "set.h"
+#include "cpu_features.h"
+#include "worker_pool.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+    std::vector<std::string> sorted(std::vector<std::string> members) {
+        std::sort(members.begin(), members.end());
+        return members;
+    }
+}// namespace
+
+TEST(SetTests, AddAndRemoveIntegers) {
+    Set set;
+    EXPECT_TRUE(set.add("3", 512));
+    EXPECT_TRUE(set.add("-1", 512));
+    EXPECT_FALSE(set.add("3", 512));
+    EXPECT_TRUE(set.isIntSet());
+
+    EXPECT_TRUE(set.contains("-1"));
+    EXPECT_TRUE(set.containsInteger(3));
+    EXPECT_FALSE(set.contains("03"));
+    EXPECT_FALSE(set.contains("x"));
+
+    // Not in canonical form, so kept as a string.
+    EXPECT_TRUE(set.add("03", 512));
+    EXPECT_FALSE(set.isIntSet());
+    EXPECT_TRUE(set.containsInteger(3));
+    EXPECT_EQ(sorted(set.members()), (std::vector<std::string>{"-1", "03", "3"}));
+
+    EXPECT_TRUE(set.remove("3"));
+    EXPECT_FALSE(set.remove("3"));
+    EXPECT_EQ(set.size(), 2);
+}
+
+TEST(SetTests, ConvertPastMaxIntsetEntries) {
+    Set set;
+    for (int i = 0; i < 4; ++i) { set.add(std::to_string(i), 4); }
+    EXPECT_TRUE(set.isIntSet());
+    EXPECT_FALSE(set.add("0", 4));
+    EXPECT_TRUE(set.isIntSet());
+
+    set.add("4", 4);
+    EXPECT_FALSE(set.isIntSet());
+    EXPECT_EQ(sorted(set.members()), (std::vector<std::string>{"0", "1", "2", "3", "4"}));
+}
+
+TEST(SetTests, SearchKernelsAgree) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<long long> dist(-1000, 1000);
+
+    for (size_t size = 0; size < 200; ++size) {
+        IntSet intset;
+        while (intset.size() < size) { intset.insert(dist(gen)); }
+        auto members = intset.members();
+
+        for (long long value = -1001; value <= 1001; ++value) {
+            bool expected = std::binary_search(members.begin(), members.end(), value);
+            EXPECT_EQ(IntSetSearch::scalar(members.data(), members.size(), value), expected);
+            if (CpuFeatures::hasAvx2()) {
+                EXPECT_EQ(IntSetSearch::avx2(members.data(), members.size(), value), expected);
+            }
+        }
+    }
+}
+
+TEST(SetTests, CombineSets) {
+    Set a, b, c;
+    for (auto member: {"1", "2", "3", "x"}) { a.add(member, 512); }
+    for (auto member: {"2", "3", "4"}) { b.add(member, 512); }
+    for (auto member: {"3", "x", "2"}) { c.add(member, 512); }
+
+    WorkerPool workers(0);
+    EXPECT_EQ(sorted(Set::intersection({&a, &b, &c}, workers)), (std::vector<std::string>{"2", "3"}));
+    EXPECT_EQ(sorted(Set::intersection({&a, &c}, workers)), (std::vector<std::string>{"2", "3", "x"}));
+
+    std::vector<const Set *> all{&a, &b, &c};
+    EXPECT_EQ(sorted(Set::unionOf(all)), (std::vector<std::string>{"1", "2", "3", "4", "x"}));
+
+    std::vector<const Set *> others{&b};
+    EXPECT_EQ(sorted(Set::difference(a, others)), (std::vector<std::string>{"1", "x"}));
+    EXPECT_EQ(sorted(Set::difference(b, all)), std::vector<std::string>{});
+}
+
+TEST(SetTests, IntersectLargeSetsAcrossThreads) {
+    Set evens, triples, integers;
+    size_t size = 4 * Set::PARALLEL_CHUNK_SIZE;
+    for (size_t i = 0; i < size; ++i) {
+        evens.add(std::to_string(2 * i), 0);
+        triples.add(std::to_string(3 * i), 0);
+    }
+    for (int i = 0; i < 100; ++i) { integers.add(std::to_string(i), 512); }
+
+    WorkerPool workers(3);
+    auto members = Set::intersection({&evens, &triples}, workers);
+    EXPECT_EQ(members.size(), (2 * size - 1) / 6 + 1);
+    for (const auto &member: members) { EXPECT_EQ(std::stoll(member) % 6, 0); }
+
+    WorkerPool none(0);
+    EXPECT_EQ(sorted(Set::intersection({&evens, &triples}, none)), sorted(members));
+
+    std::vector<std::string> sixes;
+    for (int i = 0; i < 100; i += 6) { sixes.push_back(std::to_string(i)); }
+    EXPECT_EQ(sorted(Set::intersection({&evens, &triples, &integers}, workers)), sorted(sixes));
+}
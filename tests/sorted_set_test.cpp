@@ -0,0 +1,93 @@
+#include "sorted_set.h"
+#include "gtest/gtest.h"
+
+#include <limits>
+
+namespace {
+    // Scores given in one order, so the packed and the skiplist encoding are checked for the same results.
+    void addAll(SortedSet &set, const ListpackLimits &limits) {
+        set.set("c", 3, limits);
+        set.set("a", 1, limits);
+        set.set("b", 2, limits);
+        set.set("bb", 2, limits);
+        set.set("inf", std::numeric_limits<double>::infinity(), limits);
+    }
+
+    void checkQueries(const SortedSet &set) {
+        using Entries = std::vector<SortedSet::Entry>;
+        double inf = std::numeric_limits<double>::infinity();
+
+        EXPECT_EQ(set.size(), 5);
+        EXPECT_EQ(set.score("bb"), 2);
+        EXPECT_EQ(set.score("missing"), std::nullopt);
+        EXPECT_EQ(set.rank("a", false), 0);
+        EXPECT_EQ(set.rank("bb", false), 2);
+        EXPECT_EQ(set.rank("bb", true), 2);
+        EXPECT_EQ(set.rank("inf", true), 0);
+        EXPECT_EQ(set.rank("missing", false), std::nullopt);
+
+        EXPECT_EQ(set.range(0, 4, false), (Entries{{"a", 1}, {"b", 2}, {"bb", 2}, {"c", 3}, {"inf", inf}}));
+        EXPECT_EQ(set.range(1, 2, true), (Entries{{"c", 3}, {"bb", 2}}));
+
+        EXPECT_EQ(set.rangeByScore({2, 3}, false, 0, 10), (Entries{{"b", 2}, {"bb", 2}, {"c", 3}}));
+        EXPECT_EQ(set.rangeByScore({2, 3, true}, false, 0, 10), (Entries{{"c", 3}}));
+        EXPECT_EQ(set.rangeByScore({2, inf, false, true}, true, 1, 2), (Entries{{"bb", 2}, {"b", 2}}));
+        EXPECT_EQ(set.rangeByScore({-inf, inf}, false, 4, 10), (Entries{{"inf", inf}}));
+        EXPECT_EQ(set.rangeByScore({3, 2}, false, 0, 10), Entries{});
+        EXPECT_EQ(set.rangeByScore({4, 5}, true, 0, 10), Entries{});
+    }
+}// namespace
+
+TEST(SortedSetTests, QueryPackedSet) {
+    SortedSet set;
+    addAll(set, {});
+    EXPECT_TRUE(set.isPacked());
+    checkQueries(set);
+}
+
+TEST(SortedSetTests, QuerySkipList) {
+    SortedSet set;
+    addAll(set, {.maxEntries = 2, .maxValue = 64});
+    EXPECT_FALSE(set.isPacked());
+    checkQueries(set);
+}
+
+TEST(SortedSetTests, UpdateAndRemove) {
+    for (ListpackLimits limits: {ListpackLimits{}, ListpackLimits{.maxEntries = 0, .maxValue = 64}}) {
+        SortedSet set;
+        EXPECT_TRUE(set.set("a", 1, limits));
+        EXPECT_TRUE(set.set("b", 2, limits));
+        EXPECT_FALSE(set.set("a", 3, limits));
+        EXPECT_EQ(set.rank("a", false), 1);
+        EXPECT_EQ(set.score("a"), 3);
+
+        EXPECT_TRUE(set.remove("b"));
+        EXPECT_FALSE(set.remove("b"));
+        EXPECT_EQ(set.rank("a", false), 0);
+        EXPECT_TRUE(set.remove("a"));
+        EXPECT_TRUE(set.empty());
+        EXPECT_EQ(set.bytes(), 0);
+    }
+}
+
+TEST(SortedSetTests, KeepRanksAcrossManyUpdates) {
+    SortedSet set;
+    ListpackLimits limits;
+    for (int i = 0; i < 10000; ++i) { set.set(std::to_string(i), i, limits); }
+    EXPECT_FALSE(set.isPacked());
+
+    // Every even member moves to the top, in reverse.
+    for (int i = 0; i < 10000; i += 2) { set.set(std::to_string(i), 20000 - i, limits); }
+    for (int i = 1; i < 10000; i += 2) { EXPECT_EQ(set.rank(std::to_string(i), false), i / 2); }
+    EXPECT_EQ(set.rank("9998", false), 5000);
+    EXPECT_EQ(set.rank("0", true), 0);
+
+    EXPECT_EQ(set.range(4999, 5000, false), (std::vector<SortedSet::Entry>{{"9999", 9999}, {"9998", 10002}}));
+    EXPECT_EQ(set.rangeByScore({10000, 10004}, false, 0, 10),
+              (std::vector<SortedSet::Entry>{{"9998", 10002}, {"9996", 10004}}));
+
+    // A long member does not fit the packed encoding.
+    SortedSet longMember;
+    longMember.set(std::string(100, 'x'), 1, limits);
+    EXPECT_FALSE(longMember.isPacked());
+}
@@ -0,0 +1,71 @@
+#include "timer_wheel.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(TimerWheelTests, ExpiresAfterDeadline) {
+    auto start = TimerWheel<int>::Clock::now();
+    TimerWheel<int> wheel(100ms, 8, start);
+    TimerWheel<int>::Handle handle;
+
+    wheel.schedule(handle, 1, start + 250ms);
+
+    std::vector<int> expired;
+    wheel.advance(start + 200ms, [&](int value) { expired.push_back(value); });
+    EXPECT_TRUE(expired.empty());
+    EXPECT_TRUE(handle.active);
+
+    wheel.advance(start + 300ms, [&](int value) { expired.push_back(value); });
+    EXPECT_EQ(expired, std::vector<int>{1});
+    EXPECT_FALSE(handle.active);
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTests, CancelledTimerDoesNotFire) {
+    auto start = TimerWheel<int>::Clock::now();
+    TimerWheel<int> wheel(100ms, 8, start);
+    TimerWheel<int>::Handle handle;
+
+    wheel.schedule(handle, 1, start + 100ms);
+    wheel.cancel(handle);
+
+    bool fired = false;
+    wheel.advance(start + 1s, [&](int) { fired = true; });
+    EXPECT_FALSE(fired);
+}
+
+TEST(TimerWheelTests, TimersBeyondOneRevolution) {
+    auto start = TimerWheel<int>::Clock::now();
+    TimerWheel<int> wheel(100ms, 4, start);
+    TimerWheel<int>::Handle near, far;
+
+    wheel.schedule(near, 1, start + 100ms);
+    wheel.schedule(far, 2, start + 500ms);
+
+    std::vector<int> expired;
+    wheel.advance(start + 400ms, [&](int value) { expired.push_back(value); });
+    EXPECT_EQ(expired, std::vector<int>{1});
+
+    wheel.advance(start + 500ms, [&](int value) { expired.push_back(value); });
+    EXPECT_EQ(expired, (std::vector<int>{1, 2}));
+}
+
+TEST(TimerWheelTests, RescheduleFromCallback) {
+    auto start = TimerWheel<int>::Clock::now();
+    TimerWheel<int> wheel(100ms, 8, start);
+    TimerWheel<int>::Handle handle;
+
+    wheel.schedule(handle, 1, start + 100ms);
+
+    int fired = 0;
+    auto onExpired = [&](int value) {
+        if (++fired == 1) { wheel.schedule(handle, value, start + 300ms); }
+    };
+
+    wheel.advance(start + 200ms, onExpired);
+    EXPECT_EQ(fired, 1);
+    EXPECT_TRUE(handle.active);
+
+    wheel.advance(start + 300ms, onExpired);
+    EXPECT_EQ(fired, 2);
+}
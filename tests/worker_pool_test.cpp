@@ -0,0 +1,37 @@
+#include "worker_pool.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(WorkerPoolTests, RunsEveryTaskOnce) {
+    for (size_t numWorkers: {0, 1, 3}) {
+        WorkerPool workers(numWorkers);
+        EXPECT_EQ(workers.size(), numWorkers);
+
+        for (size_t numTasks: {0, 1, 2, 16}) {
+            std::vector<std::atomic<int>> runs(numTasks);
+            workers.run(numTasks, [&runs](size_t i) { ++runs[i]; });
+            for (const auto &count: runs) { EXPECT_EQ(count, 1); }
+        }
+    }
+}
+
+TEST(WorkerPoolTests, SubmitFromSeveralThreads) {
+    WorkerPool workers(2);
+    std::atomic<size_t> total{0};
+
+    {
+        std::vector<std::jthread> submitters;
+        for (int i = 0; i < 4; ++i) {
+            submitters.emplace_back([&] {
+                for (int batch = 0; batch < 100; ++batch) {
+                    workers.run(8, [&total](size_t i) { total += i; });
+                }
+            });
+        }
+    }
+
+    EXPECT_EQ(total, 4 * 100 * 28);
+}